@@ -38,6 +38,7 @@
 #include <util/strings.h>
 #include <util/time/sys.hh>
 #include <util/preprocessor/repeat.h>
+#include <pixmap/PixelConvert.hh>
 #include <unzip.h>
 #include <EmuSystem.hh>
 #include <CommonFrameworkIncludes.hh>
@@ -153,6 +154,41 @@ void EmuSystem::sprintStateFilename(char *str, size_t size, int slot, const char
 	snprintf(str, size, "%s/%s.0%c.sta", savePath, gameName, saveSlotChar(slot));
 }
 
+static void updateSwitchValues();
+static Serializer *memState = nullptr; // in-memory stream kept between saves
+
+static Serializer &memStateStream()
+{
+	if(!memState)
+		memState = new Serializer();
+	memState->reset();
+	return *memState;
+}
+
+uint EmuSystem::memStateSize()
+{
+	if(!stateManager.saveState(memStateStream()))
+		return 0;
+	return memState->getMemData(nullptr, 0);
+}
+
+uint EmuSystem::saveMemState(uchar *buff, uint size)
+{
+	if(!stateManager.saveState(memStateStream()))
+		return 0;
+	return memState->getMemData(buff, size);
+}
+
+bool EmuSystem::loadMemState(const uchar *buff, uint size)
+{
+	auto &state = memStateStream();
+	state.setMemData(buff, size);
+	if(!stateManager.loadState(state))
+		return 0;
+	updateSwitchValues();
+	return 1;
+}
+
 void EmuSystem::saveAutoState()
 {
 	if(gameIsRunning() && optionAutoSaveState)
@@ -163,8 +199,7 @@ void EmuSystem::saveAutoState()
 		#ifdef CONFIG_BASE_IOS_SETUID
 			fixFilePermissions(saveStr);
 		#endif
-		Serializer state(string(saveStr), 0);
-		if(!stateManager.saveState(state))
+		if(saveMemStateFileAsync(saveStr, 0) != STATE_RESULT_OK)
 		{
 			logMsg("failed");
 		}
@@ -448,8 +483,26 @@ void onInputEvent(const Input::Event &e)
 }
 }
 
+static void renderTIAFrame(Pixmap &pix)
+{
+	if(!console)
+		return;
+	TIA& tia = console->tia();
+	assert(tia.height() <= 320);
+	uint h = IG::min(tia.height(), pix.y);
+	uint8* currentFrame = tia.currentFrameBuffer() /*+ (tia.ystart() * 160)*/;
+	uchar *row = pix.data;
+	iterateTimes(h, y)
+	{
+		PixelConvert::expandIndexed(currentFrame, (uint16*)row, tiaColorMap, 160);
+		currentFrame += 160;
+		row += pix.pitch;
+	}
+}
+
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	console->controller(Controller::Left).update();
 	console->controller(Controller::Right).update();
 	console->switches().update();
@@ -457,26 +510,22 @@ void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 	tia.update();
 	if(renderGfx)
 	{
-		assert(tia.height() <= 320);
-		uint h = tia.height();
-		uint8* currentFrame = tia.currentFrameBuffer() /*+ (tia.ystart() * 160)*/;
-		iterateTimes(160 * h, i)
-		{
-			pixBuff[i] = tiaColorMap[currentFrame[i]];
-		}
-		emuView.updateAndDrawContent();
+		// palette lookup writes straight into the texture upload buffer when possible
+		auto pix = emuView.lockFrame();
+		renderTIAFrame(*pix);
+		emuView.unlockFrame(pix);
 	}
 	if(renderAudio)
 	{
 		#ifdef USE_NEW_AUDIO
-		Audio::BufferContext *aBuff = Audio::getPlayBuffer(tiaSamplesPerFrame);
+		Audio::BufferContext *aBuff = EmuAudio::getPlayBuffer(tiaSamplesPerFrame);
 		if(!aBuff) return;
 		vcsSound->processAudio((TIASound::Sample*)aBuff->data, aBuff->frames);
-		Audio::commitPlayBuffer(aBuff, aBuff->frames);
+		EmuAudio::commitPlayBuffer(aBuff, aBuff->frames);
 		#else
 		TIASound::Sample buff[tiaSamplesPerFrame*soundChannels];
 		vcsSound->processAudio(buff, tiaSamplesPerFrame);
-		Audio::writePcm((uchar*)buff, tiaSamplesPerFrame);
+		EmuAudio::writePcm((uchar*)buff, tiaSamplesPerFrame);
 		#endif
 	}
 }
@@ -495,12 +544,7 @@ int EmuSystem::saveState()
 	#ifdef CONFIG_BASE_IOS_SETUID
 		fixFilePermissions(saveStr);
 	#endif
-	Serializer state(string(saveStr), 0);
-	if(!stateManager.saveState(state))
-	{
-		return STATE_RESULT_IO_ERROR;
-	}
-	return STATE_RESULT_OK;
+	return saveMemStateFile(saveStr, 0);
 }
 
 int EmuSystem::loadState(int saveStateSlot)
@@ -511,13 +555,7 @@ int EmuSystem::loadState(int saveStateSlot)
 	#ifdef CONFIG_BASE_IOS_SETUID
 		fixFilePermissions(saveStr);
 	#endif
-	Serializer state(string(saveStr), 1);
-	if(!stateManager.loadState(state))
-	{
-		return STATE_RESULT_IO_ERROR;
-	}
-	updateSwitchValues();
-	return STATE_RESULT_OK;
+	return loadMemStateFile(saveStr);
 }
 
 void EmuSystem::savePathChanged() { }
@@ -534,6 +572,7 @@ CallResult onInit(int argc, char** argv)
 	EmuSystem::pcmFormat.sample = Audio::SampleFormats::getFromBits(sizeof(TIASound::Sample)*8);
 	mainInitCommon();
 	emuView.initPixmap((uchar*)pixBuff, pixFmt, vidBufferX, vidBufferY);
+	emuView.renderFrameDel = EmuView::RenderFrameDelegate::create<&renderTIAFrame>();
 
 	Settings *settings = new Settings(&osystem);
 	settings->setInt("framerate", 60);
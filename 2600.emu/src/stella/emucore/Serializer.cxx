@@ -223,3 +223,27 @@ void Serializer::putBool(bool b)
 {
   putByte(b ? TruePattern: FalsePattern);
 }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 Serializer::getMemData(uInt8* array, uInt32 size)
+{
+  uInt32 len = myStream->tellp();
+  if(myUseFilestream)
+    return 0;
+  if(!array)
+    return len;
+  if(len > size)
+    return 0;
+  myStream->seekg(ios_base::beg);
+  myStream->read((char*)array, len);
+  return len;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Serializer::setMemData(const uInt8* array, uInt32 size)
+{
+  if(myUseFilestream)
+    return;
+  ((stringstream*)myStream)->str(string((const char*)array, size));
+  reset();
+}
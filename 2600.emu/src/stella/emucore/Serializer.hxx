@@ -192,6 +192,23 @@ class Serializer
     */
     void putBool(bool b);
 
+    /**
+      Copies what was written to an in-memory stream since the last reset.
+
+      @param array  The buffer to copy to, or NULL to only get the size
+      @param size   The size of the buffer
+      @result The number of bytes copied, or 0 if they don't fit in the buffer
+    */
+    uInt32 getMemData(uInt8* array, uInt32 size);
+
+    /**
+      Replaces the contents of an in-memory stream and resets it for reading.
+
+      @param array  The data to read from
+      @param size   The size of the data
+    */
+    void setMemData(const uInt8* array, uInt32 size);
+
   private:
     // The stream to send the serialized data to.
     iostream* myStream;
@@ -0,0 +1,55 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+
+namespace Benchmark
+{
+
+static const uint defaultFrames = 180;
+
+struct Result
+{
+	constexpr Result() { }
+	uint frames = 0;
+	double secs = 0; // wall time of the full pass (CPU + video + audio)
+	double fps = 0;
+	double p50Ms = 0, p99Ms = 0; // per-frame latency of the full pass
+	double cpuMs = 0, videoMs = 0, audioMs = 0; // average per-frame split
+	uint stateBytes = 0; // in-memory save state size, 0 if unsupported by the core
+	double stateSaveMs = 0, stateLoadMs = 0; // average time per state save/load
+	uint statePackedBytes = 0; // size as a compressed state file
+	double statePackMs = 0, stateUnpackMs = 0; // average time to compress/decompress it
+};
+
+// Runs the loaded game for the given number of frames in three passes
+// (CPU only, + video processing, + audio rendering) without presenting
+// anything, restoring the starting point before each pass from stateSlot
+// or by resetting the game if stateSlot is < -1, then times in-memory
+// state saves and loads from the final frame, along with their file compression
+bool run(uint frames, Result &result, int stateSlot = -2);
+
+void printResult(const Result &result);
+
+// Handles "-benchmark <rom> [-frames N] [-state slot]" on the command line of
+// an X11 or SDL build started with -headless, returns the process exit code.
+// Video is only written to the emulated frame buffer and audio is rendered
+// without opening a PCM device (the audio modules drop writes while closed),
+// other platforms run the benchmark from the file picker
+int runFromArgs(int argc, char** argv);
+
+}
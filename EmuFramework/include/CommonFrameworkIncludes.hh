@@ -2,3 +2,4 @@
 
 #include <CreditsView.hh>
 #include <Option.hh>
+#include <EmuAudio.hh>
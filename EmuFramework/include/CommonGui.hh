@@ -31,6 +31,7 @@
 #include <InputManagerView.hh>
 #include <EmuView.hh>
 #include <TextEntry.hh>
+#include <Benchmark.hh>
 #include <libgen.h>
 
 bool isMenuDismissKey(const Input::Event &e);
@@ -113,6 +114,7 @@ void fixFilePermissions(const char *path)
 
 //static int soundRateDelta = 0;
 bool ffGuiKeyPush = 0, ffGuiTouch = 0;
+bool rewindGuiKeyPush = 0;
 
 static GC fontMM =
 #if defined(CONFIG_BASE_ANDROID) || defined(CONFIG_BASE_IOS) || CONFIG_ENV_WEBOS_OS >= 3
@@ -361,6 +363,7 @@ void startGameFromMenu()
 	#endif
 	commonInitInput();
 	ffGuiKeyPush = ffGuiTouch = 0;
+	rewindGuiKeyPush = 0;
 
 	popup.clear();
 	Input::setKeyRepeat(0);
@@ -443,6 +446,7 @@ void onExit(bool backgrounded)
 	}
 
 	saveConfigFile();
+	EmuSystem::waitStateFileWrites();
 
 	#ifdef CONFIG_BLUETOOTH
 		if(!backgrounded || (backgrounded && !optionKeepBluetoothActive))
@@ -508,6 +512,11 @@ void onInterProcessMessage(const char *filename)
 	handleOpenFileCommand(filename);
 }
 
+int onHeadlessRun(int argc, char** argv)
+{
+	return Benchmark::runFromArgs(argc, argv);
+}
+
 void onResume(bool focused)
 {
 	if(updateInpueDevicesOnResume)
@@ -544,6 +553,8 @@ void takeGameScreenshot()
 	}
 	else
 	{
+		EmuSystem::waitEmuThreadIdle();
+		emuView.updateVidPix();
 		if(!writeScreenshot(emuView.vidPix, path))
 		{
 			popup.printf(2, 1, "Error writing screenshot #%d", screenshotNum);
@@ -638,6 +649,12 @@ void EmuView::inputEvent(const Input::Event &e)
 						logMsg("fast-forward key state: %d", ffGuiKeyPush);
 					}
 
+					bcase guiKeyIdxRewind:
+					{
+						rewindGuiKeyPush = e.state == Input::PUSHED;
+						logMsg("rewind key state: %d", rewindGuiKeyPush);
+					}
+
 					bcase guiKeyIdxLoadGame:
 					if(e.state == Input::PUSHED)
 					{
@@ -661,6 +678,7 @@ void EmuView::inputEvent(const Input::Event &e)
 					bcase guiKeyIdxSaveState:
 					if(e.state == Input::PUSHED)
 					{
+						EmuSystem::waitEmuThreadIdle();
 						int ret = EmuSystem::saveState();
 						if(ret != STATE_RESULT_OK)
 						{
@@ -674,6 +692,7 @@ void EmuView::inputEvent(const Input::Event &e)
 					bcase guiKeyIdxLoadState:
 					if(e.state == Input::PUSHED)
 					{
+						EmuSystem::waitEmuThreadIdle();
 						int ret = EmuSystem::loadState();
 						if(ret != STATE_RESULT_OK && ret != STATE_RESULT_OTHER_ERROR)
 						{
@@ -737,7 +756,7 @@ void EmuView::inputEvent(const Input::Event &e)
 								turboActions.removeEvent(sysAction);
 							}
 						}
-						EmuSystem::handleInputAction(e.state, sysAction);
+						EmuSystem::postInputAction(e.state, sysAction);
 					}
 				}
 			}
@@ -920,6 +939,7 @@ ResourceImage *getXAsset()
 
 static void mainInitCommon()
 {
+	Trace::setThreadName("main");
 	initOptions();
 	EmuSystem::initOptions();
 
@@ -929,6 +949,8 @@ static void mainInitCommon()
 	#endif
 
 	loadConfigFile();
+	VideoFilter::setFilter(optionVideoFilter);
+	EmuFilePicker::initDirIndex();
 
 	#if defined (CONFIG_BASE_X11) || defined (CONFIG_BASE_ANDROID)
 		Base::setWindowPixelBestColorHint(optionBestColorModeHint);
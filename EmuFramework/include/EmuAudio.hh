@@ -0,0 +1,94 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+#include <audio/Audio.hh>
+#include <trace/Trace.hh>
+
+// Cores send their samples through here instead of calling Audio directly.
+// A core that sets a source rate different from the device rate is converted by
+// the polyphase Resampler, with quality from optionResamplerQuality. With dynamic
+// rate control (optionAudioRateControl) the resampler ratio is also stretched
+// within +/-0.5% to steer the device buffer towards half full, so emulation can
+// stay locked to the display refresh without frame-skip.
+namespace EmuAudio
+{
+
+extern bool rateControl;
+extern bool resampling;
+
+// native rate of the core's samples, 0 if it already renders at pcmFormat.rate,
+// takes effect when sound is next started
+void setSourceRate(uint rate);
+uint sourceRate();
+
+// called after the PCM device is opened/before it's closed, sets up resampling
+// and enables rate control if the option is set and the backend reports its buffer fill
+void start();
+void stop();
+static bool rateControlActive() { return rateControl; }
+
+// re-measures the buffer fill and adjusts the ratio, once per display frame
+void updateRateControl();
+
+Audio::BufferContext *getStagingBuffer(uint wantedFrames);
+void commitStagingBuffer(Audio::BufferContext *buffer, uint frames);
+void writeResampledPcm(uchar *samples, uint frames);
+
+// Fast-forward keeps real-time worth of audio from the start of each display frame's
+// run of emulated frames and drops the rest, crossfading where the kept segments join,
+// so audio stays at normal pitch and the device buffer doesn't overflow
+extern bool fastForward;
+
+// true if the current audio format can be decimated
+bool fastForwardSupported();
+// called before running the frames for each display frame while fast-forwarding
+void startFastForwardFrame();
+void stopFastForward();
+// true until this display frame's share of audio has been written
+bool fastForwardWantsAudio();
+
+void writeFastForwardPcm(uchar *samples, uint frames);
+
+static Audio::BufferContext *getPlayBuffer(uint wantedFrames)
+{
+	if(unlikely(resampling || fastForward))
+		return getStagingBuffer(wantedFrames);
+	return Audio::getPlayBuffer(wantedFrames);
+}
+
+static void commitPlayBuffer(Audio::BufferContext *buffer, uint frames)
+{
+	TRACE_SCOPE("audio commit");
+	if(unlikely(resampling || fastForward))
+		commitStagingBuffer(buffer, frames);
+	else
+		Audio::commitPlayBuffer(buffer, frames);
+}
+
+static void writePcm(uchar *samples, uint frames)
+{
+	TRACE_SCOPE("audio commit");
+	if(unlikely(fastForward))
+		writeFastForwardPcm(samples, frames);
+	else if(unlikely(resampling))
+		writeResampledPcm(samples, frames);
+	else
+		Audio::writePcm(samples, frames);
+}
+
+}
@@ -49,6 +49,7 @@ static const int guiKeyIdxIncStateSlot = 5;
 static const int guiKeyIdxFastForward = 6;
 static const int guiKeyIdxGameScreenshot = 7;
 static const int guiKeyIdxExit = 8;
+static const int guiKeyIdxRewind = 9;
 
 void processRelPtr(const Input::Event &e);
 void commonInitInput();
@@ -88,6 +88,14 @@ extern Option2DOrigin optionTouchCtrlMenuPos;
 extern Option2DOrigin optionTouchCtrlFFPos;
 
 extern Byte1Option optionFrameSkip;
+extern Byte1Option optionEmuThread;
+extern Byte1Option optionAudioRateControl;
+extern Byte1Option optionRewind;
+extern Byte1Option optionRunAhead;
+extern Byte1Option optionVideoFilter;
+static const uint optionFastForwardSpeedMax = 16;
+extern Byte1Option optionFastForwardSpeed;
+extern Byte1Option optionResamplerQuality;
 
 static const uint optionImageZoomIntegerOnly = 255, optionImageZoomIntegerOnlyY = 254;
 extern Byte1Option optionImageZoom;
@@ -22,6 +22,9 @@
 #include <config/env.hh>
 #include <gui/FSPicker/FSPicker.hh>
 #include <util/gui/ViewStack.hh>
+#include <Rewind.hh>
+#include <RunAhead.hh>
+#include <trace/Trace.hh>
 
 extern BasicNavView viewNav;
 
@@ -44,11 +47,31 @@ class EmuSystem
 	static const uint optionFrameSkipAuto;
 	static uint aspectRatioX, aspectRatioY;
 	static const uint maxPlayers;
+	static uint memStateBound;
 
 	static void cancelAutoSaveStateTimer();
 	static void startAutoSaveStateTimer();
 	static int loadState(int slot = saveStateSlot);
 	static int saveState();
+	// uncompressed state kept in caller memory, memStateSize() is the core's size
+	// for a state of the running game or 0 if unsupported, saveMemState() returns
+	// the bytes written or 0 on error
+	static uint memStateSize();
+	// buffer size for saveMemState(): memStateSize() measured once per game, with
+	// headroom for cores whose states can grow as the game runs
+	static uint maxMemStateSize();
+	static uint saveMemState(uchar *buff, uint size);
+	static bool loadMemState(const uchar *buff, uint size);
+	// file states built on the above, saved in a StateFile container if compress is set,
+	// otherwise as-is for cores whose raw states are readable by other tools. Loading
+	// also accepts gzip states from older versions, both return a STATE_RESULT_* value
+	static int saveMemStateFile(const char *path, bool compress = 1);
+	static int loadMemStateFile(const char *path);
+	// captures the state on the calling thread, then compresses and writes it
+	// on a background thread, a newer request for the same path replaces a
+	// queued one
+	static int saveMemStateFileAsync(const char *path, bool compress = 1);
+	static void waitStateFileWrites();
 	static bool stateExists(int slot);
 	static const char *savePath() { return strlen(savePath_) ? savePath_ : gamePath; }
 	static void sprintStateFilename(char *str, size_t size, int slot,
@@ -76,6 +99,8 @@ class EmuSystem
 	static void configAudioRate();
 	static void clearInputBuffers();
 	static void handleInputAction(uint state, uint emuKey);
+	// handleInputAction() on the thread running the core, main thread input goes through here
+	static void postInputAction(uint state, uint emuKey);
 	static uint translateInputAction(uint input, bool &turbo);
 	static uint translateInputAction(uint input)
 	{
@@ -85,6 +110,18 @@ class EmuSystem
 	static void stopSound();
 	static void startSound();
 	static int setupFrameSkip(uint optionVal, Gfx::FrameTimeBase frameTime);
+
+	// optional thread running the core outside of the draw callback (optionEmuThread),
+	// frames are requested from the main thread and picked up by EmuView
+	static void startEmuThread();
+	static void stopEmuThread();
+	static bool emuThreadActive();
+	static bool onEmuThread();
+	static void postEmuThreadFrames(int framesToSkip, bool fastForward, bool renderAudio);
+	// has the thread run saveAutoState() before its next frames, returns 0 if it isn't running
+	static bool postEmuThreadAutoSaveState();
+	// returns once the thread has no frames or auto-save state left to run
+	static void waitEmuThreadIdle();
 	static void setupGamePaths(const char *filePath, bool searchInDocument);
 
 	static void clearGamePaths()
@@ -95,17 +132,6 @@ class EmuSystem
 		strcpy(fullGamePath, "");
 	}
 
-	static TimeSys benchmark()
-	{
-		auto now = TimeSys::timeNow();
-		iterateTimes(180, i)
-		{
-			runFrame(0, 1, 0);
-		}
-		auto after = TimeSys::timeNow();
-		return after-now;
-	}
-
 	static bool gameIsRunning()
 	{
 		return !string_equal(gameName, "");
@@ -113,6 +139,7 @@ class EmuSystem
 
 	static void pause()
 	{
+		stopEmuThread();
 		if(isActive())
 			state = State::PAUSED;
 		stopSound();
@@ -128,17 +155,25 @@ class EmuSystem
 		startTime = {};
 		startFrameTime = 0;
 		startAutoSaveStateTimer();
+		maxMemStateSize(); // measure before the emulation thread can ask
+		Rewind::init();
+		RunAhead::init();
+		startEmuThread();
 	}
 
 	static void closeSystem();
 	static void closeGame(bool allowAutosaveState = 1)
 	{
+		memStateBound = 0;
 		if(gameIsRunning())
 		{
+			stopEmuThread();
 			if(allowAutosaveState)
 				saveAutoState();
 			logMsg("closing game %s", gameName);
 			closeSystem();
+			Rewind::deinit();
+			RunAhead::deinit();
 			clearGamePaths();
 			cancelAutoSaveStateTimer();
 			viewNav.setRightBtnActive(0);
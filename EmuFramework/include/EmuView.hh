@@ -2,19 +2,27 @@
 
 #include <gfx/GfxSprite.hh>
 #include <gfx/GfxBufferImage.hh>
+#include <util/Delegate.hh>
 #include <VideoImageOverlay.hh>
+#include <VideoFilter.hh>
 #include <gui/View.hh>
 #include <EmuOptions.hh>
+#include <EmuSystem.hh>
 
 class EmuView : public View
 {
 public:
 	constexpr EmuView() { }
+	static bool headless; // no graphics context, only vidPix is maintained
 	Gfx::Sprite disp;
 	uchar *pixBuff = nullptr;
 	Pixmap vidPix {PixelFormatRGB565};
 	Gfx::BufferImage vidImg;
 	VideoImageOverlay vidImgOverlay;
+	// redraws the last frame into the given pixmap, cores set this to use lockFrame()
+	typedef Delegate<void (Pixmap &pix)> RenderFrameDelegate;
+	RenderFrameDelegate renderFrameDel;
+	bool vidPixIsCurrent = 1; // 0 if the last frame bypassed vidPix
 
 	Rect2<int> gameRect;
 	Rect2<GC> gameRectG;
@@ -28,6 +36,20 @@ public:
 	template <bool active>
 	void drawContent();
 	void runFrame(Gfx::FrameTimeBase frameTime);
+	void runFrames(int framesToSkip, bool fastForward, bool renderAudio);
+	void resetFrameQueue();
+	void commitThreadedFrame();
+	void presentThreadedFrame();
+	// Returns where the core should render the next frame: mapped texture memory,
+	// a queued frame on the emulation thread, or vidPix if neither is available.
+	// The memory may be write-only and its pitch can differ from vidPix.
+	// Always vidPix on the main thread when a VideoFilter is active.
+	// Only useful to cores that write the final pixels in their glue code, currently
+	// just 2600.emu, the others render inside the core into the buffer given to
+	// initPixmap() and still present it with updateAndDrawContent().
+	Pixmap *lockFrame();
+	void unlockFrame(Pixmap *pix); // replaces updateAndDrawContent()
+	void updateVidPix(); // redraw vidPix if the last frame went elsewhere
 	void draw(Gfx::FrameTimeBase frameTime);
 	void inputEvent(const Input::Event &e);
 
@@ -38,7 +60,12 @@ public:
 
 	void updateAndDrawContent()
 	{
-		vidImg.write(vidPix);
+		if(EmuSystem::onEmuThread())
+		{
+			commitThreadedFrame();
+			return;
+		}
+		vidImg.write(VideoFilter::apply(vidPix));
 		drawContent<1>();
 	}
 
@@ -51,7 +78,7 @@ public:
 
 	void reinitImage()
 	{
-		vidImg.init(vidPix, 0, optionImgFilter);
+		vidImg.init(VideoFilter::prepare(vidPix), 0, optionImgFilter);
 		disp.setImg(&vidImg);
 	}
 
@@ -66,7 +93,9 @@ public:
 		basePix.init(pixBuff, totalX, totalY, extraPitch);
 		vidPix.initSubPixmap(basePix, xO, yO, x, y);
 		logMsg("using %d:%d:%d:%d region of %d,%d pixmap for EmuView", xO, yO, x, y, totalX, totalY);
-		vidImg.init(vidPix, 0, optionImgFilter);
+		if(headless || EmuSystem::onEmuThread())
+			return; // texture is resized when the frame is presented
+		vidImg.init(VideoFilter::prepare(vidPix), 0, optionImgFilter);
 		disp.setImg(&vidImg);
 		if((uint)optionImageZoom > 100)
 			placeEmu();
@@ -74,7 +103,7 @@ public:
 
 	void initImage(bool force, uint x, uint y, uint extraPitch = 0)
 	{
-		if(force || !disp.img || vidPix.x != x || vidPix.y != y)
+		if(force || (!disp.img && !headless) || vidPix.x != x || vidPix.y != y)
 		{
 			resizeImage(x, y, extraPitch);
 		}
@@ -82,7 +111,7 @@ public:
 
 	void initImage(bool force, uint xO, uint yO, uint x, uint y, uint totalX, uint totalY, uint extraPitch = 0)
 	{
-		if(force || !disp.img || vidPix.x != x || vidPix.y != y)
+		if(force || (!disp.img && !headless) || vidPix.x != x || vidPix.y != y)
 		{
 			resizeImage(xO, yO, x, y, totalX, totalY, extraPitch);
 		}
@@ -29,6 +29,8 @@ public:
 	static FsDirFilterFunc defaultBenchmarkFsFilter;
 
 	void init(bool highlightFirst, FsDirFilterFunc filter = defaultFsFilter, bool singleDir = 0);
+	// sets up the directory index that speeds up listing previously visited directories
+	static void initDirIndex();
 	void initForBenchmark(bool highlightFirst, bool singleDir = 0);
 
 	void inputEvent(const Input::Event &e)
@@ -0,0 +1,54 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+#include <stddef.h>
+
+// Memory-maps an uncompressed ROM file so cores can use it as cartridge memory without
+// reading it into the heap. Mappings are private copy-on-write: pages are read from the
+// file as they're touched and only pages the core writes to (patches, mirroring, flash
+// saves) take up private memory, so cores that modify their ROM can use them too.
+// Archives, and files that can't be mapped, return 0 so the core falls back to its own loader.
+class MappedRom
+{
+public:
+	constexpr MappedRom() { }
+	~MappedRom() { close(); }
+
+	// maps path if it holds at most maxSize bytes, with zero-filled
+	// memory after the file data up to minSize
+	bool open(const char *path, size_t maxSize, size_t minSize = 0);
+
+	// maps path over the memory at dest, which must be page aligned and hold at least
+	// maxSize bytes, close() puts back zero-filled memory there
+	bool openAt(void *dest, const char *path, size_t maxSize);
+
+	void close();
+	uchar *data() const { return data_; }
+	size_t size() const { return fileSize; }
+	bool isOpen() const { return data_; }
+
+	// true if the file starts with a zip, 7z, rar or gzip signature
+	static bool isArchive(const char *path);
+
+private:
+	uchar *data_ = nullptr;
+	size_t fileSize = 0, mapSize = 0;
+	bool isFixed = 0;
+
+	bool map(uchar *dest, const char *path, size_t maxSize, size_t minSize);
+};
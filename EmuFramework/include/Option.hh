@@ -277,7 +277,11 @@ enum { CFGKEY_SOUND = 0, CFGKEY_TOUCH_CONTROL_DISPLAY = 1,
 	CFGKEY_SAVE_PATH = 57, CFGKEY_BEST_COLOR_MODE_HINT = 58,
 	CFGKEY_TOUCH_CONTROL_BOUNDING_BOXES = 59,
 	CFGKEY_INPUT_KEY_CONFIGS = 60, CFGKEY_INPUT_DEVICE_CONFIGS = 61,
-	CFGKEY_CONFIRM_OVERWRITE_STATE = 62, CFGKEY_NOTIFY_INPUT_DEVICE_CHANGE = 63
+	CFGKEY_CONFIRM_OVERWRITE_STATE = 62, CFGKEY_NOTIFY_INPUT_DEVICE_CHANGE = 63,
+	CFGKEY_EMU_THREAD = 64, CFGKEY_AUDIO_RATE_CONTROL = 65,
+	CFGKEY_REWIND = 66, CFGKEY_RUN_AHEAD = 67,
+	CFGKEY_VIDEO_FILTER = 68, CFGKEY_FAST_FORWARD_SPEED = 69,
+	CFGKEY_RESAMPLER_QUALITY = 70
 
 	// 256+ is reserved
 };
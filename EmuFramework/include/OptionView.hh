@@ -46,6 +46,9 @@ protected:
 	BoolMenuItem snd {"声音", BoolMenuItem::SelectDelegate::create<&soundHandler>()};
 	static void soundHandler(BoolMenuItem &item, const Input::Event &e);
 
+	BoolMenuItem audioRateControl {"Dynamic Rate Control", BoolMenuItem::SelectDelegate::create<&audioRateControlHandler>()};
+	static void audioRateControlHandler(BoolMenuItem &item, const Input::Event &e);
+
 	#ifdef CONFIG_AUDIO_OPENSL_ES
 	BoolMenuItem sndUnderrunCheck {"Strict Underrun Check", BoolMenuItem::SelectDelegate::create<&soundUnderrunCheckHandler>()};
 	static void soundUnderrunCheckHandler(BoolMenuItem &item, const Input::Event &e);
@@ -68,6 +71,11 @@ protected:
 	TextMenuItem touchCtrlConfig {"On-screen Config"};
 
 	MultiChoiceSelectMenuItem autoSaveState {"自动存档"};
+	MultiChoiceSelectMenuItem rewind {"Rewind History"};
+	void rewindInit();
+
+	MultiChoiceSelectMenuItem fastForwardSpeed {"Fast-Forward Speed"};
+	void fastForwardSpeedInit();
 
 	void autoSaveStateInit();
 
@@ -83,6 +91,10 @@ protected:
 
 	void audioRateInit();
 
+	MultiChoiceSelectMenuItem resamplerQuality {"Resampler Quality"};
+
+	void resamplerQualityInit();
+
 	#ifdef CONFIG_BASE_ANDROID
 		#ifdef SUPPORT_ANDROID_DIRECT_TEXTURE
 			BoolMenuItem directTexture {"Direct Texture"};
@@ -111,6 +123,8 @@ protected:
 
 	BoolMenuItem dither {"Dither Image"};
 
+	BoolMenuItem emuThread {"Separate Emulation Thread"};
+
 	BoolMenuItem navView {"Title Bar"};
 
 	BoolMenuItem backNav {"Title Back Navigation"};
@@ -130,6 +144,13 @@ protected:
 	char savePathStr[256] {0};
 	TextMenuItem savePath {""};
 
+	#ifdef CONFIG_TRACE
+	TextMenuItem exportTrace {"Export Frame Trace"};
+	#endif
+
+	MultiChoiceSelectMenuItem runAhead {"Run-Ahead"};
+	void runAheadInit();
+
 	#ifdef CONFIG_BLUETOOTH
 
 	MultiChoiceSelectMenuItem btScanSecs {"Bluetooth Scan"};
@@ -178,6 +199,10 @@ protected:
 
 	void overlayEffectLevelInit();
 
+	MultiChoiceSelectMenuItem videoFilter {"Video Filter"};
+
+	void videoFilterInit();
+
 	MultiChoiceSelectMenuItem relativePointerDecel {"Trackball Sensitivity"};
 
 	void relativePointerDecelInit();
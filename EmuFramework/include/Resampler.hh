@@ -0,0 +1,61 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+
+// Polyphase windowed-sinc resampler for interleaved 16-bit PCM with SSE2/NEON
+// dot-product kernels. The filter is designed once for the nominal in/out rates,
+// a small runtime ratio adjustment (for rate control) only moves the step between
+// output frames and truncates the position to one of its 512 phases.
+class Resampler
+{
+public:
+	enum { QUALITY_LOW, QUALITY_MEDIUM, QUALITY_HIGH };
+
+	constexpr Resampler() {}
+	~Resampler() { deinit(); }
+
+	// accepts up to maxInFrames frames per call to process()
+	bool init(uint inRate, uint outRate, uint channels, uint quality, uint maxInFrames);
+	void deinit();
+	bool isInit() const { return coef; }
+
+	// scales the output rate, 1.01 makes 1% more frames
+	void setRatioAdjust(double adjust);
+	// drops buffered input, for a discontinuity like a stopped device
+	void clear();
+
+	// out must hold maxOutFrames(inFrames), returns the frames written to it
+	uint process(const int16 *in, uint inFrames, int16 *out);
+	uint maxOutFrames(uint inFrames) const;
+
+	uint inRate() const { return inRate_; }
+	uint outRate() const { return outRate_; }
+	uint channels() const { return channels_; }
+	uint taps() const { return taps_; }
+
+	static const char *kernelName();
+
+private:
+	int16 *coef = nullptr; // [phases][taps_] in Q15
+	int16 *hist = nullptr; // planar, channels_ * histCap frames
+	uint64 pos = 0; // 32.32 position of the next output frame in hist
+	uint64 step = 0, nominalStep = 0;
+	uint histFrames = 0, histCap = 0, maxIn = 0;
+	uint taps_ = 0, channels_ = 0;
+	uint inRate_ = 0, outRate_ = 0;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+
+// Rewind history built from EmuSystem::saveMemState() snapshots taken every
+// snapshotInterval frames. Only the newest snapshot is kept whole, older ones
+// are XOR deltas against their successor, run-length encoded into a ring of
+// optionRewind megabytes that drops the oldest entries when full.
+namespace Rewind
+{
+
+static const uint snapshotInterval = 4;
+
+// allocates the history for the running game, does nothing if the option is
+// off or the core has no in-memory states
+void init();
+void deinit();
+
+extern bool active;
+static bool isActive() { return active; }
+
+// account for emulated frames, capturing a snapshot every snapshotInterval
+void onFrames(uint frames);
+
+// restores the snapshot before the last restored one, staying on the
+// oldest one once the history runs out, returns 0 if nothing was restored
+bool stepBack();
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+#include <fs/sys.hh>
+
+// On-disk cache of ROM images decompressed from zip/7z archives, so later launches
+// can map the cached copy with MappedRom instead of inflating the archive again.
+// Entries are keyed by the archive's path and modification time plus the CRC the
+// archive directory lists for the image, so an archive that changes gets a new entry
+// and the stale one ages out. The least recently used entries are removed once the
+// cache holds more than maxSize bytes.
+namespace RomCache
+{
+
+static const uint maxSize = 256 * 1024 * 1024;
+
+// fills path with the cached image for the archive entry and returns 1 if it exists
+bool lookup(const char *archivePath, uint32 crc, FsSys::cPath &path);
+
+// writes a decompressed image to the cache, then trims it to maxSize
+bool store(const char *archivePath, uint32 crc, const void *data, uint size);
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+
+// Hides input lag built into games: each displayed frame emulates the real
+// frame without video, saves an in-memory state, runs ahead up to the frame
+// shown, then restores the state so only the real frame advances the game
+namespace RunAhead
+{
+
+static const uint maxFrames = 3;
+
+// allocates the state buffer for optionRunAhead frames ahead, does nothing
+// if the option is off or the core has no in-memory states
+void init();
+void deinit();
+
+extern uint frames;
+static bool isActive() { return frames; }
+
+// replaces EmuSystem::runFrame(1, 1, renderAudio) for the displayed frame
+void runFrame(bool renderAudio);
+
+}
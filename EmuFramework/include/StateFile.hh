@@ -0,0 +1,49 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+
+// Compressed save state files: a header ("EMUSTATE", format version, chunk count)
+// followed by chunks, each tagged with 4 characters and carrying its codec, version,
+// raw/stored sizes and an Adler-32 of the raw data. Readers skip unknown tags.
+// The core's state is the STAT chunk, compressed with an LZ4 block codec
+// unless that doesn't make it smaller. All fields are little-endian.
+namespace StateFile
+{
+
+static const uint headerSize = 16, chunkHeaderSize = 20;
+
+bool isContainer(const uchar *data, uint size);
+
+uint packBound(uint stateBytes);
+// writes a container for the state to dest, which holds packBound(stateBytes),
+// returns the container size
+uint pack(const uchar *state, uint stateBytes, uchar *dest);
+// returns the size of the state in the STAT chunk or 0 if the data is invalid
+uint stateSize(const uchar *data, uint size);
+// decodes the STAT chunk into dest, returns its size or 0 if the data is
+// invalid or larger than destSize
+uint unpack(const uchar *data, uint size, uchar *dest, uint destSize);
+
+// LZ4 block format, compatible with the reference decoder
+uint compressBound(uint bytes);
+// dest holds compressBound(bytes), returns the compressed size
+uint compress(const uchar *src, uint bytes, uchar *dest);
+// returns the decompressed size or -1 if src is malformed or doesn't fit destBytes
+int decompress(const uchar *src, uint srcBytes, uchar *dest, uint destBytes);
+
+}
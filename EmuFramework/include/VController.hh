@@ -482,7 +482,7 @@ public:
 		if(kbMode)
 		{
 			assert(vBtn < sizeofArray(kbMap));
-			EmuSystem::handleInputAction(action, kbMap[vBtn]);
+			EmuSystem::postInputAction(action, kbMap[vBtn]);
 		}
 		else
 		#endif
@@ -501,7 +501,7 @@ public:
 					turboActions.removeEvent(keyCode);
 				}
 			}
-			EmuSystem::handleInputAction(action, keyCode);
+			EmuSystem::postInputAction(action, keyCode);
 		}
 	}
 
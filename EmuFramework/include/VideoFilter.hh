@@ -0,0 +1,46 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+#include <pixmap/Pixmap.hh>
+
+// Upscaling filters applied to the core's frame before it's uploaded to EmuView's
+// texture. The frame is split into horizontal bands run in parallel by a pool of
+// worker threads and the calling thread. Scale2x/3x work on 16 and 32-bit pixels,
+// hq2x/3x need RGB565 input and output BGRA8888, other formats fall back to ScaleNx.
+namespace VideoFilter
+{
+
+enum { NONE, SCALE2X, SCALE3X, HQ2X, HQ3X };
+static const uint filters = 5;
+
+bool isValid(uint8 filter);
+
+// selects the filter for following frames, the worker threads start with the first filter set
+void setFilter(uint filter);
+
+extern uint active;
+static bool isActive() { return active != NONE; }
+
+// Sets up the pixmap apply() writes src's filtered frame to and returns it,
+// or returns src if no filter is active or its format can't be filtered
+Pixmap &prepare(Pixmap &src);
+
+// filters src and returns the result like prepare(), valid until the next call
+Pixmap &apply(Pixmap &src);
+
+}
@@ -18,7 +18,7 @@
 namespace EmuControls
 {
 
-static const uint gameActionKeys = 9;
+static const uint gameActionKeys = 10;
 static const uint systemKeyMapStart = gameActionKeys;
 typedef uint GameActionKeyArray[gameActionKeys];
 
@@ -33,6 +33,7 @@ static const char *gameActionName[gameActionKeys] =
 	"Fast-forward",
 	"Game Screenshot",
 	"Exit",
+	"Rewind",
 };
 
 }
@@ -41,7 +42,7 @@ static const char *gameActionName[gameActionKeys] =
 KeyCategory("In-Game Actions", gameActionName, 0)
 
 #define EMU_CONTROLS_IN_GAME_ACTIONS_UNBINDED_PROFILE_INIT \
-0, 0, 0, 0, 0, 0, 0, 0, 0
+0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 
 #define EMU_CONTROLS_IN_GAME_ACTIONS_ICP_NUBS_PROFILE_INIT \
 Input::iControlPad::RNUB_DOWN, \
@@ -52,6 +53,7 @@ Input::iControlPad::RNUB_UP, \
 0, \
 Input::iControlPad::LNUB_UP, \
 0, \
+0, \
 0
 
 #define EMU_CONTROLS_IN_GAME_ACTIONS_ICADE_PROFILE_INIT \
@@ -63,6 +65,7 @@ Input::ICade::D, \
 0, \
 0, \
 0, \
+0, \
 0
 
 #define EMU_CONTROLS_IN_GAME_ACTIONS_WIIMOTE_PROFILE_INIT \
@@ -74,6 +77,7 @@ Input::Wiimote::HOME, \
 0, \
 0, \
 0, \
+0, \
 0
 
 #define EMU_CONTROLS_IN_GAME_ACTIONS_WII_CC_PROFILE_INIT \
@@ -85,6 +89,7 @@ Input::WiiCC::HOME, \
 0, \
 Input::WiiCC::ZR, \
 0, \
+0, \
 0
 
 #define EMU_CONTROLS_IN_GAME_ACTIONS_WEBOS_KB_PROFILE_INIT \
@@ -96,6 +101,7 @@ Input::asciiKey('a'), \
 0, \
 Input::asciiKey('@'), \
 0, \
+0, \
 0
 
 #define EMU_CONTROLS_WEBOS_KB_8WAY_DIRECTION_PROFILE_INIT \
@@ -117,7 +123,8 @@ Input::Keycode::MENU, \
 0, \
 Input::Keycode::SEARCH, \
 0, \
-Input::Keycode::ESCAPE
+Input::Keycode::ESCAPE, \
+0
 
 #define EMU_CONTROLS_IN_GAME_ACTIONS_ANDROID_PS3_GAMEPAD_PROFILE_INIT \
 0, \
@@ -128,6 +135,7 @@ Input::Keycode::GAME_1, \
 0, \
 Input::Keycode::GAME_R2, \
 0, \
+0, \
 0
 
 #define EMU_CONTROLS_IN_GAME_ACTIONS_ANDROID_PS3_GAMEPAD_MINIMAL_PROFILE_INIT \
@@ -139,6 +147,7 @@ Input::Keycode::GAME_1, \
 0, \
 0, \
 0, \
+0, \
 0
 
 #define EMU_CONTROLS_IN_GAME_ACTIONS_GENERIC_KB_PROFILE_INIT \
@@ -150,7 +159,8 @@ Input::asciiKey('['), \
 Input::asciiKey(']'), \
 Input::asciiKey('`'), \
 0, \
-Input::Keycode::ESCAPE
+Input::Keycode::ESCAPE, \
+Input::Keycode::BACK_SPACE
 
 #define EMU_CONTROLS_IN_GAME_ACTIONS_GENERIC_KB_ALT_PROFILE_INIT \
 Input::asciiKey('l'), \
@@ -161,7 +171,8 @@ Input::asciiKey('['), \
 Input::asciiKey(']'), \
 Input::asciiKey('`'), \
 0, \
-Input::Keycode::ESCAPE
+Input::Keycode::ESCAPE, \
+Input::Keycode::BACK_SPACE
 
 #ifdef CONFIG_BASE_ANDROID
 	#define EMU_CONTROLS_IN_GAME_ACTIONS_GENERIC_KB_MINIMAL_PROFILE_INIT \
@@ -173,6 +184,7 @@ Input::Keycode::ESCAPE
 	0, \
 	Input::Keycode::SEARCH, \
 	0, \
+	0, \
 	0
 #else
 	#define EMU_CONTROLS_IN_GAME_ACTIONS_GENERIC_KB_MINIMAL_PROFILE_INIT \
@@ -184,6 +196,7 @@ Input::Keycode::ESCAPE
 	0, \
 	Input::Keycode::F11, \
 	0, \
+	0, \
 	0
 #endif
 
@@ -196,4 +209,5 @@ Input::Keycode::ESCAPE
 	0, \
 	Input::Ps3::R2, \
 	0, \
+	0, \
 	0
@@ -0,0 +1,20 @@
+#ifndef HQ3X_H
+#define HQ3X_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void hq3x_init(void);
+
+void hq3x_32(void* pSrc, void* pDest, int Xres, int Yres, int BpL);
+
+// output is 32-bit 0x00RRGGBB, BpL is the output pitch
+void hq3x_32_rows(const void* pSrc, int srcBpL, void* pDest, int BpL, int Xres, int Yres, int rowStart, int rowEnd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,256 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "benchmark"
+#include <Benchmark.hh>
+#include <EmuSystem.hh>
+#include <EmuView.hh>
+#include <StateFile.hh>
+#include <mem/interface.h>
+#include <util/strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern EmuView emuView;
+
+namespace Benchmark
+{
+
+static int compareFrameTime(const void *a, const void *b)
+{
+	auto x = *(const float*)a, y = *(const float*)b;
+	return (x > y) - (x < y);
+}
+
+static bool restoreStart(int stateSlot)
+{
+	if(stateSlot < -1)
+	{
+		EmuSystem::resetGame();
+		return 1;
+	}
+	auto res = EmuSystem::loadState(stateSlot);
+	if(res != STATE_RESULT_OK)
+	{
+		logErr("error loading state slot %d: %s", stateSlot, stateResultToStr(res));
+		return 0;
+	}
+	return 1;
+}
+
+// returns total pass time in seconds, optionally storing each frame's time in ms
+static double runPass(uint frames, bool processGfx, bool renderAudio, float *frameMs)
+{
+	auto passStart = TimeSys::timeNow();
+	auto frameStart = passStart;
+	iterateTimes(frames, i)
+	{
+		EmuSystem::runFrame(0, processGfx, renderAudio);
+		if(frameMs)
+		{
+			auto now = TimeSys::timeNow();
+			frameMs[i] = double(now - frameStart) * 1000.;
+			frameStart = now;
+		}
+	}
+	return double(TimeSys::timeNow() - passStart);
+}
+
+static const uint stateIterations = 20;
+
+static void measureStates(Result &result)
+{
+	uint size = EmuSystem::maxMemStateSize();
+	if(!size)
+		return;
+	auto buff = (uchar*)mem_alloc(size);
+	if(!buff)
+	{
+		logErr("out of memory for %d byte state", size);
+		return;
+	}
+	uint bytes = 0;
+	auto saveStart = TimeSys::timeNow();
+	iterateTimes(stateIterations, i)
+	{
+		bytes = EmuSystem::saveMemState(buff, size);
+	}
+	double saveSecs = double(TimeSys::timeNow() - saveStart);
+	if(!bytes)
+	{
+		logErr("error saving state");
+		mem_free(buff);
+		return;
+	}
+	auto loadStart = TimeSys::timeNow();
+	iterateTimes(stateIterations, i)
+	{
+		if(!EmuSystem::loadMemState(buff, bytes))
+		{
+			logErr("error loading state");
+			mem_free(buff);
+			return;
+		}
+	}
+	double loadSecs = double(TimeSys::timeNow() - loadStart);
+	result.stateBytes = bytes;
+	result.stateSaveMs = (saveSecs * 1000.) / stateIterations;
+	result.stateLoadMs = (loadSecs * 1000.) / stateIterations;
+
+	auto packed = (uchar*)mem_alloc(StateFile::packBound(bytes));
+	if(!packed)
+	{
+		logErr("out of memory for %d byte packed state", StateFile::packBound(bytes));
+		mem_free(buff);
+		return;
+	}
+	uint packedBytes = 0;
+	auto packStart = TimeSys::timeNow();
+	iterateTimes(stateIterations, i)
+	{
+		packedBytes = StateFile::pack(buff, bytes, packed);
+	}
+	double packSecs = double(TimeSys::timeNow() - packStart);
+	auto unpackStart = TimeSys::timeNow();
+	iterateTimes(stateIterations, i)
+	{
+		if(StateFile::unpack(packed, packedBytes, buff, size) != bytes)
+		{
+			logErr("error unpacking state");
+			packedBytes = 0;
+			break;
+		}
+	}
+	double unpackSecs = double(TimeSys::timeNow() - unpackStart);
+	mem_free(packed);
+	mem_free(buff);
+	if(!packedBytes)
+		return;
+	result.statePackedBytes = packedBytes;
+	result.statePackMs = (packSecs * 1000.) / stateIterations;
+	result.stateUnpackMs = (unpackSecs * 1000.) / stateIterations;
+}
+
+bool run(uint frames, Result &result, int stateSlot)
+{
+	assert(EmuSystem::gameIsRunning());
+	assert(frames);
+	auto frameMs = (float*)mem_alloc(sizeof(float) * frames);
+	if(!frameMs)
+	{
+		logErr("out of memory for %d frame times", frames);
+		return 0;
+	}
+
+	// each pass adds one stage so the difference between passes gives its cost
+	double cpuSecs = 0, videoSecs = 0, fullSecs = 0;
+	if(!restoreStart(stateSlot))
+		goto FAIL;
+	cpuSecs = runPass(frames, 0, 0, nullptr);
+	if(!restoreStart(stateSlot))
+		goto FAIL;
+	videoSecs = runPass(frames, 1, 0, nullptr);
+	if(!restoreStart(stateSlot))
+		goto FAIL;
+	fullSecs = runPass(frames, 1, 1, frameMs);
+
+	qsort(frameMs, frames, sizeof(float), compareFrameTime);
+	result.frames = frames;
+	result.secs = fullSecs;
+	result.fps = double(frames) / fullSecs;
+	result.p50Ms = frameMs[(frames - 1) / 2];
+	result.p99Ms = frameMs[((frames - 1) * 99) / 100];
+	result.cpuMs = (cpuSecs * 1000.) / frames;
+	result.videoMs = IG::max(0., ((videoSecs - cpuSecs) * 1000.) / frames);
+	result.audioMs = IG::max(0., ((fullSecs - videoSecs) * 1000.) / frames);
+	measureStates(result);
+	mem_free(frameMs);
+	return 1;
+
+	FAIL:
+	mem_free(frameMs);
+	return 0;
+}
+
+void printResult(const Result &result)
+{
+	logMsg("%d frames in %f secs, %.2f fps", result.frames, result.secs, result.fps);
+	printf("frames: %u\n"
+		"time: %.3f s\n"
+		"fps: %.2f\n"
+		"frame p50: %.3f ms\n"
+		"frame p99: %.3f ms\n"
+		"cpu: %.3f ms/frame\n"
+		"video: %.3f ms/frame\n"
+		"audio: %.3f ms/frame\n",
+		result.frames, result.secs, result.fps, result.p50Ms, result.p99Ms,
+		result.cpuMs, result.videoMs, result.audioMs);
+	if(result.stateBytes)
+	{
+		printf("state size: %u bytes\n"
+			"state save: %.3f ms\n"
+			"state load: %.3f ms\n",
+			result.stateBytes, result.stateSaveMs, result.stateLoadMs);
+		if(result.statePackedBytes)
+		{
+			printf("state packed size: %u bytes\n"
+				"state pack: %.3f ms\n"
+				"state unpack: %.3f ms\n",
+				result.statePackedBytes, result.statePackMs, result.stateUnpackMs);
+		}
+	}
+	else
+		printf("state size: unsupported\n");
+	fflush(stdout);
+}
+
+int runFromArgs(int argc, char** argv)
+{
+	const char *romPath = nullptr;
+	uint frames = defaultFrames;
+	int stateSlot = -2;
+	for(int i = 1; i < argc; i++)
+	{
+		if(string_equal(argv[i], "-benchmark") && i+1 < argc)
+			romPath = argv[++i];
+		else if(string_equal(argv[i], "-frames") && i+1 < argc)
+			frames = IG::max(1, atoi(argv[++i]));
+		else if(string_equal(argv[i], "-state") && i+1 < argc)
+			stateSlot = atoi(argv[++i]);
+	}
+	if(!romPath)
+	{
+		fprintf(stderr, "usage: %s -headless -benchmark <rom> [-frames N] [-state slot]\n", argv[0]);
+		return 1;
+	}
+
+	// no window or GL context exists, only the emulated frame buffer is written
+	EmuView::headless = 1;
+	EmuSystem::configAudioRate();
+	if(EmuSystem::loadGame(romPath, 0) != 1)
+	{
+		fprintf(stderr, "error loading %s\n", romPath);
+		return 1;
+	}
+	Result result;
+	bool success = run(frames, result, stateSlot);
+	EmuSystem::closeGame(0);
+	if(!success)
+		return 1;
+	printResult(result);
+	return 0;
+}
+
+}
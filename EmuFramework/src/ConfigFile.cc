@@ -201,6 +201,13 @@ static bool readConfig2(Io *io)
 			bcase CFGKEY_AUTO_SAVE_STATE: optionAutoSaveState.readFromIO(io, size);
 			bcase CFGKEY_CONFIRM_AUTO_LOAD_STATE: optionConfirmAutoLoadState.readFromIO(io, size);
 			bcase CFGKEY_FRAME_SKIP: optionFrameSkip.readFromIO(io, size);
+			bcase CFGKEY_EMU_THREAD: optionEmuThread.readFromIO(io, size);
+			bcase CFGKEY_AUDIO_RATE_CONTROL: optionAudioRateControl.readFromIO(io, size);
+			bcase CFGKEY_REWIND: optionRewind.readFromIO(io, size);
+			bcase CFGKEY_RUN_AHEAD: optionRunAhead.readFromIO(io, size);
+			bcase CFGKEY_VIDEO_FILTER: optionVideoFilter.readFromIO(io, size);
+			bcase CFGKEY_FAST_FORWARD_SPEED: optionFastForwardSpeed.readFromIO(io, size);
+			bcase CFGKEY_RESAMPLER_QUALITY: optionResamplerQuality.readFromIO(io, size);
 			#if defined(CONFIG_BASE_ANDROID)
 			bcase CFGKEY_DITHER_IMAGE: optionDitherImage.readFromIO(io, size);
 			#endif
@@ -458,6 +465,13 @@ static OptionBase *cfgFileOption[] =
 	&optionUseOSInputMethod,
 	#endif
 	&optionFrameSkip,
+	&optionEmuThread,
+	&optionAudioRateControl,
+	&optionRewind,
+	&optionRunAhead,
+	&optionVideoFilter,
+	&optionFastForwardSpeed,
+	&optionResamplerQuality,
 	&optionDPI,
 	&optionVibrateOnPush,
 	&optionRecentGames,
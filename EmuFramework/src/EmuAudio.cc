@@ -0,0 +1,284 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "emuAudio"
+#include <EmuAudio.hh>
+#include <EmuSystem.hh>
+#include <EmuOptions.hh>
+#include <Resampler.hh>
+#include <mem/interface.h>
+#include <logger/interface.h>
+#include <util/memory.h>
+#include <util/time/sys.hh>
+#include <math.h>
+#include <string.h>
+
+namespace EmuAudio
+{
+
+bool rateControl = 0;
+bool resampling = 0;
+bool fastForward = 0;
+
+static const float maxDeviation = .005; // max ratio change, small enough to be inaudible
+static const float fillSmoothing = .1;
+static const uint stagingFrames = Audio::maxRate/10;
+static int16 stagingBuff[stagingFrames * 2];
+static int16 *outBuff = nullptr;
+static Audio::BufferContext stagingCtx;
+static Resampler resampler;
+static uint resamplerQuality = 0;
+static uint srcRate = 0;
+static uint inRate = 0; // rate of the frames the core sends, srcRate or the device rate
+static uint channels = 2;
+static float ratio = 1; // rate control adjustment of the output frames per input frame
+static float fillAvg = .5;
+
+static const uint ffFadeFrames = 128; // crossfade between kept fast-forward segments
+static const float ffMaxFrameSecs = .05; // limits the audio kept after a long display frame
+static int16 ffTail[ffFadeFrames * 2];
+static int16 ffFadeBuff[ffFadeFrames * 2];
+static uint ffTailFrames = 0;
+static uint ffBudget = 0; // input frames still kept in this display frame
+static bool ffSegmentStart = 0;
+static TimeSys ffLastFrameTime;
+
+static bool deviceBufferFrames(int &queued, int &total)
+{
+	queued = Audio::frameDelay();
+	int free = Audio::framesFree();
+	total = queued + free;
+	return queued >= 0 && free >= 0 && total > 0;
+}
+
+void setSourceRate(uint rate)
+{
+	srcRate = rate;
+}
+
+uint sourceRate()
+{
+	return srcRate;
+}
+
+static bool formatSupported(const Audio::PcmFormat &fmt)
+{
+	return fmt.sample->toBits() == 16 && fmt.channels <= 2;
+}
+
+static void startRateControl()
+{
+	rateControl = 0;
+	if(!optionAudioRateControl)
+		return;
+	int queued, total;
+	if(!formatSupported(EmuSystem::pcmFormat) || !deviceBufferFrames(queued, total))
+	{
+		logMsg("rate control not supported with this audio format/device");
+		return;
+	}
+	ratio = 1;
+	fillAvg = .5;
+	rateControl = 1;
+	logMsg("rate control started, %d frame buffer", total);
+}
+
+static bool startResampler(uint outRate)
+{
+	if(resampler.isInit() && resampler.inRate() == inRate && resampler.outRate() == outRate
+		&& resampler.channels() == channels && resamplerQuality == optionResamplerQuality && outBuff)
+	{
+		resampler.clear();
+		resampler.setRatioAdjust(1);
+		return 1;
+	}
+	resamplerQuality = optionResamplerQuality;
+	if(!resampler.init(inRate, outRate, channels, resamplerQuality, stagingFrames))
+		return 0;
+	auto newBuff = (int16*)mem_realloc(outBuff, resampler.maxOutFrames(stagingFrames) * channels * sizeof(int16));
+	if(!newBuff)
+	{
+		resampler.deinit();
+		return 0;
+	}
+	outBuff = newBuff;
+	return 1;
+}
+
+void start()
+{
+	auto &fmt = EmuSystem::pcmFormat;
+	uint outRate = fmt.rate;
+	inRate = srcRate ? srcRate : outRate;
+	channels = fmt.channels;
+	resampling = 0;
+	startRateControl();
+	if(inRate == outRate && !rateControl)
+		return;
+	if(!formatSupported(fmt))
+	{
+		logErr("can't resample this audio format, %uHz output will play at %uHz", inRate, outRate);
+		return;
+	}
+	if(!startResampler(outRate))
+	{
+		logErr("error starting resampler");
+		rateControl = 0;
+		return;
+	}
+	resampling = 1;
+}
+
+void stop()
+{
+	if(rateControl)
+		logMsg("rate control stopped at ratio %f", (double)ratio);
+	rateControl = 0;
+	resampling = 0;
+}
+
+void updateRateControl()
+{
+	int queued, total;
+	if(!deviceBufferFrames(queued, total))
+		return;
+	float fill = (float)queued / total;
+	fillAvg += (fill - fillAvg) * fillSmoothing;
+	// above half full produce fewer frames, below produce more
+	ratio = 1. + maxDeviation * (1. - 2. * IG::min(fillAvg, 1.f));
+	resampler.setRatioAdjust(ratio);
+}
+
+Audio::BufferContext *getStagingBuffer(uint wantedFrames)
+{
+	if(unlikely(wantedFrames > stagingFrames))
+		return Audio::getPlayBuffer(wantedFrames);
+	stagingCtx.data = stagingBuff;
+	stagingCtx.frames = wantedFrames;
+	return &stagingCtx;
+}
+
+void commitStagingBuffer(Audio::BufferContext *buffer, uint frames)
+{
+	if(unlikely(buffer != &stagingCtx))
+	{
+		Audio::commitPlayBuffer(buffer, frames);
+		return;
+	}
+	if(fastForward)
+		writeFastForwardPcm((uchar*)stagingBuff, frames);
+	else
+		writeResampledPcm((uchar*)stagingBuff, frames);
+}
+
+void writeResampledPcm(uchar *samples, uint frames)
+{
+	auto in = (const int16*)samples;
+	while(frames)
+	{
+		uint chunk = IG::min(frames, stagingFrames);
+		uint outFrames = resampler.process(in, chunk, outBuff);
+		Audio::writePcm((uchar*)outBuff, outFrames);
+		in += chunk * channels;
+		frames -= chunk;
+	}
+}
+
+static void writeOut(const int16 *samples, uint frames)
+{
+	if(!frames)
+		return;
+	if(resampling)
+		writeResampledPcm((uchar*)samples, frames);
+	else
+		Audio::writePcm((uchar*)samples, frames);
+}
+
+bool fastForwardSupported()
+{
+	return formatSupported(EmuSystem::pcmFormat);
+}
+
+void startFastForwardFrame()
+{
+	auto now = TimeSys::timeNow();
+	uint refreshRate = Base::refreshRate() ? Base::refreshRate() : 60;
+	float secs = 1. / refreshRate;
+	if(fastForward)
+		secs = IG::min((float)double(now - ffLastFrameTime), ffMaxFrameSecs);
+	else
+	{
+		channels = EmuSystem::pcmFormat.channels;
+		ffTailFrames = 0;
+		fastForward = 1;
+	}
+	ffLastFrameTime = now;
+	// the fade region of each segment replaces the previous segment's held-back tail
+	ffBudget = secs * (srcRate ? srcRate : EmuSystem::pcmFormat.rate) + ffFadeFrames;
+	ffSegmentStart = 1;
+}
+
+void stopFastForward()
+{
+	if(!fastForward)
+		return;
+	fastForward = 0;
+	writeOut(ffTail, ffTailFrames);
+	ffTailFrames = 0;
+}
+
+bool fastForwardWantsAudio()
+{
+	return ffBudget;
+}
+
+void writeFastForwardPcm(uchar *samples, uint frames)
+{
+	auto in = (const int16*)samples;
+	uint keep = IG::min(frames, ffBudget);
+	if(!keep)
+		return;
+	ffBudget -= keep;
+	uint pos = 0;
+	if(ffSegmentStart)
+	{
+		ffSegmentStart = 0;
+		// fade from the end of the last kept segment into this one
+		uint fade = IG::min(ffTailFrames, keep);
+		iterateTimes(fade, i)
+		{
+			float w = (i + 1) / (float)(fade + 1);
+			iterateTimes(channels, c)
+			{
+				ffFadeBuff[i * channels + c] = ffTail[i * channels + c]
+					+ (int)((in[i * channels + c] - ffTail[i * channels + c]) * w);
+			}
+		}
+		writeOut(ffFadeBuff, fade);
+		ffTailFrames = 0;
+		pos = fade;
+	}
+	uint hold = 0;
+	if(!ffBudget)
+	{
+		// audio after this gets dropped, hold back the end for the next crossfade
+		hold = IG::min(ffFadeFrames, keep - pos);
+		memcpy(ffTail, &in[(keep - hold) * channels], hold * channels * 2);
+		ffTailFrames = hold;
+	}
+	writeOut(&in[pos * channels], keep - pos - hold);
+}
+
+}
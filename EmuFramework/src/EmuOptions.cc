@@ -1,5 +1,7 @@
 #include <EmuOptions.hh>
 #include <EmuSystem.hh>
+#include <VideoFilter.hh>
+#include <Resampler.hh>
 #include "VController.hh"
 extern SysVController vController;
 
@@ -157,6 +159,14 @@ Byte1Option optionFrameSkip
 		#endif
 		Config::envIsPS3, optionFrameSkipIsValid);
 
+Byte1Option optionEmuThread(CFGKEY_EMU_THREAD, 0, Config::envIsPS3);
+Byte1Option optionAudioRateControl(CFGKEY_AUDIO_RATE_CONTROL, 0, Config::envIsPS3);
+Byte1Option optionRewind(CFGKEY_REWIND, 0); // history size in MB, 0 disables
+Byte1Option optionRunAhead(CFGKEY_RUN_AHEAD, 0, 0, optionIsValidWithMax<RunAhead::maxFrames>);
+Byte1Option optionVideoFilter(CFGKEY_VIDEO_FILTER, VideoFilter::NONE, 0, VideoFilter::isValid);
+Byte1Option optionFastForwardSpeed(CFGKEY_FAST_FORWARD_SPEED, 0, 0, optionIsValidWithMax<optionFastForwardSpeedMax>); // 0 runs as fast as possible
+Byte1Option optionResamplerQuality(CFGKEY_RESAMPLER_QUALITY, Resampler::QUALITY_MEDIUM, 0, optionIsValidWithMax<Resampler::QUALITY_HIGH>);
+
 bool optionImageZoomIsValid(uint8 val)
 {
 	return val == optionImageZoomIntegerOnly || optionImageZoomIntegerOnlyY || val <= 100;
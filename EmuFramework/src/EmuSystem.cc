@@ -17,6 +17,16 @@
 #include <EmuSystem.hh>
 #include <EmuOptions.hh>
 #include <audio/Audio.hh>
+#include <EmuAudio.hh>
+#include <EmuView.hh>
+#include <StateFile.hh>
+#include <util/thread/pthread.hh>
+#include <mem/interface.h>
+#include <util/strings.h>
+#include <zlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 EmuSystem::State EmuSystem::state = EmuSystem::State::OFF;
 FsSys::cPath EmuSystem::gamePath = "";
@@ -30,6 +40,7 @@ int EmuSystem::emuFrameNow;
 int EmuSystem::saveStateSlot = 0;
 Audio::PcmFormat EmuSystem::pcmFormat = Audio::pPCM;
 const uint EmuSystem::optionFrameSkipAuto = 32;
+uint EmuSystem::memStateBound = 0;
 EmuSystem::LoadGameCompleteDelegate EmuSystem::loadGameCompleteDel;
 Base::CallbackRef *EmuSystem::autoSaveStateCallbackRef = nullptr;
 void fixFilePermissions(const char *path);
@@ -37,10 +48,17 @@ void fixFilePermissions(const char *path);
 void saveAutoStateFromTimer();
 static const auto autoSaveStateCallback = Base::CallbackDelegate::create<&saveAutoStateFromTimer>();
 
+extern EmuView emuView;
+
 void saveAutoStateFromTimer()
 {
 	logMsg("auto-save state timer fired");
-	EmuSystem::saveAutoState();
+	// capture between frames on whichever thread runs the core
+	if(!EmuSystem::postEmuThreadAutoSaveState())
+	{
+		TRACE_SCOPE("autosave");
+		EmuSystem::saveAutoState();
+	}
 	EmuSystem::autoSaveStateCallbackRef = Base::callbackAfterDelaySec(autoSaveStateCallback, 60*optionAutoSaveState);
 }
 
@@ -62,11 +80,256 @@ void EmuSystem::startAutoSaveStateTimer()
 	}
 }
 
+struct EmuThreadRequest
+{
+	bool pending = 0;
+	int framesToSkip = 0;
+	bool fastForward = 0, renderAudio = 0;
+};
+
+static ThreadPThread emuThread;
+static MutexPThread emuThreadMutex;
+static CondVarPThread emuThreadCond;
+static pthread_t emuThreadId;
+static EmuThreadRequest emuThreadReq;
+static bool emuThreadQuit = 0, emuThreadBusy = 0, emuThreadSaveAutoState = 0;
+
+// Input actions from the main thread are double-buffered while the emulation
+// thread runs so only the core's thread calls handleInputAction(). The main
+// thread appends to inputList[inputWriteList] and publishes it once per display
+// frame, the other list belongs to the emulation thread while inputListState
+// isn't INPUT_LIST_FREE.
+struct InputActionList
+{
+	static const uint maxActions = 256;
+	uint actions = 0;
+	uint action[maxActions]; // emuKey, with the top bit set for Input::PUSHED
+};
+
+static const uint inputActionPushedBit = 1U << 31;
+enum { INPUT_LIST_FREE, INPUT_LIST_PUBLISHED, INPUT_LIST_TAKEN };
+static InputActionList inputList[2];
+static uint inputWriteList = 0; // only used on the main thread
+static uint inputPublishedList = 0;
+static uint inputListState = INPUT_LIST_FREE;
+
+static void applyInputActions(InputActionList &list)
+{
+	iterateTimes(list.actions, i)
+	{
+		uint action = list.action[i];
+		EmuSystem::handleInputAction((action & inputActionPushedBit) ? Input::PUSHED : Input::RELEASED,
+			action & ~inputActionPushedBit);
+	}
+	list.actions = 0;
+}
+
+static bool appendInputActions(InputActionList &list, const uint *action, uint actions)
+{
+	if(unlikely(list.actions + actions > InputActionList::maxActions))
+	{
+		logWarn("input action list full, dropping %d actions", actions);
+		return 0;
+	}
+	memcpy(&list.action[list.actions], action, actions * sizeof(uint));
+	list.actions += actions;
+	return 1;
+}
+
+// called by the emulation thread before running a frame request
+static void takeInputActions()
+{
+	uint published = INPUT_LIST_PUBLISHED;
+	if(!__atomic_compare_exchange_n(&inputListState, &published, INPUT_LIST_TAKEN,
+		0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+	applyInputActions(inputList[inputPublishedList]);
+	__atomic_store_n(&inputListState, INPUT_LIST_FREE, __ATOMIC_RELEASE);
+}
+
+// called by the main thread once per display frame
+static void publishInputActions()
+{
+	auto &list = inputList[inputWriteList];
+	if(!list.actions)
+		return;
+	uint state = __atomic_load_n(&inputListState, __ATOMIC_ACQUIRE);
+	if(state == INPUT_LIST_FREE)
+	{
+		// hand over this list and start filling the one just applied
+		inputPublishedList = inputWriteList;
+		inputWriteList ^= 1;
+		__atomic_store_n(&inputListState, INPUT_LIST_PUBLISHED, __ATOMIC_RELEASE);
+	}
+	else if(state == INPUT_LIST_PUBLISHED &&
+		__atomic_compare_exchange_n(&inputListState, &state, INPUT_LIST_FREE,
+			0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	{
+		// previous list wasn't picked up yet, add the newer actions after it
+		auto &published = inputList[inputPublishedList];
+		if(appendInputActions(published, list.action, list.actions))
+			list.actions = 0;
+		__atomic_store_n(&inputListState, INPUT_LIST_PUBLISHED, __ATOMIC_RELEASE);
+	}
+	// otherwise the emulation thread is applying the other list, try again next frame
+}
+
+static ptrsize runEmuThread(ThreadPThread &thread)
+{
+	emuThreadId = pthread_self();
+	Trace::setThreadName("emulation");
+	emuThreadMutex.lock();
+	for(;;)
+	{
+		while(!emuThreadQuit && !emuThreadReq.pending && !emuThreadSaveAutoState)
+			emuThreadCond.wait();
+		if(emuThreadQuit)
+			break;
+		if(emuThreadSaveAutoState)
+		{
+			emuThreadSaveAutoState = 0;
+			emuThreadBusy = 1;
+			emuThreadMutex.unlock();
+			{
+				TRACE_SCOPE("autosave");
+				EmuSystem::saveAutoState();
+			}
+			emuThreadMutex.lock();
+			emuThreadBusy = 0;
+			emuThreadCond.broadcast();
+			continue;
+		}
+		auto req = emuThreadReq;
+		emuThreadReq.pending = 0;
+		emuThreadBusy = 1;
+		emuThreadMutex.unlock();
+		takeInputActions();
+		emuView.runFrames(req.framesToSkip, req.fastForward, req.renderAudio);
+		emuThreadMutex.lock();
+		emuThreadBusy = 0;
+		emuThreadCond.broadcast();
+	}
+	emuThreadMutex.unlock();
+	return 0;
+}
+
+void EmuSystem::startEmuThread()
+{
+	if(!optionEmuThread || emuThread.running)
+		return;
+	static bool initSync = 0;
+	if(!initSync)
+	{
+		emuThreadMutex.create();
+		emuThreadCond.create(&emuThreadMutex);
+		initSync = 1;
+	}
+	emuView.resetFrameQueue();
+	emuThreadReq = {};
+	emuThreadQuit = 0;
+	emuThreadBusy = 0;
+	emuThreadSaveAutoState = 0;
+	iterateTimes(2, i)
+		inputList[i].actions = 0;
+	inputListState = INPUT_LIST_FREE;
+	if(!emuThread.create(0, ThreadPThread::EntryDelegate::create<&runEmuThread>()))
+	{
+		logErr("error creating emulation thread, running frames from draw callback");
+	}
+}
+
+void EmuSystem::stopEmuThread()
+{
+	if(!emuThread.running)
+		return;
+	emuThreadMutex.lock();
+	emuThreadQuit = 1;
+	emuThreadCond.broadcast();
+	emuThreadMutex.unlock();
+	emuThread.join();
+	emuThread.running = 0;
+	// apply input the thread didn't get to, in the order it arrived
+	if(inputListState == INPUT_LIST_PUBLISHED)
+		applyInputActions(inputList[inputPublishedList]);
+	applyInputActions(inputList[inputWriteList]);
+	inputListState = INPUT_LIST_FREE;
+	if(emuThreadSaveAutoState)
+	{
+		// thread quit before it got to the request
+		emuThreadSaveAutoState = 0;
+		TRACE_SCOPE("autosave");
+		EmuSystem::saveAutoState();
+	}
+	emuView.presentThreadedFrame(); // show the last completed frame while paused
+}
+
+bool EmuSystem::emuThreadActive()
+{
+	return emuThread.running;
+}
+
+bool EmuSystem::onEmuThread()
+{
+	return emuThread.running && pthread_equal(pthread_self(), emuThreadId);
+}
+
+void EmuSystem::postEmuThreadFrames(int framesToSkip, bool fastForward, bool renderAudio)
+{
+	static const int maxFrameSkip = 6;
+	emuThreadMutex.lock();
+	if(emuThreadReq.pending)
+	{
+		// previous request not picked up yet, fold it into this one so emulation speed is kept
+		framesToSkip = IG::min(emuThreadReq.framesToSkip + framesToSkip + 1, maxFrameSkip);
+		fastForward |= emuThreadReq.fastForward;
+	}
+	emuThreadReq.pending = 1;
+	emuThreadReq.framesToSkip = framesToSkip;
+	emuThreadReq.fastForward = fastForward;
+	emuThreadReq.renderAudio = renderAudio;
+	publishInputActions();
+	emuThreadCond.broadcast();
+	emuThreadMutex.unlock();
+}
+
+void EmuSystem::postInputAction(uint state, uint emuKey)
+{
+	if(!emuThread.running)
+	{
+		handleInputAction(state, emuKey);
+		return;
+	}
+	uint action = emuKey | (state == Input::PUSHED ? inputActionPushedBit : 0);
+	appendInputActions(inputList[inputWriteList], &action, 1);
+}
+
+bool EmuSystem::postEmuThreadAutoSaveState()
+{
+	if(!emuThread.running)
+		return 0;
+	emuThreadMutex.lock();
+	emuThreadSaveAutoState = 1;
+	emuThreadCond.broadcast();
+	emuThreadMutex.unlock();
+	return 1;
+}
+
+void EmuSystem::waitEmuThreadIdle()
+{
+	if(!emuThread.running)
+		return;
+	emuThreadMutex.lock();
+	while(emuThreadBusy || emuThreadReq.pending || emuThreadSaveAutoState)
+		emuThreadCond.wait();
+	emuThreadMutex.unlock();
+}
+
 void EmuSystem::startSound()
 {
 	if(optionSound)
 	{
 		Audio::openPcm(pcmFormat);
+		EmuAudio::start();
 	}
 }
 
@@ -75,6 +338,7 @@ void EmuSystem::stopSound()
 	if(optionSound)
 	{
 		//logMsg("stopping sound");
+		EmuAudio::stop();
 		Audio::closePcm();
 	}
 }
@@ -86,6 +350,324 @@ bool EmuSystem::stateExists(int slot)
 	return FsSys::fileExists(saveStr);
 }
 
+static int stateResultFromErrno()
+{
+	switch(errno)
+	{
+		case EACCES: return STATE_RESULT_NO_FILE_ACCESS;
+		case ENOENT: return STATE_RESULT_NO_FILE;
+		default: return STATE_RESULT_IO_ERROR;
+	}
+}
+
+static bool writeAll(int fd, const uchar *data, uint bytes)
+{
+	while(bytes)
+	{
+		auto written = write(fd, data, bytes);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return 0;
+		}
+		data += written;
+		bytes -= written;
+	}
+	return 1;
+}
+
+// writes to a temporary file that replaces path once it's synced to disk,
+// so a crash mid-write leaves the previous state intact
+static int writeStateFile(const char *path, const uchar *data, uint bytes, bool compress)
+{
+	TRACE_SCOPE("state file write");
+	FsSys::cPath tempPath;
+	string_printf(tempPath, "%s.tmp", path);
+	int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd == -1)
+		return stateResultFromErrno();
+	bool ok;
+	if(compress)
+	{
+		auto packed = (uchar*)mem_alloc(StateFile::packBound(bytes));
+		if(packed)
+		{
+			TRACE_SCOPE("state pack");
+			uint packedBytes = StateFile::pack(data, bytes, packed);
+			ok = writeAll(fd, packed, packedBytes);
+			mem_free(packed);
+		}
+		else
+		{
+			logErr("out of memory compressing %u byte state", bytes);
+			ok = 0;
+		}
+	}
+	else
+		ok = writeAll(fd, data, bytes);
+	if(ok && fsync(fd) != 0)
+		ok = 0;
+	close(fd);
+	if(!ok || rename(tempPath, path) != 0)
+	{
+		logErr("error writing state %s", path);
+		unlink(tempPath);
+		return STATE_RESULT_IO_ERROR;
+	}
+	logMsg("wrote %u byte state to %s", bytes, path);
+	return STATE_RESULT_OK;
+}
+
+uint EmuSystem::maxMemStateSize()
+{
+	if(!memStateBound)
+	{
+		uint size = memStateSize();
+		if(size)
+			memStateBound = size + size / 8 + 4096;
+	}
+	return memStateBound;
+}
+
+// serializes the running game into a new buffer, freed by the caller
+static uchar *captureMemState(uint &bytes)
+{
+	TRACE_SCOPE("state capture");
+	uint size = EmuSystem::maxMemStateSize();
+	if(!size)
+		return nullptr;
+	auto buff = (uchar*)mem_alloc(size);
+	if(!buff)
+	{
+		logErr("out of memory for %u byte state", size);
+		return nullptr;
+	}
+	bytes = EmuSystem::saveMemState(buff, size);
+	if(!bytes)
+	{
+		logErr("error serializing state");
+		mem_free(buff);
+		return nullptr;
+	}
+	return buff;
+}
+
+int EmuSystem::saveMemStateFile(const char *path, bool compress)
+{
+	waitStateFileWrites(); // don't let a queued write replace this one
+	uint bytes;
+	auto buff = captureMemState(bytes);
+	if(!buff)
+		return STATE_RESULT_OTHER_ERROR;
+	int res = writeStateFile(path, buff, bytes, compress);
+	mem_free(buff);
+	return res;
+}
+
+struct StateWriteRequest
+{
+	FsSys::cPath path;
+	uchar *data = nullptr;
+	uint bytes = 0;
+	bool compress = 0;
+};
+
+static ThreadPThread stateWriterThread;
+static MutexPThread stateWriterMutex;
+static CondVarPThread stateWriterCond;
+static StateWriteRequest stateWriteReq; // data is non-null while pending
+static bool stateWriterBusy = 0;
+
+static ptrsize runStateWriterThread(ThreadPThread &thread)
+{
+	Trace::setThreadName("state writer");
+	stateWriterMutex.lock();
+	for(;;)
+	{
+		while(!stateWriteReq.data)
+			stateWriterCond.wait();
+		auto req = stateWriteReq;
+		stateWriteReq.data = nullptr;
+		stateWriterBusy = 1;
+		stateWriterMutex.unlock();
+		writeStateFile(req.path, req.data, req.bytes, req.compress);
+		mem_free(req.data);
+		stateWriterMutex.lock();
+		stateWriterBusy = 0;
+		stateWriterCond.broadcast();
+	}
+	return 0;
+}
+
+static bool startStateWriterThread()
+{
+	if(stateWriterThread.running)
+		return 1;
+	static bool initSync = 0;
+	if(!initSync)
+	{
+		stateWriterMutex.create();
+		stateWriterCond.create(&stateWriterMutex);
+		initSync = 1;
+	}
+	if(!stateWriterThread.create(1, ThreadPThread::EntryDelegate::create<&runStateWriterThread>()))
+	{
+		logErr("error creating state writer thread");
+		return 0;
+	}
+	return 1;
+}
+
+int EmuSystem::saveMemStateFileAsync(const char *path, bool compress)
+{
+	if(!startStateWriterThread())
+		return saveMemStateFile(path, compress);
+	uint bytes;
+	auto buff = captureMemState(bytes);
+	if(!buff)
+		return STATE_RESULT_OTHER_ERROR;
+	stateWriterMutex.lock();
+	if(stateWriteReq.data)
+	{
+		if(string_equal(stateWriteReq.path, path))
+		{
+			logMsg("replacing queued write of %s", path);
+			mem_free(stateWriteReq.data);
+			stateWriteReq.data = nullptr;
+		}
+		else
+		{
+			// only one request is queued, let the writer take the other one first
+			while(stateWriteReq.data)
+				stateWriterCond.wait();
+		}
+	}
+	string_copy(stateWriteReq.path, path);
+	stateWriteReq.data = buff;
+	stateWriteReq.bytes = bytes;
+	stateWriteReq.compress = compress;
+	stateWriterCond.broadcast();
+	stateWriterMutex.unlock();
+	return STATE_RESULT_OK;
+}
+
+void EmuSystem::waitStateFileWrites()
+{
+	if(!stateWriterThread.running)
+		return;
+	stateWriterMutex.lock();
+	while(stateWriteReq.data || stateWriterBusy)
+		stateWriterCond.wait();
+	stateWriterMutex.unlock();
+}
+
+// gzip states from older versions, or uncompressed ones, gzread() passes those through,
+// the buffer grows until the whole file is read since gzip doesn't reliably store the size
+static int readLegacyStateFile(const char *path, uchar *&buff, uint &bytes)
+{
+	gzFile f = gzopen(path, "rb");
+	if(!f)
+		return stateResultFromErrno();
+	uint buffSize = 0;
+	bytes = 0;
+	int res = STATE_RESULT_OK;
+	for(;;)
+	{
+		if(bytes == buffSize)
+		{
+			buffSize = buffSize ? buffSize * 2 : 0x40000;
+			auto newBuff = (uchar*)mem_realloc(buff, buffSize);
+			if(!newBuff)
+			{
+				res = STATE_RESULT_OTHER_ERROR;
+				break;
+			}
+			buff = newBuff;
+		}
+		int read = gzread(f, buff + bytes, buffSize - bytes);
+		if(read < 0)
+			res = STATE_RESULT_IO_ERROR;
+		if(read <= 0)
+			break;
+		bytes += read;
+	}
+	gzclose(f);
+	return res;
+}
+
+// reads and decodes a state file into a new buffer sized for it, freed by the caller
+static int readStateFile(const char *path, uchar *&buff, uint &bytes)
+{
+	TRACE_SCOPE("state file read");
+	int fd = open(path, O_RDONLY);
+	if(fd == -1)
+		return stateResultFromErrno();
+	uchar header[StateFile::headerSize];
+	bool isContainer = read(fd, header, sizeof(header)) == (ssize_t)sizeof(header)
+		&& StateFile::isContainer(header, sizeof(header));
+	if(!isContainer)
+	{
+		close(fd);
+		return readLegacyStateFile(path, buff, bytes);
+	}
+	off_t fileSize = lseek(fd, 0, SEEK_END);
+	if(fileSize < 0 || (uint64)fileSize > 0xFFFFFFFF)
+	{
+		close(fd);
+		logErr("state file has invalid size");
+		return STATE_RESULT_INVALID_DATA;
+	}
+	auto packed = (uchar*)mem_alloc(fileSize);
+	if(!packed)
+	{
+		close(fd);
+		return STATE_RESULT_OTHER_ERROR;
+	}
+	bool readOk = pread(fd, packed, fileSize, 0) == (ssize_t)fileSize;
+	close(fd);
+	int res = STATE_RESULT_OK;
+	uint size = readOk ? StateFile::stateSize(packed, fileSize) : 0;
+	if(!readOk)
+		res = STATE_RESULT_IO_ERROR;
+	else if(!size)
+		res = STATE_RESULT_INVALID_DATA;
+	else if(!(buff = (uchar*)mem_alloc(size)))
+	{
+		logErr("out of memory for %u byte state", size);
+		res = STATE_RESULT_OTHER_ERROR;
+	}
+	else
+	{
+		bytes = StateFile::unpack(packed, fileSize, buff, size);
+		if(!bytes)
+			res = STATE_RESULT_INVALID_DATA;
+	}
+	mem_free(packed);
+	return res;
+}
+
+int EmuSystem::loadMemStateFile(const char *path)
+{
+	waitStateFileWrites();
+	uchar *buff = nullptr;
+	uint bytes = 0;
+	int res = readStateFile(path, buff, bytes);
+	if(res == STATE_RESULT_OK)
+	{
+		// the core checks the state against what the running game expects
+		if(!bytes)
+		{
+			logErr("state file has invalid size");
+			res = STATE_RESULT_INVALID_DATA;
+		}
+		else if(!loadMemState(buff, bytes))
+			res = STATE_RESULT_INVALID_DATA;
+	}
+	mem_freeSafe(buff);
+	return res;
+}
+
 bool EmuSystem::loadAutoState()
 {
 	if(optionAutoSaveState)
@@ -113,6 +695,11 @@ int EmuSystem::setupFrameSkip(uint optionVal, Gfx::FrameTimeBase frameTime)
 		return optionVal; // constant frame-skip for NTSC source
 	}
 
+	if(EmuAudio::rateControlActive() && IG::abs((int)Base::refreshRate() - (vidSysIsPAL() ? 50 : 60)) <= 1)
+	{
+		return 0; // one frame per refresh, audio rate follows the display clock
+	}
+
 	int emuFrame;
 	if(Base::supportsFrameTime())
 	{
@@ -188,7 +775,9 @@ int EmuSystem::setupFrameSkip(uint optionVal, Gfx::FrameTimeBase frameTime)
 
 void EmuSystem::setupGamePaths(const char *filePath, bool searchInDocument)
 {
-    if (searchInDocument) {
+    if (filePath[0] == '/') {
+        string_copy(fullGamePath, filePath);
+    } else if (searchInDocument) {
         snprintf(fullGamePath, sizeof(fullGamePath), "%s/%s", Base::documentsPath(), filePath);
         
     } else {
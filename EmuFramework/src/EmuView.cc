@@ -2,14 +2,44 @@
 #include <EmuInput.hh>
 #include <VController.hh>
 #include <MsgPopup.hh>
+#include <EmuAudio.hh>
+#include <mem/interface.h>
+#include <util/thread/pthread.hh>
+#include <util/time/sys.hh>
 
 extern SysVController vController;
 extern bool touchControlsAreOn;
 bool touchControlsApplicable();
-extern bool ffGuiKeyPush, ffGuiTouch;
+extern bool ffGuiKeyPush, ffGuiTouch, rewindGuiKeyPush;
 extern Gfx::Sprite menuIcon;
 extern MsgPopup popup;
 
+bool EmuView::headless = 0;
+
+// Frames completed on the emulation thread are copied to writeFrame and swapped
+// with readyFrame, draw() then swaps readyFrame with presentFrame and uploads it
+struct QueuedFrame
+{
+	uchar *data = nullptr;
+	uint size = 0, x = 0, y = 0;
+};
+static QueuedFrame frameQueue[3];
+static QueuedFrame *writeFrame = &frameQueue[0], *readyFrame = &frameQueue[1], *presentFrame = &frameQueue[2];
+static bool frameReady = 0;
+static uint presentX = 0, presentY = 0; // size of vidImg when last set from the queue
+static MutexPThread frameQueueMutex;
+
+// Fast-forward runs frames until its target speed or the display frame's time budget is reached
+static const float ffFrameBudget = .8; // share of a display frame spent emulating, the rest is for presenting
+static const uint ffMaxFrames = 64; // per display frame when unthrottled
+static const double ffSpeedInterval = .5; // seconds between speed readouts
+static float ffFrameCredit = 0;
+static TimeSys ffSpeedStart;
+static uint ffSpeedFrames = 0;
+static uint ffSpeedTenths = 0; // last measured speed, written by the emulation thread if active
+static bool ffSpeedUpdated = 0;
+static bool ffActive = 0;
+
 void EmuView::placeEmu()
 {
 	if(EmuSystem::gameIsRunning())
@@ -223,34 +253,244 @@ void EmuView::draw(Gfx::FrameTimeBase frameTime)
 	}
 }
 
+void EmuView::resetFrameQueue()
+{
+	static bool initMutex = 0;
+	if(!initMutex)
+	{
+		frameQueueMutex.create();
+		initMutex = 1;
+	}
+	frameReady = 0;
+	presentX = presentY = 0;
+}
+
+static bool reserveQueuedFrame(uint size)
+{
+	if(writeFrame->size < size)
+	{
+		auto data = (uchar*)mem_realloc(writeFrame->data, size);
+		if(!data)
+		{
+			logErr("out of memory for %d byte queued frame", size);
+			return 0;
+		}
+		writeFrame->data = data;
+		writeFrame->size = size;
+	}
+	return 1;
+}
+
+static void queueWriteFrame(uint x, uint y)
+{
+	writeFrame->x = x;
+	writeFrame->y = y;
+	frameQueueMutex.lock();
+	IG::swap(writeFrame, readyFrame);
+	frameReady = 1;
+	frameQueueMutex.unlock();
+}
+
+void EmuView::commitThreadedFrame()
+{
+	if(!reserveQueuedFrame(vidPix.sizeOfImage()))
+		return;
+	Pixmap dest(vidPix.format);
+	dest.init(writeFrame->data, vidPix.x, vidPix.y);
+	vidPix.copy(0, 0, 0, 0, &dest, 0, 0);
+	queueWriteFrame(vidPix.x, vidPix.y);
+}
+
+static Pixmap queuedPix {PixelFormatRGB565};
+
+Pixmap *EmuView::lockFrame()
+{
+	if(!renderFrameDel.hasCallback())
+		return &vidPix; // vidPix couldn't be redrawn for screenshots
+	if(EmuSystem::onEmuThread())
+	{
+		if(!reserveQueuedFrame(vidPix.sizeOfImage()))
+			return &vidPix;
+		new(&queuedPix) Pixmap(vidPix.format);
+		queuedPix.init(writeFrame->data, vidPix.x, vidPix.y);
+		return &queuedPix;
+	}
+	if(headless || VideoFilter::isActive())
+		return &vidPix; // filter reads the frame from vidPix
+	auto pix = vidImg.lock(0, 0, vidPix.x, vidPix.y, &vidPix);
+	return pix ? pix : &vidPix;
+}
+
+void EmuView::unlockFrame(Pixmap *pix)
+{
+	vidPixIsCurrent = pix == &vidPix;
+	if(pix == &vidPix)
+	{
+		updateAndDrawContent();
+		return;
+	}
+	if(pix == &queuedPix)
+	{
+		queueWriteFrame(pix->x, pix->y);
+		return;
+	}
+	vidImg.unlock(pix);
+	drawContent<1>();
+}
+
+void EmuView::updateVidPix()
+{
+	if(vidPixIsCurrent)
+		return;
+	renderFrameDel.invoke(vidPix);
+	vidPixIsCurrent = 1;
+}
+
+void EmuView::presentThreadedFrame()
+{
+	frameQueueMutex.lock();
+	bool newFrame = frameReady;
+	if(newFrame)
+	{
+		IG::swap(readyFrame, presentFrame);
+		frameReady = 0;
+	}
+	frameQueueMutex.unlock();
+	if(!newFrame)
+		return;
+
+	Pixmap frame(vidPix.format);
+	frame.init(presentFrame->data, presentFrame->x, presentFrame->y);
+	// filter here so the emulation thread only spends time on the core
+	auto &pix = VideoFilter::apply(frame);
+	if(pix.x != presentX || pix.y != presentY)
+	{
+		// core changed resolution on the emulation thread
+		vidImg.init(pix, 0, optionImgFilter);
+		disp.setImg(&vidImg);
+		if((uint)optionImageZoom > 100)
+			placeEmu();
+		presentX = pix.x;
+		presentY = pix.y;
+	}
+	vidImg.write(pix);
+}
+
 void EmuView::runFrame(Gfx::FrameTimeBase frameTime)
 {
+	TRACE_SCOPE("EmuView::runFrame");
 	commonUpdateInput();
 	bool renderAudio = optionSound;
+	bool fastForward = ffGuiKeyPush || ffGuiTouch;
+	if(fastForward && __atomic_exchange_n(&ffSpeedUpdated, 0, __ATOMIC_ACQUIRE))
+	{
+		uint tenths = ffSpeedTenths;
+		popup.printf(1, 0, "Fast-forward %u.%ux", tenths / 10, tenths % 10);
+	}
 
-	if(unlikely(ffGuiKeyPush || ffGuiTouch))
+	int framesToSkip = 0;
+	if(likely(!fastForward))
 	{
-		iterateTimes(4, i)
-		{
-			EmuSystem::runFrame(0, 0, 0);
-		}
+		framesToSkip = EmuSystem::setupFrameSkip(optionFrameSkip, frameTime);
 	}
-	else
+
+	if(EmuSystem::emuThreadActive())
 	{
-		int framesToSkip = EmuSystem::setupFrameSkip(optionFrameSkip, frameTime);
-		if(framesToSkip > 0)
-		{
-			iterateTimes(framesToSkip, i)
-			{
-				EmuSystem::runFrame(0, 0, renderAudio);
-			}
-		}
-		else if(framesToSkip == -1)
-		{
-			drawContent<1>();
-			return;
-		}
+		// core runs concurrently with texture upload and swap, show its latest frame
+		if(framesToSkip != -1)
+			EmuSystem::postEmuThreadFrames(framesToSkip, fastForward, renderAudio);
+		presentThreadedFrame();
+		drawContent<1>();
+		return;
 	}
 
-	EmuSystem::runFrame(1, 1, renderAudio);
+	if(framesToSkip == -1)
+	{
+		drawContent<1>();
+		return;
+	}
+	runFrames(framesToSkip, fastForward, renderAudio);
+}
+
+static uint runFastForwardFrames(bool renderAudio)
+{
+	uint refreshRate = Base::refreshRate() ? Base::refreshRate() : 60;
+	double budget = ffFrameBudget / refreshRate;
+	uint target = ffMaxFrames;
+	if(optionFastForwardSpeed)
+	{
+		// speed is relative to the system's own frame rate, which may differ from the display's
+		ffFrameCredit += (float)optionFastForwardSpeed * (EmuSystem::vidSysIsPAL() ? 50 : 60) / refreshRate;
+		// always run and present at least one frame so no vsync goes blank, a frame
+		// run ahead of the credit isn't paid back since fast-forward shouldn't go slower
+		target = IG::max(IG::min((uint)ffFrameCredit, ffMaxFrames), 1U);
+		ffFrameCredit = IG::max(ffFrameCredit - target, 0.f);
+	}
+	ffActive = 1;
+	bool decimateAudio = renderAudio && EmuAudio::fastForwardSupported();
+	if(decimateAudio)
+		EmuAudio::startFastForwardFrame();
+	auto start = TimeSys::timeNow();
+	uint frames = 0;
+	// the last frame is rendered for display
+	while(frames + 1 < target && double(TimeSys::timeNow() - start) < budget)
+	{
+		EmuSystem::runFrame(0, 0, decimateAudio && EmuAudio::fastForwardWantsAudio());
+		frames++;
+	}
+	EmuSystem::runFrame(1, 1, decimateAudio ? EmuAudio::fastForwardWantsAudio() : renderAudio);
+	frames++;
+
+	if(!ffSpeedFrames)
+		ffSpeedStart = start;
+	ffSpeedFrames += frames;
+	auto now = TimeSys::timeNow();
+	double secs = double(now - ffSpeedStart);
+	if(secs >= ffSpeedInterval)
+	{
+		ffSpeedTenths = ffSpeedFrames * 10. / (secs * (EmuSystem::vidSysIsPAL() ? 50 : 60)) + .5;
+		__atomic_store_n(&ffSpeedUpdated, 1, __ATOMIC_RELEASE);
+		ffSpeedFrames = 0;
+	}
+	return frames;
+}
+
+void EmuView::runFrames(int framesToSkip, bool fastForward, bool renderAudio)
+{
+	if(unlikely(rewindGuiKeyPush) && Rewind::stepBack())
+	{
+		// show one frame from each older snapshot while the key is held
+		EmuSystem::runFrame(1, 1, 0);
+		return;
+	}
+
+	if(unlikely(fastForward))
+	{
+		uint frames = runFastForwardFrames(renderAudio);
+		if(Rewind::isActive() && frames)
+			Rewind::onFrames(frames);
+		return;
+	}
+
+	if(unlikely(ffActive))
+	{
+		ffActive = 0;
+		EmuAudio::stopFastForward();
+		ffSpeedFrames = 0;
+		ffFrameCredit = 0;
+	}
+	if(EmuAudio::rateControlActive())
+		EmuAudio::updateRateControl();
+	iterateTimes(framesToSkip, i)
+	{
+		EmuSystem::runFrame(0, 0, renderAudio);
+	}
+
+	if(RunAhead::isActive())
+		RunAhead::runFrame(renderAudio);
+	else
+		EmuSystem::runFrame(1, 1, renderAudio);
+
+	if(Rewind::isActive())
+		Rewind::onFrames(framesToSkip + 1);
 }
@@ -18,6 +18,7 @@
 #include <MsgPopup.hh>
 #include <EmuSystem.hh>
 #include <EmuOptions.hh>
+#include <Benchmark.hh>
 #include <Recent.hh>
 #include <resource2/image/png/ResourceImagePng.h>
 #include <util/gui/ViewStack.hh>
@@ -38,12 +39,27 @@ void EmuFilePicker::init(bool highlightFirst, FsDirFilterFunc filter, bool singl
 			View::needsBackControl ? getXAsset() : 0, filter, singleDir);
 	onSelectFileDelegate().bind<&GameFilePicker::onSelectFile>();
 	onCloseDelegate().bind<&GameFilePicker::onClose>();
+	highlightFirstOnLoad = highlightFirst;
 	if(highlightFirst && tbl.cells)
 	{
 		tbl.selected = 0;
 	}
 }
 
+void EmuFilePicker::initDirIndex()
+{
+	FsSys::cPath path;
+	#ifdef CONFIG_BASE_USES_SHARED_DOCUMENTS_DIR
+	snprintf(path, sizeof(path), "%s/explusalpha.com", Base::documentsPath());
+	FsSys::mkdir(path);
+	snprintf(path, sizeof(path), "%s/explusalpha.com/DirIndex", Base::documentsPath());
+	#else
+	snprintf(path, sizeof(path), "%s/DirIndex", Base::documentsPath());
+	#endif
+	FsSys::mkdir(path);
+	FsDirLister::setIndexDir(path);
+}
+
 void EmuFilePicker::initForBenchmark(bool highlightFirst, bool singleDir)
 {
 	EmuFilePicker::init(highlightFirst, defaultBenchmarkFsFilter, singleDir);
@@ -126,10 +142,14 @@ void loadGameCompleteFromBenchmarkFilePicker(uint result, const Input::Event &e)
 	if(result)
 	{
 		logMsg("starting benchmark");
-		TimeSys time = EmuSystem::benchmark();
+		Benchmark::Result bench;
+		bool success = Benchmark::run(Benchmark::defaultFrames, bench);
 		EmuSystem::closeGame(0);
-		logMsg("done in: %f", double(time));
-		popup.printf(2, 0, "%.2f fps", double(180.)/double(time));
+		if(!success)
+			return;
+		Benchmark::printResult(bench);
+		popup.printf(3, 0, "%.2f fps, p99 %.2fms\ncpu %.2fms video %.2fms audio %.2fms",
+			bench.fps, bench.p99Ms, bench.cpuMs, bench.videoMs, bench.audioMs);
 	}
 }
 
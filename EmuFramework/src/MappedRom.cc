@@ -0,0 +1,161 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "mappedRom"
+#include <MappedRom.hh>
+#include <logger/interface.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef CONFIG_IO_MMAP_FD
+#include <util/fd-utils.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool MappedRom::isArchive(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if(!f)
+		return 0;
+	uchar magic[6] {0};
+	uint bytes = fread(magic, 1, sizeof(magic), f);
+	fclose(f);
+	return (bytes >= 4 && memcmp(magic, "PK\x03\x04", 4) == 0)
+		|| (bytes >= 6 && memcmp(magic, "7z\xBC\xAF\x27\x1C", 6) == 0)
+		|| (bytes >= 4 && memcmp(magic, "Rar!", 4) == 0)
+		|| (bytes >= 2 && magic[0] == 0x1F && magic[1] == 0x8B);
+}
+
+#ifdef CONFIG_IO_MMAP_FD
+
+static size_t pageSize()
+{
+	static size_t size = 0;
+	if(!size)
+		size = sysconf(_SC_PAGESIZE);
+	return size;
+}
+
+static size_t pageAlign(size_t size)
+{
+	size_t page = pageSize();
+	return (size + page - 1) & ~(page - 1);
+}
+
+bool MappedRom::map(uchar *dest, const char *path, size_t maxSize, size_t minSize)
+{
+	if(isArchive(path))
+		return 0;
+	int fd = ::open(path, O_RDONLY);
+	if(fd == -1)
+	{
+		logWarn("can't open %s", path);
+		return 0;
+	}
+	size_t size = fd_size(fd);
+	if(!size || size > maxSize)
+	{
+		logMsg("%s size %u not mappable, max %u", path, (uint)size, (uint)maxSize);
+		::close(fd);
+		return 0;
+	}
+
+	if(dest)
+	{
+		if((size_t)dest & (pageSize() - 1))
+		{
+			logWarn("destination %p not page aligned", dest);
+			::close(fd);
+			return 0;
+		}
+		mapSize = pageAlign(size);
+	}
+	else
+	{
+		// reserve the full area with anonymous zero pages, then place the file over its start
+		mapSize = pageAlign(IG::max(size, minSize));
+		void *area = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+		if(area == MAP_FAILED)
+		{
+			logErr("can't reserve %u bytes for %s", (uint)mapSize, path);
+			::close(fd);
+			mapSize = 0;
+			return 0;
+		}
+		dest = (uchar*)area;
+	}
+
+	void *data = mmap(dest, pageAlign(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+	::close(fd);
+	if(data == MAP_FAILED)
+	{
+		logErr("error mapping %s", path);
+		if(!isFixed && mapSize)
+			munmap(dest, mapSize);
+		mapSize = 0;
+		return 0;
+	}
+	// bytes between the file end and its last page boundary are already zero-filled by mmap,
+	// pages fault in from the file as they're touched with readahead started here in the background
+	madvise(data, pageAlign(size), MADV_WILLNEED);
+
+	data_ = (uchar*)data;
+	fileSize = size;
+	logMsg("mapped %s, %u bytes at %p", path, (uint)size, data_);
+	return 1;
+}
+
+bool MappedRom::open(const char *path, size_t maxSize, size_t minSize)
+{
+	close();
+	isFixed = 0;
+	return map(nullptr, path, maxSize, minSize);
+}
+
+bool MappedRom::openAt(void *dest, const char *path, size_t maxSize)
+{
+	close();
+	isFixed = 1;
+	return map((uchar*)dest, path, maxSize, 0);
+}
+
+void MappedRom::close()
+{
+	if(!data_)
+		return;
+	if(isFixed)
+	{
+		// the caller still owns dest, so swap the file pages for fresh zero pages
+		if(mmap(data_, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0) == MAP_FAILED)
+			logErr("error restoring memory at %p", data_);
+	}
+	else
+		munmap(data_, mapSize);
+	data_ = nullptr;
+	fileSize = mapSize = 0;
+	isFixed = 0;
+}
+
+#else
+
+bool MappedRom::map(uchar *dest, const char *path, size_t maxSize, size_t minSize) { return 0; }
+bool MappedRom::open(const char *path, size_t maxSize, size_t minSize) { return 0; }
+bool MappedRom::openAt(void *dest, const char *path, size_t maxSize) { return 0; }
+void MappedRom::close() { }
+
+#endif
@@ -2,6 +2,7 @@
 #include <OptionView.hh>
 #include <MsgPopup.hh>
 #include <FilePicker.hh>
+#include <Resampler.hh>
 
 extern MsgPopup popup;
 extern EmuFilePicker fPicker;
@@ -12,6 +13,12 @@ void OptionView::soundHandler(BoolMenuItem &item, const Input::Event &e)
 	optionSound = item.on;
 }
 
+void OptionView::audioRateControlHandler(BoolMenuItem &item, const Input::Event &e)
+{
+	item.toggle();
+	optionAudioRateControl = item.on; // takes effect when sound is next started
+}
+
 #ifdef CONFIG_AUDIO_OPENSL_ES
 void OptionView::soundUnderrunCheckHandler(BoolMenuItem &item, const Input::Event &e)
 {
@@ -66,6 +73,19 @@ void touchCtrlConfigHandler(TextMenuItem &, const Input::Event &e)
 	#endif
 }
 
+#ifdef CONFIG_TRACE
+void exportTraceHandler(TextMenuItem &, const Input::Event &e)
+{
+	FsSys::cPath jsonPath, binPath;
+	string_printf(jsonPath, "%s/trace.json", EmuSystem::savePath());
+	string_printf(binPath, "%s/trace.bin", EmuSystem::savePath());
+	if(Trace::writeJSON(jsonPath) && Trace::writeBinary(binPath))
+		popup.printf(3, 0, "Wrote %s", jsonPath);
+	else
+		popup.post("Error writing trace", 3, 1);
+}
+#endif
+
 void autoSaveStateSet(MultiChoiceMenuItem &, int val)
 {
 	switch(val)
@@ -96,6 +116,70 @@ void OptionView::autoSaveStateInit()
 	autoSaveState.onValue().bind<&autoSaveStateSet>();
 }
 
+void rewindSet(MultiChoiceMenuItem &, int val)
+{
+	static const uint8 mb[] = { 0, 8, 16, 32, 64 };
+	optionRewind.val = mb[val];
+	logMsg("set rewind history %dMB", optionRewind.val);
+}
+
+void OptionView::rewindInit()
+{
+	static const char *str[] = { "Off", "8MB", "16MB", "32MB", "64MB" };
+	int val = 0;
+	switch(optionRewind.val)
+	{
+		bcase 8: val = 1;
+		bcase 16: val = 2;
+		bcase 32: val = 3;
+		bcase 64: val = 4;
+	}
+	rewind.init(str, val, sizeofArray(str));
+	rewind.onValue().bind<&rewindSet>();
+}
+
+static const uint8 fastForwardSpeedVal[] = { 2, 3, 4, 8, 16, 0 };
+
+void fastForwardSpeedSet(MultiChoiceMenuItem &, int val)
+{
+	optionFastForwardSpeed.val = fastForwardSpeedVal[val];
+	logMsg("set fast-forward speed %dx", optionFastForwardSpeed.val);
+}
+
+void OptionView::fastForwardSpeedInit()
+{
+	static const char *str[] = { "2x", "3x", "4x", "8x", "16x", "Unlimited" };
+	int val = sizeofArray(str) - 1;
+	iterateTimes(sizeofArray(fastForwardSpeedVal), i)
+	{
+		if(fastForwardSpeedVal[i] == optionFastForwardSpeed.val)
+		{
+			val = i;
+			break;
+		}
+	}
+	fastForwardSpeed.init(str, val, sizeofArray(str));
+	fastForwardSpeed.onValue().bind<&fastForwardSpeedSet>();
+}
+
+void runAheadSet(MultiChoiceMenuItem &, int val)
+{
+	optionRunAhead.val = val;
+	logMsg("set run-ahead %d frame(s)", val);
+	if(EmuSystem::gameIsRunning())
+	{
+		EmuSystem::waitEmuThreadIdle();
+		RunAhead::init();
+	}
+}
+
+void OptionView::runAheadInit()
+{
+	static const char *str[] = { "Off", "1 Frame", "2 Frames", "3 Frames" };
+	runAhead.init(str, IG::min((uint)optionRunAhead.val, RunAhead::maxFrames), sizeofArray(str));
+	runAhead.onValue().bind<&runAheadSet>();
+}
+
 void statusBarSet(MultiChoiceMenuItem &, int val)
 {
 	optionHideStatusBar = val;
@@ -188,6 +272,19 @@ void OptionView::audioRateInit()
 	audioRate.onValue().bind<&audioRateSet>();
 }
 
+void resamplerQualitySet(MultiChoiceMenuItem &, int val)
+{
+	optionResamplerQuality.val = val; // takes effect when sound is next started
+	logMsg("set resampler quality %d", val);
+}
+
+void OptionView::resamplerQualityInit()
+{
+	static const char *str[] = { "Low", "Medium", "High" };
+	resamplerQuality.init(str, IG::min((uint)optionResamplerQuality, (uint)Resampler::QUALITY_HIGH), sizeofArray(str));
+	resamplerQuality.onValue().bind<&resamplerQualitySet>();
+}
+
 #ifdef CONFIG_BASE_ANDROID
 
 	#ifdef SUPPORT_ANDROID_DIRECT_TEXTURE
@@ -291,6 +388,12 @@ void ditherHandler(BoolMenuItem &item, const Input::Event &e)
 	Gfx::setDither(item.on);
 }
 
+void emuThreadHandler(BoolMenuItem &item, const Input::Event &e)
+{
+	item.toggle();
+	optionEmuThread = item.on; // takes effect when emulation is next started
+}
+
 void navViewHandler(BoolMenuItem &item, const Input::Event &e)
 {
 	item.toggle();
@@ -537,6 +640,22 @@ void OptionView::imgFilterInit()
 }
 #endif
 
+void videoFilterSet(MultiChoiceMenuItem &, int val)
+{
+	optionVideoFilter.val = val;
+	logMsg("set video filter %d", val);
+	VideoFilter::setFilter(val);
+	if(emuView.disp.img)
+		emuView.reinitImage();
+}
+
+void OptionView::videoFilterInit()
+{
+	static const char *str[] = { "None", "Scale2x", "Scale3x", "hq2x", "hq3x" };
+	videoFilter.init(str, IG::min((uint)optionVideoFilter.val, VideoFilter::filters - 1), sizeofArray(str));
+	videoFilter.onValue().bind<&videoFilterSet>();
+}
+
 void overlayEffectSet(MultiChoiceMenuItem &, int val)
 {
 	uint setVal = 0;
@@ -762,10 +881,16 @@ void OptionView::loadVideoItems(MenuItem *item[], uint &items)
 {
 	name_ = "Video Options";
 	if(!optionFrameSkip.isConst) { frameSkipInit(); item[items++] = &frameSkip; }
+	if(!optionEmuThread.isConst)
+	{
+		emuThread.init(optionEmuThread); item[items++] = &emuThread;
+		emuThread.selectDelegate().bind<&emuThreadHandler>();
+	}
 	if(!optionGameOrientation.isConst) { gameOrientationInit(); item[items++] = &gameOrientation; }
 	aspectRatioInit(); item[items++] = &aspectRatio;
 	overlayEffectInit(); item[items++] = &overlayEffect;
 	overlayEffectLevelInit(); item[items++] = &overlayEffectLevel;
+	videoFilterInit(); item[items++] = &videoFilter;
 	zoomInit(); item[items++] = &zoom;
 	#ifdef CONFIG_BASE_ANDROID
 		#ifdef SUPPORT_ANDROID_DIRECT_TEXTURE
@@ -805,6 +930,8 @@ void OptionView::loadAudioItems(MenuItem *item[], uint &items)
 	name_ = "Audio Options";
 	snd.init(optionSound); item[items++] = &snd;
 	if(!optionSoundRate.isConst) { audioRateInit(); item[items++] = &audioRate; }
+	if(!optionAudioRateControl.isConst) { audioRateControl.init(optionAudioRateControl); item[items++] = &audioRateControl; }
+	resamplerQualityInit(); item[items++] = &resamplerQuality;
 #ifdef CONFIG_AUDIO_CAN_USE_MAX_BUFFERS_HINT
 	soundBuffersInit(); item[items++] = &soundBuffers;
 #endif
@@ -822,6 +949,7 @@ void OptionView::loadInputItems(MenuItem *item[], uint &items)
 		touchCtrlConfig.init(); item[items++] = &touchCtrlConfig;
 		touchCtrlConfig.selectDelegate().bind<&touchCtrlConfigHandler>();
 	}
+	runAheadInit(); item[items++] = &runAhead;
 	#ifdef CONFIG_BLUETOOTH
 	btScanSecsInit(); item[items++] = &btScanSecs;
 	if(!optionKeepBluetoothActive.isConst)
@@ -842,6 +970,8 @@ void OptionView::loadSystemItems(MenuItem *item[], uint &items)
 {
 	name_ = "System Options";
 	autoSaveStateInit(); item[items++] = &autoSaveState;
+	rewindInit(); item[items++] = &rewind;
+	fastForwardSpeedInit(); item[items++] = &fastForwardSpeed;
 	confirmAutoLoadState.init(optionConfirmAutoLoadState); item[items++] = &confirmAutoLoadState;
 	confirmAutoLoadState.selectDelegate().bind<&confirmAutoLoadStateHandler>();
 	confirmOverwriteState.init(optionConfirmOverwriteState); item[items++] = &confirmOverwriteState;
@@ -849,6 +979,10 @@ void OptionView::loadSystemItems(MenuItem *item[], uint &items)
 	printPathMenuEntryStr(savePathStr);
 	savePath.init(savePathStr, optionConfirmAutoLoadState); item[items++] = &savePath;
 	savePath.selectDelegate().bind<OptionView, &OptionView::savePathHandler>(this);
+	#ifdef CONFIG_TRACE
+	exportTrace.init(); item[items++] = &exportTrace;
+	exportTrace.selectDelegate().bind<&exportTraceHandler>();
+	#endif
 	#if defined(CONFIG_INPUT_ANDROID) && CONFIG_ENV_ANDROID_MINSDK >= 9
 	processPriorityInit(); item[items++] = &processPriority;
 	#endif
@@ -0,0 +1,242 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "resampler"
+#include <Resampler.hh>
+#include <mem/interface.h>
+#include <logger/interface.h>
+#include <math.h>
+#include <string.h>
+
+#if defined __SSE2__
+	#define CONFIG_RESAMPLER_SSE2
+	#include <emmintrin.h>
+#elif defined __ARM_NEON__ || defined __ARM_NEON
+	#define CONFIG_RESAMPLER_NEON
+	#include <arm_neon.h>
+#endif
+
+static const uint phaseBits = 9;
+static const uint phases = 1 << phaseBits;
+static const uint maxTaps = 128;
+static const double maxAdjust = .05; // limit of setRatioAdjust() in either direction
+
+// taps are always a multiple of 8 so the kernels need no tail loop
+#if defined CONFIG_RESAMPLER_SSE2
+static int32 dot(const int16 *x, const int16 *h, uint taps)
+{
+	__m128i acc = _mm_setzero_si128();
+	for(uint i = 0; i < taps; i += 8)
+	{
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&x[i]),
+			_mm_loadu_si128((const __m128i*)&h[i])));
+	}
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(acc);
+}
+#elif defined CONFIG_RESAMPLER_NEON
+static int32 dot(const int16 *x, const int16 *h, uint taps)
+{
+	int32x4_t acc = vdupq_n_s32(0);
+	for(uint i = 0; i < taps; i += 8)
+	{
+		int16x8_t xv = vld1q_s16(&x[i]), hv = vld1q_s16(&h[i]);
+		acc = vmlal_s16(acc, vget_low_s16(xv), vget_low_s16(hv));
+		acc = vmlal_s16(acc, vget_high_s16(xv), vget_high_s16(hv));
+	}
+	int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+	return vget_lane_s32(vpadd_s32(sum, sum), 0);
+}
+#else
+static int32 dot(const int16 *x, const int16 *h, uint taps)
+{
+	int32 acc = 0;
+	iterateTimes(taps, i)
+	{
+		acc += x[i] * h[i];
+	}
+	return acc;
+}
+#endif
+
+const char *Resampler::kernelName()
+{
+	#if defined CONFIG_RESAMPLER_SSE2
+	return "SSE2";
+	#elif defined CONFIG_RESAMPLER_NEON
+	return "NEON";
+	#else
+	return "C";
+	#endif
+}
+
+static double besselI0(double x)
+{
+	double sum = 1, term = 1;
+	for(uint k = 1; k < 64; k++)
+	{
+		double t = x / (2 * k);
+		term *= t * t;
+		sum += term;
+		if(term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+// Kaiser-windowed sinc for every phase, each normalized to unity gain in Q15
+static void designFilter(int16 *coef, uint taps, double cutoff, double beta)
+{
+	const double half = taps / 2, i0Beta = besselI0(beta);
+	double h[maxTaps];
+	iterateTimes(phases, p)
+	{
+		// tap k is input frame idx + k, the output frame sits between taps half-1 and half
+		double frac = (double)p / phases;
+		double sum = 0;
+		iterateTimes(taps, k)
+		{
+			double t = (double)k - (half - 1) - frac;
+			double x = t / half;
+			double w = x * x < 1 ? besselI0(beta * sqrt(1 - x * x)) / i0Beta : 0;
+			double arg = 2 * cutoff * t * M_PI;
+			h[k] = 2 * cutoff * (arg == 0 ? 1 : sin(arg) / arg) * w;
+			sum += h[k];
+		}
+		auto dest = &coef[p * taps];
+		int total = 0;
+		uint peak = 0;
+		iterateTimes(taps, k)
+		{
+			dest[k] = IG::min(lround(h[k] / sum * 32768), 32767L);
+			total += dest[k];
+			if(dest[k] > dest[peak])
+				peak = k;
+		}
+		// put the rounding error on the largest tap so DC passes unchanged
+		dest[peak] = IG::min(dest[peak] + (32768 - total), 32767);
+	}
+}
+
+bool Resampler::init(uint inRate, uint outRate, uint channels, uint quality, uint maxInFrames)
+{
+	deinit();
+	assert(inRate && outRate && channels);
+	static const uint baseTaps[] { 8, 16, 32 };
+	static const double rolloff[] { .85, .9, .94 }, beta[] { 5, 6.5, 8.5 };
+	quality = IG::min(quality, (uint)QUALITY_HIGH);
+	double ratio = (double)outRate / inRate;
+	// when decimating, widen the filter in proportion so the transition band stays the same in output terms
+	uint taps = baseTaps[quality];
+	if(ratio < 1)
+		taps = IG::min(((uint)ceil(taps / ratio) + 7) & ~7U, maxTaps);
+	double cutoff = .5 * IG::min(ratio, 1.) * rolloff[quality];
+	histCap = maxInFrames + taps;
+	coef = (int16*)mem_alloc(sizeof(int16) * phases * taps);
+	hist = (int16*)mem_calloc(channels * histCap, sizeof(int16));
+	if(!coef || !hist)
+	{
+		logErr("out of memory for %u tap filter", taps);
+		deinit();
+		return 0;
+	}
+	designFilter(coef, taps, cutoff, beta[quality]);
+	taps_ = taps;
+	channels_ = channels;
+	inRate_ = inRate;
+	outRate_ = outRate;
+	maxIn = maxInFrames;
+	nominalStep = step = ((uint64)inRate << 32) / outRate;
+	clear();
+	logMsg("%u -> %uHz, %u taps, %s kernel", inRate, outRate, taps, kernelName());
+	return 1;
+}
+
+void Resampler::deinit()
+{
+	mem_freeSafe(coef);
+	mem_freeSafe(hist);
+	histFrames = histCap = taps_ = 0;
+}
+
+void Resampler::setRatioAdjust(double adjust)
+{
+	adjust = IG::max(IG::min(adjust, 1. + maxAdjust), 1. - maxAdjust);
+	step = nominalStep / adjust;
+}
+
+void Resampler::clear()
+{
+	if(!hist)
+		return;
+	// start centered on the first new input frame
+	histFrames = taps_ / 2 - 1;
+	iterateTimes(channels_, c)
+	{
+		memset(&hist[c * histCap], 0, histFrames * sizeof(int16));
+	}
+	pos = 0;
+}
+
+uint Resampler::maxOutFrames(uint inFrames) const
+{
+	uint64 minStep = nominalStep / (1. + maxAdjust);
+	return ((uint64)(inFrames + taps_) << 32) / minStep + 1;
+}
+
+uint Resampler::process(const int16 *in, uint inFrames, int16 *out)
+{
+	assert(inFrames <= maxIn);
+	const uint channels = channels_, taps = taps_;
+	iterateTimes(channels, c)
+	{
+		auto plane = &hist[c * histCap + histFrames];
+		iterateTimes(inFrames, i)
+		{
+			plane[i] = in[i * channels + c];
+		}
+	}
+	histFrames += inFrames;
+
+	uint outFrames = 0;
+	while((uint)(pos >> 32) + taps <= histFrames)
+	{
+		uint idx = pos >> 32;
+		auto h = &coef[((uint32)pos >> (32 - phaseBits)) * taps];
+		iterateTimes(channels, c)
+		{
+			int32 s = (dot(&hist[c * histCap + idx], h, taps) + (1 << 14)) >> 15;
+			out[c] = s > 32767 ? 32767 : s < -32768 ? -32768 : s;
+		}
+		out += channels;
+		outFrames++;
+		pos += step;
+	}
+
+	// keep the frames the next window still needs at the front of the history
+	uint consumed = IG::min((uint)(pos >> 32), histFrames);
+	if(consumed)
+	{
+		histFrames -= consumed;
+		iterateTimes(channels, c)
+		{
+			auto plane = &hist[c * histCap];
+			memmove(plane, &plane[consumed], histFrames * sizeof(int16));
+		}
+		pos -= (uint64)consumed << 32;
+	}
+	return outFrames;
+}
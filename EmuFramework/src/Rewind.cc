@@ -0,0 +1,219 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "rewind"
+#include <Rewind.hh>
+#include <EmuSystem.hh>
+#include <EmuOptions.hh>
+#include <mem/interface.h>
+#include <logger/interface.h>
+#include <util/memory.h>
+
+namespace Rewind
+{
+
+bool active = 0;
+
+struct Entry
+{
+	uint offset, words;
+	uint stateBytes; // size of the snapshot the delta restores
+};
+
+static const uint maxEntries = 8192;
+static Entry entry[maxEntries];
+static uint oldestEntry = 0, entries = 0;
+static uint32 *ring = nullptr;
+static uint ringWords = 0;
+static uint32 *current = nullptr, *next = nullptr, *encBuff = nullptr;
+static uint stateBytes = 0, stateWords = 0;
+static uint currentBytes = 0; // size saveMemState() wrote for current
+static bool haveCurrent = 0;
+static uint frameCount = 0;
+
+static Entry &newest() { return entry[(oldestEntry + entries - 1) % maxEntries]; }
+static void dropOldest() { oldestEntry = (oldestEntry + 1) % maxEntries; entries--; }
+static void dropNewest() { entries--; }
+
+// Delta of a against b as runs of [equal words][differing words][a ^ b for each
+// differing word], at most words * 3/2 + 2 words long
+static uint encodeDelta(const uint32 *a, const uint32 *b, uint words, uint32 *out)
+{
+	uint32 *o = out;
+	uint i = 0;
+	while(i < words)
+	{
+		uint skipStart = i;
+		while(i < words && a[i] == b[i])
+			i++;
+		uint copyStart = i;
+		while(i < words && a[i] != b[i])
+			i++;
+		*o++ = copyStart - skipStart;
+		*o++ = i - copyStart;
+		for(uint j = copyStart; j < i; j++)
+			*o++ = a[j] ^ b[j];
+	}
+	return o - out;
+}
+
+static void applyDelta(uint32 *state, const uint32 *in, uint words)
+{
+	auto end = in + words;
+	while(in < end)
+	{
+		state += *in++;
+		uint copy = *in++;
+		iterateTimes(copy, i)
+		{
+			*state++ ^= *in++;
+		}
+	}
+}
+
+static void clearHistory()
+{
+	oldestEntry = entries = 0;
+}
+
+static bool push(const uint32 *data, uint words, uint bytes)
+{
+	if(words > ringWords)
+		return 0;
+	if(entries == maxEntries)
+		dropOldest();
+	uint pos = entries ? newest().offset + newest().words : 0;
+	if(pos + words > ringWords)
+	{
+		// wrap, everything still stored past this point is older than what's at the start
+		while(entries && entry[oldestEntry].offset >= pos)
+			dropOldest();
+		pos = 0;
+	}
+	while(entries && entry[oldestEntry].offset < pos + words
+		&& pos < entry[oldestEntry].offset + entry[oldestEntry].words)
+	{
+		dropOldest();
+	}
+	memcpy(&ring[pos], data, words * 4);
+	entry[(oldestEntry + entries) % maxEntries] = { pos, words, bytes };
+	entries++;
+	return 1;
+}
+
+void init()
+{
+	uint ringBytes = (uint)optionRewind * 1024 * 1024;
+	uint bytes = ringBytes ? EmuSystem::maxMemStateSize() : 0;
+	if(!bytes)
+	{
+		deinit();
+		return;
+	}
+	if(active && bytes == stateBytes && ringBytes == ringWords * 4)
+		return;
+	deinit();
+	stateBytes = bytes;
+	stateWords = (bytes + 3) / 4;
+	ringWords = ringBytes / 4;
+	current = (uint32*)mem_calloc(stateWords * 4);
+	next = (uint32*)mem_calloc(stateWords * 4);
+	encBuff = (uint32*)mem_alloc((stateWords * 3/2 + 2) * 4);
+	ring = (uint32*)mem_alloc(ringWords * 4);
+	if(!current || !next || !encBuff || !ring)
+	{
+		logErr("out of memory for %u byte rewind buffer", ringBytes);
+		deinit();
+		return;
+	}
+	clearHistory();
+	haveCurrent = 0;
+	frameCount = 0;
+	active = 1;
+	logMsg("rewind active with %u byte states, %u byte buffer", stateBytes, ringBytes);
+}
+
+void deinit()
+{
+	if(!active)
+		return;
+	logMsg("freeing rewind buffer, %u snapshots stored", entries);
+	mem_freeSafe(current); current = nullptr;
+	mem_freeSafe(next); next = nullptr;
+	mem_freeSafe(encBuff); encBuff = nullptr;
+	mem_freeSafe(ring); ring = nullptr;
+	stateBytes = stateWords = ringWords = 0;
+	clearHistory();
+	active = 0;
+}
+
+static void capture()
+{
+	auto state = haveCurrent ? next : current;
+	uint bytes = EmuSystem::saveMemState((uchar*)state, stateBytes);
+	if(!bytes)
+	{
+		logErr("error saving snapshot");
+		return;
+	}
+	if(!haveCurrent)
+	{
+		haveCurrent = 1;
+		currentBytes = bytes;
+		return;
+	}
+	// store what turns the new snapshot back into the previous one
+	uint words = encodeDelta(next, current, stateWords, encBuff);
+	if(!push(encBuff, words, currentBytes))
+	{
+		logWarn("%u word delta doesn't fit in rewind buffer", words);
+		clearHistory();
+	}
+	IG::swap(current, next);
+	currentBytes = bytes;
+}
+
+void onFrames(uint frames)
+{
+	frameCount += frames;
+	if(frameCount < snapshotInterval)
+		return;
+	frameCount = 0;
+	capture();
+}
+
+bool stepBack()
+{
+	if(!active || !haveCurrent)
+		return 0;
+	if(entries)
+	{
+		auto &e = newest();
+		applyDelta(current, &ring[e.offset], e.words);
+		currentBytes = e.stateBytes;
+		dropNewest();
+	}
+	frameCount = 0;
+	if(!EmuSystem::loadMemState((uchar*)current, currentBytes))
+	{
+		logErr("error loading snapshot, clearing history");
+		clearHistory();
+		haveCurrent = 0;
+		return 0;
+	}
+	return 1;
+}
+
+}
@@ -0,0 +1,207 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "romCache"
+#include <RomCache.hh>
+#include <base/Base.hh>
+#include <mem/interface.h>
+#include <logger/interface.h>
+#include <util/strings.h>
+
+#ifdef CONFIG_FS_POSIX
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#endif
+
+namespace RomCache
+{
+
+#ifdef CONFIG_FS_POSIX
+
+static const char entrySuffix[] = ".rom";
+
+static void cacheDir(FsSys::cPath &dir)
+{
+	#ifdef CONFIG_BASE_USES_SHARED_DOCUMENTS_DIR
+	snprintf(dir, sizeof(dir), "%s/explusalpha.com/RomCache", Base::documentsPath());
+	#else
+	snprintf(dir, sizeof(dir), "%s/RomCache", Base::documentsPath());
+	#endif
+}
+
+static uint32 pathHash(const char *path)
+{
+	// FNV-1a
+	uint32 hash = 2166136261U;
+	for(; *path; path++)
+	{
+		hash ^= (uchar)*path;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static bool entryPath(const char *archivePath, uint32 crc, FsSys::cPath &path)
+{
+	struct stat s;
+	if(stat(archivePath, &s) != 0)
+		return 0;
+	FsSys::cPath dir;
+	cacheDir(dir);
+	snprintf(path, sizeof(path), "%s/%08X%08X%08X%s", dir, pathHash(archivePath),
+		(uint32)s.st_mtime, crc, entrySuffix);
+	return 1;
+}
+
+bool lookup(const char *archivePath, uint32 crc, FsSys::cPath &path)
+{
+	if(!entryPath(archivePath, crc, path))
+		return 0;
+	struct stat s;
+	if(stat(path, &s) != 0 || !S_ISREG(s.st_mode))
+		return 0;
+	// the modification time orders entries for eviction
+	utimes(path, nullptr);
+	logMsg("cache hit for %s", archivePath);
+	return 1;
+}
+
+struct Entry
+{
+	char name[32];
+	time_t mtime;
+	uint size;
+};
+
+static int compareEntryAge(const void *a, const void *b)
+{
+	auto &e1 = *(const Entry*)a, &e2 = *(const Entry*)b;
+	if(e1.mtime < e2.mtime)
+		return -1;
+	else if(e1.mtime > e2.mtime)
+		return 1;
+	return 0;
+}
+
+static void trim(const char *dirPath)
+{
+	DIR *dir = opendir(dirPath);
+	if(!dir)
+		return;
+	uint entries = 0, maxEntries = 64;
+	auto entry = (Entry*)mem_alloc(sizeof(Entry) * maxEntries);
+	uint64 totalSize = 0;
+	FsSys::cPath path;
+	while(entry)
+	{
+		struct dirent *d = readdir(dir);
+		if(!d)
+			break;
+		uint len = strlen(d->d_name);
+		if(len >= sizeof(Entry::name) || len < sizeof(entrySuffix)
+			|| !string_equal(&d->d_name[len - (sizeof(entrySuffix) - 1)], entrySuffix))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dirPath, d->d_name);
+		struct stat s;
+		if(stat(path, &s) != 0)
+			continue;
+		if(entries == maxEntries)
+		{
+			maxEntries *= 2;
+			auto newEntry = (Entry*)mem_realloc(entry, sizeof(Entry) * maxEntries);
+			if(!newEntry)
+			{
+				mem_free(entry);
+				entry = nullptr;
+				break;
+			}
+			entry = newEntry;
+		}
+		string_copy(entry[entries].name, d->d_name, sizeof(Entry::name));
+		entry[entries].mtime = s.st_mtime;
+		entry[entries].size = s.st_size;
+		totalSize += s.st_size;
+		entries++;
+	}
+	closedir(dir);
+	if(!entry)
+	{
+		logErr("out of memory listing cache");
+		return;
+	}
+
+	qsort(entry, entries, sizeof(Entry), compareEntryAge);
+	// oldest first, always keep the newest entry even if it's over the limit by itself
+	for(uint i = 0; totalSize > maxSize && i + 1 < entries; i++)
+	{
+		snprintf(path, sizeof(path), "%s/%s", dirPath, entry[i].name);
+		logMsg("removing %s from cache", entry[i].name);
+		FsSys::remove(path);
+		totalSize -= entry[i].size;
+	}
+	mem_free(entry);
+}
+
+bool store(const char *archivePath, uint32 crc, const void *data, uint size)
+{
+	if(size > maxSize)
+		return 0;
+	FsSys::cPath path, tempPath, dir;
+	if(!entryPath(archivePath, crc, path))
+		return 0;
+	cacheDir(dir);
+	#ifdef CONFIG_BASE_USES_SHARED_DOCUMENTS_DIR
+	{
+		FsSys::cPath parentDir;
+		snprintf(parentDir, sizeof(parentDir), "%s/explusalpha.com", Base::documentsPath());
+		FsSys::mkdir(parentDir);
+	}
+	#endif
+	FsSys::mkdir(dir);
+
+	// written under a temporary name so an interrupted write never looks like a valid entry
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+	FILE *f = fopen(tempPath, "wb");
+	if(!f)
+	{
+		logErr("can't create %s", tempPath);
+		return 0;
+	}
+	bool ok = fwrite(data, 1, size, f) == size;
+	if(fclose(f) != 0)
+		ok = 0;
+	if(!ok || FsSys::rename(tempPath, path) != OK)
+	{
+		logErr("error writing %s", path);
+		FsSys::remove(tempPath);
+		return 0;
+	}
+	logMsg("cached %u bytes from %s", size, archivePath);
+	trim(dir);
+	return 1;
+}
+
+#else
+
+bool lookup(const char *archivePath, uint32 crc, FsSys::cPath &path) { return 0; }
+bool store(const char *archivePath, uint32 crc, const void *data, uint size) { return 0; }
+
+#endif
+
+}
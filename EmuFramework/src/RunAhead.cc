@@ -0,0 +1,114 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "runAhead"
+#include <RunAhead.hh>
+#include <EmuSystem.hh>
+#include <EmuOptions.hh>
+#include <mem/interface.h>
+#include <logger/interface.h>
+#include <util/time/sys.hh>
+
+namespace RunAhead
+{
+
+uint frames = 0;
+
+static uchar *state = nullptr;
+static uint stateSize = 0;
+static const double timeSmoothing = .05;
+static const uint logInterval = 600; // frames between timing reports
+static double saveMsAvg = 0, loadMsAvg = 0;
+static uint framesSinceLog = 0;
+
+void init()
+{
+	uint aheadFrames = IG::min((uint)optionRunAhead, maxFrames);
+	uint size = aheadFrames ? EmuSystem::maxMemStateSize() : 0;
+	if(!size)
+	{
+		deinit();
+		return;
+	}
+	if(frames && size == stateSize)
+	{
+		frames = aheadFrames;
+		return;
+	}
+	deinit();
+	state = (uchar*)mem_alloc(size);
+	if(!state)
+	{
+		logErr("out of memory for %u byte run-ahead state", size);
+		return;
+	}
+	stateSize = size;
+	saveMsAvg = loadMsAvg = 0;
+	framesSinceLog = 0;
+	frames = aheadFrames;
+	logMsg("running %u frame(s) ahead with %u byte states", frames, stateSize);
+}
+
+void deinit()
+{
+	if(!state)
+		return;
+	logMsg("stopping run-ahead, state save %.3fms, load %.3fms", saveMsAvg, loadMsAvg);
+	mem_freeSafe(state); state = nullptr;
+	stateSize = 0;
+	frames = 0;
+}
+
+static void updateAverage(double &avg, double ms)
+{
+	avg = avg ? avg + (ms - avg) * timeSmoothing : ms;
+}
+
+void runFrame(bool renderAudio)
+{
+	// the real frame, its audio is the only audio heard
+	EmuSystem::runFrame(0, 0, renderAudio);
+	auto saveStart = TimeSys::timeNow();
+	uint bytes = EmuSystem::saveMemState(state, stateSize);
+	if(unlikely(!bytes))
+	{
+		logErr("error saving state, disabling run-ahead");
+		deinit();
+		return;
+	}
+	auto saveEnd = TimeSys::timeNow();
+	iterateTimes(frames - 1, i)
+	{
+		EmuSystem::runFrame(0, 0, 0);
+	}
+	EmuSystem::runFrame(1, 1, 0);
+	auto loadStart = TimeSys::timeNow();
+	if(unlikely(!EmuSystem::loadMemState(state, bytes)))
+	{
+		logErr("error restoring state, disabling run-ahead");
+		deinit();
+		return;
+	}
+	auto loadEnd = TimeSys::timeNow();
+	updateAverage(saveMsAvg, double(saveEnd - saveStart) * 1000.);
+	updateAverage(loadMsAvg, double(loadEnd - loadStart) * 1000.);
+	if(++framesSinceLog == logInterval)
+	{
+		logMsg("state save %.3fms, load %.3fms", saveMsAvg, loadMsAvg);
+		framesSinceLog = 0;
+	}
+}
+
+}
@@ -17,6 +17,7 @@
 #include <data-type/image/libpng/reader.h>
 #include <io/sys.hh>
 #include <fs/sys.hh>
+#include <pixmap/PixelConvert.hh>
 
 static void png_ioWriter(png_structp pngPtr, png_bytep data, png_size_t length)
 {
@@ -36,6 +37,11 @@ static void png_ioFlush(png_structp pngPtr)
 
 bool writeScreenshot(const Pixmap &vidPix, const char *fname)
 {
+	if(!PixelConvert::supports(vidPix.format, PixelFormatRGB888))
+	{
+		logErr("can't write %s screenshot", vidPix.format.name);
+		return 0;
+	}
 	Io *fp = IoSys::create(fname);
 	if(!fp)
 	{
@@ -83,23 +89,7 @@ bool writeScreenshot(const Pixmap &vidPix, const char *fname)
 	uint8 *screen = vidPix.data;
 	for(uint y=0; y < vidPix.y; y++, screen+=vidPix.pitch)
 	{
-		png_byte *rowpix = rowPtr;
-		for(uint x=0; x < vidPix.x; x++)
-		{
-			// assumes RGB565
-			uint16 pixVal = *(uint16 *)(screen+2*x);
-			uint32 r = pixVal >> 11, g = (pixVal >> 5) & 0x3f, b = pixVal & 0x1f;
-			r *= 8; g *= 4; b *= 8;
-			*(rowpix++) = r;
-			*(rowpix++) = g;
-			*(rowpix++) = b;
-			if(imgwidth!=vidPix.x)
-			{
-				*(rowpix++) = r;
-				*(rowpix++) = g;
-				*(rowpix++) = b;
-			}
-		}
+		PixelConvert::convertRow(vidPix.format, screen, PixelFormatRGB888, rowPtr, vidPix.x);
 		png_write_row(pngPtr, rowPtr);
 		if(imgheight!=vidPix.y)
 			png_write_row(pngPtr, rowPtr);
@@ -0,0 +1,322 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "stateFile"
+#include <StateFile.hh>
+#include <logger/interface.h>
+#include <string.h>
+#include <zlib.h>
+
+namespace StateFile
+{
+
+static const char magic[8] { 'E', 'M', 'U', 'S', 'T', 'A', 'T', 'E' };
+static const uint formatVersion = 1;
+static const char stateTag[4] { 'S', 'T', 'A', 'T' };
+static const uint stateChunkVersion = 1;
+
+enum { CODEC_NONE, CODEC_LZ4 };
+
+static void write16(uchar *p, uint v) { p[0] = v; p[1] = v >> 8; }
+static void write32(uchar *p, uint32 v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+static uint read16(const uchar *p) { return p[0] | (p[1] << 8); }
+static uint32 read32(const uchar *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32)p[3] << 24); }
+
+bool isContainer(const uchar *data, uint size)
+{
+	return size >= headerSize && memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+uint packBound(uint stateBytes)
+{
+	return headerSize + chunkHeaderSize + compressBound(stateBytes);
+}
+
+uint pack(const uchar *state, uint stateBytes, uchar *dest)
+{
+	memcpy(dest, magic, sizeof(magic));
+	write16(&dest[8], formatVersion);
+	write16(&dest[10], headerSize);
+	write32(&dest[12], 1);
+	auto chunk = &dest[headerSize];
+	auto payload = &chunk[chunkHeaderSize];
+	uint codec = CODEC_LZ4;
+	uint stored = compress(state, stateBytes, payload);
+	if(stored >= stateBytes)
+	{
+		codec = CODEC_NONE;
+		memcpy(payload, state, stateBytes);
+		stored = stateBytes;
+	}
+	memcpy(chunk, stateTag, sizeof(stateTag));
+	chunk[4] = codec;
+	chunk[5] = stateChunkVersion;
+	write16(&chunk[6], 0);
+	write32(&chunk[8], stateBytes);
+	write32(&chunk[12], stored);
+	write32(&chunk[16], adler32(adler32(0, nullptr, 0), state, stateBytes));
+	return headerSize + chunkHeaderSize + stored;
+}
+
+// returns the STAT chunk, its stored data is within size
+static const uchar *findStateChunk(const uchar *data, uint size)
+{
+	if(!isContainer(data, size))
+		return nullptr;
+	uint version = read16(&data[8]), hdrSize = read16(&data[10]), chunks = read32(&data[12]);
+	if(version > formatVersion || hdrSize < headerSize || hdrSize > size)
+	{
+		logErr("unsupported state format %u", version);
+		return nullptr;
+	}
+	uint pos = hdrSize;
+	iterateTimes(chunks, i)
+	{
+		if(size - pos < chunkHeaderSize)
+			break;
+		auto chunk = &data[pos];
+		uint32 stored = read32(&chunk[12]);
+		if(stored > size - pos - chunkHeaderSize)
+			break;
+		pos += chunkHeaderSize + stored;
+		if(memcmp(chunk, stateTag, sizeof(stateTag)) == 0)
+			return chunk;
+	}
+	logErr("no state chunk found");
+	return nullptr;
+}
+
+uint stateSize(const uchar *data, uint size)
+{
+	auto chunk = findStateChunk(data, size);
+	return chunk ? read32(&chunk[8]) : 0;
+}
+
+uint unpack(const uchar *data, uint size, uchar *dest, uint destSize)
+{
+	auto chunk = findStateChunk(data, size);
+	if(!chunk)
+		return 0;
+	uint codec = chunk[4], chunkVersion = chunk[5];
+	uint32 raw = read32(&chunk[8]), stored = read32(&chunk[12]), checksum = read32(&chunk[16]);
+	auto payload = &chunk[chunkHeaderSize];
+	if(chunkVersion > stateChunkVersion || raw > destSize)
+	{
+		logErr("state chunk version %u with %u bytes not supported", chunkVersion, raw);
+		return 0;
+	}
+	if(codec == CODEC_LZ4)
+	{
+		if(decompress(payload, stored, dest, raw) != (int)raw)
+		{
+			logErr("corrupt compressed state");
+			return 0;
+		}
+	}
+	else if(codec == CODEC_NONE && stored == raw)
+		memcpy(dest, payload, raw);
+	else
+	{
+		logErr("unknown state codec %u", codec);
+		return 0;
+	}
+	if(adler32(adler32(0, nullptr, 0), dest, raw) != checksum)
+	{
+		logErr("state checksum mismatch");
+		return 0;
+	}
+	return raw;
+}
+
+// LZ4 block codec: sequences of a token (literal length << 4 | match length - 4),
+// extra length bytes for values >= 15, literals, then a 16-bit match offset.
+// The last sequence is literals only and covers at least the final 5 bytes.
+
+static const uint minMatch = 4, lastLiterals = 5, matchFindLimit = 12;
+static const uint hashBits = 12, maxOffset = 65535;
+
+static uint32 load32(const uchar *p)
+{
+	uint32 v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static uint hashSeq(uint32 seq)
+{
+	return (seq * 2654435761U) >> (32 - hashBits);
+}
+
+// number of equal bytes at a and b before limit
+static uint matchLength(const uchar *a, const uchar *b, const uchar *limit)
+{
+	auto start = a;
+	while(a + 8 <= limit)
+	{
+		uint64 x, y;
+		memcpy(&x, a, 8);
+		memcpy(&y, b, 8);
+		if(uint64 diff = x ^ y)
+		{
+			#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			return a - start + (__builtin_ctzll(diff) >> 3);
+			#else
+			return a - start + (__builtin_clzll(diff) >> 3);
+			#endif
+		}
+		a += 8;
+		b += 8;
+	}
+	while(a < limit && *a == *b)
+	{
+		a++;
+		b++;
+	}
+	return a - start;
+}
+
+static uchar *writeLength(uchar *op, uint len)
+{
+	for(; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+static uchar *writeLiterals(uchar *op, uchar *token, const uchar *lit, uint litLen)
+{
+	*token = IG::min(litLen, 15U) << 4;
+	if(litLen >= 15)
+		op = writeLength(op, litLen - 15);
+	memcpy(op, lit, litLen);
+	return op + litLen;
+}
+
+uint compressBound(uint bytes)
+{
+	return bytes + bytes / 255 + 16;
+}
+
+uint compress(const uchar *src, uint bytes, uchar *dest)
+{
+	uint32 table[1 << hashBits];
+	memset(table, 0, sizeof(table));
+	const uchar *ip = src, *anchor = src, *end = src + bytes;
+	uchar *op = dest;
+	if(bytes > matchFindLimit)
+	{
+		const uchar *ipLimit = end - matchFindLimit, *matchLimit = end - lastLiterals;
+		while(ip < ipLimit)
+		{
+			uint32 seq = load32(ip);
+			uint h = hashSeq(seq);
+			const uchar *ref = src + table[h];
+			table[h] = ip - src;
+			if(ref >= ip || ip - ref > (int)maxOffset || load32(ref) != seq)
+			{
+				// step faster through data that isn't matching
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+			while(ip > anchor && ref > src && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+			uint len = matchLength(ip + minMatch, ref + minMatch, matchLimit);
+			auto token = op++;
+			op = writeLiterals(op, token, anchor, ip - anchor);
+			write16(op, ip - ref);
+			op += 2;
+			*token |= IG::min(len, 15U);
+			if(len >= 15)
+				op = writeLength(op, len - 15);
+			ip += minMatch + len;
+			anchor = ip;
+			if(ip < ipLimit)
+				table[hashSeq(load32(ip - 2))] = ip - 2 - src;
+		}
+	}
+	auto token = op++;
+	op = writeLiterals(op, token, anchor, end - anchor);
+	return op - dest;
+}
+
+static bool readLength(const uchar *&ip, const uchar *iend, uint &len)
+{
+	uint b;
+	do
+	{
+		if(ip == iend)
+			return 0;
+		b = *ip++;
+		len += b;
+	} while(b == 255);
+	return 1;
+}
+
+int decompress(const uchar *src, uint srcBytes, uchar *dest, uint destBytes)
+{
+	const uchar *ip = src, *iend = src + srcBytes;
+	uchar *op = dest, *oend = dest + destBytes;
+	while(ip < iend)
+	{
+		uint token = *ip++;
+		uint lit = token >> 4;
+		if(lit == 15 && !readLength(ip, iend, lit))
+			return -1;
+		if(lit > (uint)(iend - ip) || lit > (uint)(oend - op))
+			return -1;
+		memcpy(op, ip, lit);
+		op += lit;
+		ip += lit;
+		if(ip == iend)
+			break; // final literals
+		if(iend - ip < 2)
+			return -1;
+		uint offset = read16(ip);
+		ip += 2;
+		uint len = token & 15;
+		if(len == 15 && !readLength(ip, iend, len))
+			return -1;
+		len += minMatch;
+		if(!offset || offset > (uint)(op - dest) || len > (uint)(oend - op))
+			return -1;
+		const uchar *ref = op - offset;
+		if(offset >= 8 && (uint)(oend - op) >= len + 8)
+		{
+			// 8 bytes at a time, may write up to 7 bytes past the match
+			auto mEnd = op + len;
+			do
+			{
+				memcpy(op, ref, 8);
+				op += 8;
+				ref += 8;
+			} while(op < mEnd);
+			op = mEnd;
+		}
+		else
+		{
+			iterateTimes(len, i)
+			{
+				op[i] = ref[i];
+			}
+			op += len;
+		}
+	}
+	return op - dest;
+}
+
+}
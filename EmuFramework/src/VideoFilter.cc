@@ -0,0 +1,358 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "videoFilter"
+#include <VideoFilter.hh>
+#include <scaler/hq2x.h>
+#include <scaler/hq3x.h>
+#include <mem/interface.h>
+#include <logger/interface.h>
+#include <util/thread/pthread.hh>
+#include <trace/Trace.hh>
+#include <unistd.h>
+
+#if defined __SSE2__
+	#define CONFIG_VIDEO_FILTER_SSE2
+	#include <emmintrin.h>
+#elif defined __ARM_NEON__ || defined __ARM_NEON
+	#define CONFIG_VIDEO_FILTER_NEON
+	#include <arm_neon.h>
+#endif
+
+namespace VideoFilter
+{
+
+uint active = NONE;
+
+typedef void (*BandFunc)(const Pixmap &src, Pixmap &dest, uint yStart, uint yEnd);
+
+static Pixmap out {PixelFormatRGB565};
+static uchar *outBuff = nullptr;
+static uint outBuffSize = 0;
+static BandFunc bandFunc = nullptr; // filter prepare() selected for the output pixmap
+static const uint minBandRows = 16;
+
+bool isValid(uint8 filter)
+{
+	return filter < filters;
+}
+
+template <class T>
+static const T *row(const Pixmap &pix, uint y)
+{
+	return (const T*)(pix.data + y * pix.pitch);
+}
+
+template <class T>
+static T *row(Pixmap &pix, uint y)
+{
+	return (T*)(pix.data + y * pix.pitch);
+}
+
+// Scale2x (EPX), output pixels only take the center's color or a neighbor's, so
+// any pixel format can be used as long as equal colors have equal values
+
+template <class T>
+static void scale2xPixel(const T *B, const T *E, const T *H, T *out0, T *out1, uint x, uint w)
+{
+	T b = B[x], d = E[x ? x-1 : x], e = E[x], f = E[x+1 < w ? x+1 : x], h = H[x];
+	out0[x*2] = (d == b && b != f && d != h) ? d : e;
+	out0[x*2+1] = (b == f && b != d && f != h) ? f : e;
+	out1[x*2] = (d == h && d != b && h != f) ? d : e;
+	out1[x*2+1] = (h == f && d != h && b != f) ? f : e;
+}
+
+// handles pixels [x, w-1) 8 at a time and returns where it stopped, x must be >= 1
+template <class T>
+static uint scale2xRowSIMD(const T *B, const T *E, const T *H, T *out0, T *out1, uint x, uint w)
+{
+	return x;
+}
+
+#if defined CONFIG_VIDEO_FILTER_SSE2
+template <>
+uint scale2xRowSIMD(const uint16 *B, const uint16 *E, const uint16 *H, uint16 *out0, uint16 *out1, uint x, uint w)
+{
+	for(; x + 8 < w; x += 8)
+	{
+		__m128i b = _mm_loadu_si128((const __m128i*)&B[x]);
+		__m128i d = _mm_loadu_si128((const __m128i*)&E[x-1]);
+		__m128i e = _mm_loadu_si128((const __m128i*)&E[x]);
+		__m128i f = _mm_loadu_si128((const __m128i*)&E[x+1]);
+		__m128i h = _mm_loadu_si128((const __m128i*)&H[x]);
+		__m128i eqDB = _mm_cmpeq_epi16(d, b), eqBF = _mm_cmpeq_epi16(b, f),
+			eqDH = _mm_cmpeq_epi16(d, h), eqHF = _mm_cmpeq_epi16(h, f);
+		__m128i c0 = _mm_andnot_si128(_mm_or_si128(eqBF, eqDH), eqDB);
+		__m128i c1 = _mm_andnot_si128(_mm_or_si128(eqDB, eqHF), eqBF);
+		__m128i c2 = _mm_andnot_si128(_mm_or_si128(eqDB, eqHF), eqDH);
+		__m128i c3 = _mm_andnot_si128(_mm_or_si128(eqDH, eqBF), eqHF);
+		__m128i e0 = _mm_or_si128(_mm_and_si128(c0, d), _mm_andnot_si128(c0, e));
+		__m128i e1 = _mm_or_si128(_mm_and_si128(c1, f), _mm_andnot_si128(c1, e));
+		__m128i e2 = _mm_or_si128(_mm_and_si128(c2, d), _mm_andnot_si128(c2, e));
+		__m128i e3 = _mm_or_si128(_mm_and_si128(c3, f), _mm_andnot_si128(c3, e));
+		_mm_storeu_si128((__m128i*)&out0[x*2], _mm_unpacklo_epi16(e0, e1));
+		_mm_storeu_si128((__m128i*)&out0[x*2+8], _mm_unpackhi_epi16(e0, e1));
+		_mm_storeu_si128((__m128i*)&out1[x*2], _mm_unpacklo_epi16(e2, e3));
+		_mm_storeu_si128((__m128i*)&out1[x*2+8], _mm_unpackhi_epi16(e2, e3));
+	}
+	return x;
+}
+#elif defined CONFIG_VIDEO_FILTER_NEON
+template <>
+uint scale2xRowSIMD(const uint16 *B, const uint16 *E, const uint16 *H, uint16 *out0, uint16 *out1, uint x, uint w)
+{
+	for(; x + 8 < w; x += 8)
+	{
+		uint16x8_t b = vld1q_u16(&B[x]);
+		uint16x8_t d = vld1q_u16(&E[x-1]);
+		uint16x8_t e = vld1q_u16(&E[x]);
+		uint16x8_t f = vld1q_u16(&E[x+1]);
+		uint16x8_t h = vld1q_u16(&H[x]);
+		uint16x8_t eqDB = vceqq_u16(d, b), eqBF = vceqq_u16(b, f),
+			eqDH = vceqq_u16(d, h), eqHF = vceqq_u16(h, f);
+		uint16x8x2_t top, bottom;
+		top.val[0] = vbslq_u16(vbicq_u16(eqDB, vorrq_u16(eqBF, eqDH)), d, e);
+		top.val[1] = vbslq_u16(vbicq_u16(eqBF, vorrq_u16(eqDB, eqHF)), f, e);
+		bottom.val[0] = vbslq_u16(vbicq_u16(eqDH, vorrq_u16(eqDB, eqHF)), d, e);
+		bottom.val[1] = vbslq_u16(vbicq_u16(eqHF, vorrq_u16(eqDH, eqBF)), f, e);
+		vst2q_u16(&out0[x*2], top);
+		vst2q_u16(&out1[x*2], bottom);
+	}
+	return x;
+}
+#endif
+
+template <class T>
+static void scale2xRows(const Pixmap &src, Pixmap &dest, uint yStart, uint yEnd)
+{
+	uint w = src.x, h = src.y;
+	for(uint y = yStart; y < yEnd; y++)
+	{
+		auto B = row<T>(src, y ? y-1 : y), E = row<T>(src, y), H = row<T>(src, y+1 < h ? y+1 : y);
+		auto out0 = row<T>(dest, y*2), out1 = row<T>(dest, y*2+1);
+		scale2xPixel(B, E, H, out0, out1, 0, w);
+		uint x = w > 1 ? scale2xRowSIMD(B, E, H, out0, out1, 1, w) : 1;
+		for(; x < w; x++)
+		{
+			scale2xPixel(B, E, H, out0, out1, x, w);
+		}
+	}
+}
+
+// Scale3x (AdvMAME3x)
+
+template <class T>
+static void scale3xRows(const Pixmap &src, Pixmap &dest, uint yStart, uint yEnd)
+{
+	uint w = src.x, h = src.y;
+	for(uint y = yStart; y < yEnd; y++)
+	{
+		auto above = row<T>(src, y ? y-1 : y), center = row<T>(src, y), below = row<T>(src, y+1 < h ? y+1 : y);
+		auto out0 = row<T>(dest, y*3), out1 = row<T>(dest, y*3+1), out2 = row<T>(dest, y*3+2);
+		iterateTimes(w, x)
+		{
+			uint xL = x ? x-1 : x, xR = x+1 < w ? x+1 : x;
+			T a = above[xL], b = above[x], c = above[xR],
+				d = center[xL], e = center[x], f = center[xR],
+				g = below[xL], h = below[x], i = below[xR];
+			if(b != h && d != f)
+			{
+				bool db = d == b, bf = b == f, dh = d == h, hf = h == f;
+				out0[x*3] = db ? d : e;
+				out0[x*3+1] = ((db && e != c) || (bf && e != a)) ? b : e;
+				out0[x*3+2] = bf ? f : e;
+				out1[x*3] = ((db && e != g) || (dh && e != a)) ? d : e;
+				out1[x*3+1] = e;
+				out1[x*3+2] = ((bf && e != i) || (hf && e != c)) ? f : e;
+				out2[x*3] = dh ? d : e;
+				out2[x*3+1] = ((dh && e != i) || (hf && e != g)) ? h : e;
+				out2[x*3+2] = hf ? f : e;
+			}
+			else
+			{
+				out0[x*3] = out0[x*3+1] = out0[x*3+2] = e;
+				out1[x*3] = out1[x*3+1] = out1[x*3+2] = e;
+				out2[x*3] = out2[x*3+1] = out2[x*3+2] = e;
+			}
+		}
+	}
+}
+
+static void hq2xRows(const Pixmap &src, Pixmap &dest, uint yStart, uint yEnd)
+{
+	hq2x_32_rows(src.data, src.pitch, dest.data, dest.pitch, src.x, src.y, yStart, yEnd);
+}
+
+static void hq3xRows(const Pixmap &src, Pixmap &dest, uint yStart, uint yEnd)
+{
+	hq3x_32_rows(src.data, src.pitch, dest.data, dest.pitch, src.x, src.y, yStart, yEnd);
+}
+
+// Worker pool, each job is a frame split into bands that any thread can claim
+
+static const uint maxWorkers = 7;
+static ThreadPThread worker[maxWorkers];
+static uint workers = 0;
+static MutexPThread jobMutex;
+static CondVarPThread jobCond, jobDoneCond;
+static uint jobId = 0, bands = 0, nextBand = 0, bandsLeft = 0;
+static const Pixmap *jobSrc = nullptr;
+
+// called with jobMutex locked, returns with it locked once no bands are left to claim
+static void runBands()
+{
+	while(nextBand < bands)
+	{
+		uint band = nextBand++;
+		uint rows = jobSrc->y;
+		uint yStart = rows * band / bands, yEnd = rows * (band + 1) / bands;
+		jobMutex.unlock();
+		bandFunc(*jobSrc, out, yStart, yEnd);
+		jobMutex.lock();
+		if(--bandsLeft == 0)
+			jobDoneCond.signal();
+	}
+}
+
+static ptrsize runWorker(ThreadPThread &thread)
+{
+	Trace::setThreadName("video filter");
+	jobMutex.lock();
+	uint lastJobId = jobId;
+	for(;;)
+	{
+		while(jobId == lastJobId)
+			jobCond.wait();
+		lastJobId = jobId;
+		runBands();
+	}
+	return 0;
+}
+
+static void startWorkers()
+{
+	static bool initSync = 0;
+	if(initSync)
+		return;
+	jobMutex.create();
+	jobCond.create(&jobMutex);
+	jobDoneCond.create(&jobMutex);
+	initSync = 1;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint threads = cpus > 1 ? IG::min(uint(cpus - 1), maxWorkers) : 0;
+	iterateTimes(threads, i)
+	{
+		if(!worker[i].create(1, ThreadPThread::EntryDelegate::create<&runWorker>()))
+		{
+			logErr("error creating filter worker thread %d", i);
+			break;
+		}
+		workers++;
+	}
+	logMsg("using %d worker threads for video filters", workers);
+}
+
+void setFilter(uint filter)
+{
+	if(!isValid(filter))
+		filter = NONE;
+	if(filter == active)
+		return;
+	active = filter;
+	if(filter == NONE)
+		return;
+	if(filter == HQ2X || filter == HQ3X)
+	{
+		// lookup tables are read-only after this so bands can share them
+		static bool hqInit = 0;
+		if(!hqInit)
+		{
+			hq2x_init();
+			hq3x_init();
+			hqInit = 1;
+		}
+	}
+	startWorkers();
+}
+
+Pixmap &prepare(Pixmap &src)
+{
+	if(!isActive())
+		return src;
+	uint bpp = src.format.bytesPerPixel;
+	if(bpp != 2 && bpp != 4)
+		return src;
+	uint filter = active;
+	if((filter == HQ2X || filter == HQ3X) && src.format.id != PIXEL_RGB565)
+		filter = filter == HQ2X ? SCALE2X : SCALE3X;
+	uint scale = (filter == SCALE2X || filter == HQ2X) ? 2 : 3;
+	const PixelFormatDesc &format = (filter == HQ2X || filter == HQ3X) ? PixelFormatBGRA8888 : src.format;
+	uint bytes = src.x * scale * src.y * scale * format.bytesPerPixel;
+	if(bytes > outBuffSize)
+	{
+		mem_freeSafe(outBuff);
+		outBuff = (uchar*)mem_alloc(bytes);
+		if(!outBuff)
+		{
+			logErr("out of memory for %dx%d filtered frame", src.x * scale, src.y * scale);
+			outBuffSize = 0;
+			return src;
+		}
+		outBuffSize = bytes;
+	}
+	if(out.format.id != format.id || out.x != src.x * scale || out.y != src.y * scale)
+	{
+		logMsg("filtering %dx%d %s frame to %dx%d %s", src.x, src.y, src.format.name,
+			src.x * scale, src.y * scale, format.name);
+	}
+	new(&out) Pixmap(format);
+	out.init(outBuff, src.x * scale, src.y * scale);
+	switch(filter)
+	{
+		bcase SCALE2X: bandFunc = bpp == 2 ? scale2xRows<uint16> : scale2xRows<uint32>;
+		bcase SCALE3X: bandFunc = bpp == 2 ? scale3xRows<uint16> : scale3xRows<uint32>;
+		bcase HQ2X: bandFunc = hq2xRows;
+		bcase HQ3X: bandFunc = hq3xRows;
+	}
+	return out;
+}
+
+Pixmap &apply(Pixmap &src)
+{
+	TRACE_SCOPE("VideoFilter::apply");
+	auto &dest = prepare(src);
+	if(&dest == &src)
+		return src;
+	uint jobBands = IG::min(workers + 1, IG::max(src.y / minBandRows, 1U));
+	if(jobBands == 1)
+	{
+		bandFunc(src, out, 0, src.y);
+		return out;
+	}
+	jobMutex.lock();
+	jobSrc = &src;
+	bands = jobBands;
+	nextBand = 0;
+	bandsLeft = jobBands;
+	jobId++;
+	jobCond.broadcast();
+	runBands();
+	while(bandsLeft)
+		jobDoneCond.wait();
+	jobMutex.unlock();
+	return out;
+}
+
+}
@@ -21,9 +21,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "hqxPattern.h"
 
 //#define USE_INLINE_ASSEMBLY
 
+// output is BGRA, interpolation masks off the alpha byte so it's set again on write
+#define ALPHA_OPAQUE 0xFF000000
+
 static int   LUT16to32[65536];
 
 #ifndef USE_INLINE_ASSEMBLY
@@ -46,7 +50,7 @@ static void Interp1(unsigned char * pc, int c1, int c2)
 #ifndef USE_INLINE_ASSEMBLY
     c1 &= 0xfcfcfc;
     c2 &= 0xfcfcfc;
-    *((int*)pc) = (c1*3+c2)>>2;
+    *((int*)pc) = ((c1*3+c2)>>2) | ALPHA_OPAQUE;
 #else
     __asm
     {
@@ -67,7 +71,7 @@ static void Interp2(unsigned char * pc, int c1, int c2, int c3)
     c1 &= 0xfcfcfc;
     c2 &= 0xfcfcfc;
     c3 &= 0xfcfcfc;
-    *((int*)pc) = (c1*2+c2+c3)>>2;
+    *((int*)pc) = ((c1*2+c2+c3)>>2) | ALPHA_OPAQUE;
 #else
     __asm
     {
@@ -87,7 +91,7 @@ static void Interp5(unsigned char * pc, int c1, int c2)
 #ifndef USE_INLINE_ASSEMBLY
     c1 &= 0xfefefe;
     c2 &= 0xfefefe;
-    *((int*)pc) = (c1+c2)>>1;
+    *((int*)pc) = ((c1+c2)>>1) | ALPHA_OPAQUE;
 #else
     __asm
     {
@@ -106,7 +110,7 @@ static void Interp6(unsigned char * pc, int c1, int c2, int c3)
     c1 &= 0xf8f8f8;
     c2 &= 0xf8f8f8;
     c3 &= 0xf8f8f8;
-    *((int*)pc) = (c1*5+c2*2+c3)>>3;
+    *((int*)pc) = ((c1*5+c2*2+c3)>>3) | ALPHA_OPAQUE;
 #else
     __asm
     {
@@ -134,7 +138,7 @@ static void Interp7(unsigned char * pc, int c1, int c2, int c3)
     c1 &= 0xf8f8f8;
     c2 &= 0xf8f8f8;
     c3 &= 0xf8f8f8;
-    *((int*)pc) = (c1*6+c2+c3)>>3;
+    *((int*)pc) = ((c1*6+c2+c3)>>3) | ALPHA_OPAQUE;
 #else
     __asm
     {
@@ -161,7 +165,7 @@ static void Interp9(unsigned char * pc, int c1, int c2, int c3)
     c1 &= 0xf8f8f8;
     c2 &= 0xf8f8f8;
     c3 &= 0xf8f8f8;
-    *((int*)pc) = (c1*2+(c2+c3)*3)>>3;
+    *((int*)pc) = ((c1*2+(c2+c3)*3)>>3) | ALPHA_OPAQUE;
 #else
     __asm
     {
@@ -189,7 +193,7 @@ static void Interp10(unsigned char * pc, int c1, int c2, int c3)
     c1 &= 0xf0f0f0;
     c2 &= 0xf0f0f0;
     c3 &= 0xf0f0f0;
-    *((int*)pc) = (c1*14+c2+c3)>>4;
+    *((int*)pc) = ((c1*14+c2+c3)>>4) | ALPHA_OPAQUE;
 #else
     __asm
     {
@@ -292,12 +296,15 @@ FIN:
 #pragma warning(default: 4035)
 
 
-void hq2x_32(void* pSrc, void* pDest, int Xres, int Yres, int BpL)
+// scales rows [rowStart, rowEnd) of an RGB565 image, bands can run in parallel
+void hq2x_32_rows(const void* pSrc, int srcBpL, void* pDest, int BpL, int Xres, int Yres, int rowStart, int rowEnd)
 {
-    unsigned char* pIn  = (unsigned char*)pSrc;
-    unsigned char* pOut = (unsigned char*)pDest;
+    unsigned char* pIn;
+    unsigned char* pOut;
     int  i, j, k;
     int  prevline, nextline;
+    unsigned char patternRow[HQX_PATTERN_MAX_WIDTH];
+    int usePatternRow = Xres <= HQX_PATTERN_MAX_WIDTH;
     int  w[10];
     int  c[10];
     int pattern;
@@ -313,12 +320,19 @@ void hq2x_32(void* pSrc, void* pDest, int Xres, int Yres, int BpL)
     //   | w7 | w8 | w9 |
     //   +----+----+----+
 
-    for (j=0; j<Yres; j++)
+    for (j=rowStart; j<rowEnd; j++)
     {
-        char* pOutOrig = pOut;
+        pIn  = (unsigned char*)pSrc + j*srcBpL;
+        pOut = (unsigned char*)pDest + j*2*BpL;
+
+        if (j>0)      prevline = -srcBpL; else prevline = 0;
+        if (j<Yres-1) nextline =  srcBpL; else nextline = 0;
 
-        if (j>0)      prevline = -Xres*2; else prevline = 0;
-        if (j<Yres-1) nextline =  Xres*2; else nextline = 0;
+        if (usePatternRow)
+        {
+            hqx_patternRow(Luminance, treshold, (const unsigned short*)(pIn + prevline),
+                (const unsigned short*)pIn, (const unsigned short*)(pIn + nextline), Xres, patternRow);
+        }
 
         for (i=0; i<Xres; i++)
         {
@@ -352,16 +366,21 @@ void hq2x_32(void* pSrc, void* pDest, int Xres, int Yres, int BpL)
                 w[9] = w[8];
             }
 
-            pattern = 0;
+            if (usePatternRow)
+                pattern = patternRow[i];
+            else
+            {
+                pattern = 0;
 
-            if ( Diff(w[5],w[1]) ) pattern |= 0x0001;
-            if ( Diff(w[5],w[2]) ) pattern |= 0x0002;
-            if ( Diff(w[5],w[3]) ) pattern |= 0x0004;
-            if ( Diff(w[5],w[4]) ) pattern |= 0x0008;
-            if ( Diff(w[5],w[6]) ) pattern |= 0x0010;
-            if ( Diff(w[5],w[7]) ) pattern |= 0x0020;
-            if ( Diff(w[5],w[8]) ) pattern |= 0x0040;
-            if ( Diff(w[5],w[9]) ) pattern |= 0x0080;
+                if ( Diff(w[5],w[1]) ) pattern |= 0x0001;
+                if ( Diff(w[5],w[2]) ) pattern |= 0x0002;
+                if ( Diff(w[5],w[3]) ) pattern |= 0x0004;
+                if ( Diff(w[5],w[4]) ) pattern |= 0x0008;
+                if ( Diff(w[5],w[6]) ) pattern |= 0x0010;
+                if ( Diff(w[5],w[7]) ) pattern |= 0x0020;
+                if ( Diff(w[5],w[8]) ) pattern |= 0x0040;
+                if ( Diff(w[5],w[9]) ) pattern |= 0x0080;
+            }
 
             for (k=1; k<=9; k++)
                 c[k] = LUT16to32[w[k]];
@@ -3011,16 +3030,20 @@ void hq2x_32(void* pSrc, void* pDest, int Xres, int Yres, int BpL)
             pIn+=2;
             pOut+=8;
         }
-        pOut=pOutOrig+2*BpL;
     }
 }
 
+void hq2x_32(void* pSrc, void* pDest, int Xres, int Yres, int BpL)
+{
+    hq2x_32_rows(pSrc, Xres*2, pDest, BpL, Xres, Yres, 0, Yres);
+}
+
 void hq2x_init(void)
 {
     int i, j, k;
 
     for (i=0; i<65536; i++)
-        LUT16to32[i] = ((i & 0xF800) << 8) + ((i & 0x07E0) << 5) + ((i & 0x001F) << 3);
+        LUT16to32[i] = ALPHA_OPAQUE | (((i & 0xF800) << 8) + ((i & 0x07E0) << 5) + ((i & 0x001F) << 3));
 
     for (i=0; i<32; i++)
         for (j=0; j<64; j++)
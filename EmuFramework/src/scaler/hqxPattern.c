@@ -0,0 +1,100 @@
+//Neighbour pattern detection shared by hq2x/hq3x, the compares of a row are done
+//8 pixels at a time with SSE2 or NEON, then each pixel's pattern selects its case
+
+#include "hqxPattern.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HQX_NEON
+#endif
+
+void hqx_patternRow(const int* luminance, int treshold,
+    const unsigned short* prev, const unsigned short* cur, const unsigned short* next,
+    int Xres, unsigned char* pattern)
+{
+    // luminance of the 3 rows, with the edge pixels repeated like the scalar code
+    short lum[3][HQX_PATTERN_MAX_WIDTH + 2];
+    const unsigned short* row[3] = { prev, cur, next };
+    int i, r;
+
+    for (r=0; r<3; r++)
+    {
+        for (i=0; i<Xres; i++)
+            lum[r][i+1] = (short)luminance[row[r][i]];
+        lum[r][0] = lum[r][1];
+        lum[r][Xres+1] = lum[r][Xres];
+    }
+
+    i = 0;
+#if defined(__SSE2__)
+    {
+        const __m128i t = _mm_set1_epi16((short)treshold);
+        const __m128i zero = _mm_setzero_si128();
+        #define HQX_DIFF(w, bit) \
+            _mm_and_si128(_mm_cmpgt_epi16(_mm_max_epi16(_mm_sub_epi16(c, w), _mm_sub_epi16(w, c)), t), \
+                _mm_set1_epi16(bit))
+        for (; i+8 <= Xres; i+=8)
+        {
+            __m128i c = _mm_loadu_si128((const __m128i*)&lum[1][i+1]);
+            __m128i w1 = _mm_loadu_si128((const __m128i*)&lum[0][i]);
+            __m128i w2 = _mm_loadu_si128((const __m128i*)&lum[0][i+1]);
+            __m128i w3 = _mm_loadu_si128((const __m128i*)&lum[0][i+2]);
+            __m128i w4 = _mm_loadu_si128((const __m128i*)&lum[1][i]);
+            __m128i w6 = _mm_loadu_si128((const __m128i*)&lum[1][i+2]);
+            __m128i w7 = _mm_loadu_si128((const __m128i*)&lum[2][i]);
+            __m128i w8 = _mm_loadu_si128((const __m128i*)&lum[2][i+1]);
+            __m128i w9 = _mm_loadu_si128((const __m128i*)&lum[2][i+2]);
+            __m128i p = _mm_or_si128(
+                _mm_or_si128(_mm_or_si128(HQX_DIFF(w1, 0x01), HQX_DIFF(w2, 0x02)),
+                    _mm_or_si128(HQX_DIFF(w3, 0x04), HQX_DIFF(w4, 0x08))),
+                _mm_or_si128(_mm_or_si128(HQX_DIFF(w6, 0x10), HQX_DIFF(w7, 0x20)),
+                    _mm_or_si128(HQX_DIFF(w8, 0x40), HQX_DIFF(w9, 0x80))));
+            _mm_storel_epi64((__m128i*)&pattern[i], _mm_packus_epi16(p, zero));
+        }
+        #undef HQX_DIFF
+    }
+#elif defined(HQX_NEON)
+    {
+        const int16x8_t t = vdupq_n_s16((short)treshold);
+        #define HQX_DIFF(w, bit) vandq_u16(vcgtq_s16(vabdq_s16(c, w), t), vdupq_n_u16(bit))
+        for (; i+8 <= Xres; i+=8)
+        {
+            int16x8_t c = vld1q_s16(&lum[1][i+1]);
+            int16x8_t w1 = vld1q_s16(&lum[0][i]);
+            int16x8_t w2 = vld1q_s16(&lum[0][i+1]);
+            int16x8_t w3 = vld1q_s16(&lum[0][i+2]);
+            int16x8_t w4 = vld1q_s16(&lum[1][i]);
+            int16x8_t w6 = vld1q_s16(&lum[1][i+2]);
+            int16x8_t w7 = vld1q_s16(&lum[2][i]);
+            int16x8_t w8 = vld1q_s16(&lum[2][i+1]);
+            int16x8_t w9 = vld1q_s16(&lum[2][i+2]);
+            uint16x8_t p = vorrq_u16(
+                vorrq_u16(vorrq_u16(HQX_DIFF(w1, 0x01), HQX_DIFF(w2, 0x02)),
+                    vorrq_u16(HQX_DIFF(w3, 0x04), HQX_DIFF(w4, 0x08))),
+                vorrq_u16(vorrq_u16(HQX_DIFF(w6, 0x10), HQX_DIFF(w7, 0x20)),
+                    vorrq_u16(HQX_DIFF(w8, 0x40), HQX_DIFF(w9, 0x80))));
+            vst1_u8(&pattern[i], vmovn_u16(p));
+        }
+        #undef HQX_DIFF
+    }
+#endif
+
+    for (; i<Xres; i++)
+    {
+        int c = lum[1][i+1];
+        int p = 0;
+        #define HQX_DIFF(w, bit) if ((unsigned int)(c - (w) + treshold) > 2 * (unsigned int)treshold) p |= bit;
+        HQX_DIFF(lum[0][i], 0x01)
+        HQX_DIFF(lum[0][i+1], 0x02)
+        HQX_DIFF(lum[0][i+2], 0x04)
+        HQX_DIFF(lum[1][i], 0x08)
+        HQX_DIFF(lum[1][i+2], 0x10)
+        HQX_DIFF(lum[2][i], 0x20)
+        HQX_DIFF(lum[2][i+1], 0x40)
+        HQX_DIFF(lum[2][i+2], 0x80)
+        #undef HQX_DIFF
+        pattern[i] = (unsigned char)p;
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef HQX_PATTERN_H
+#define HQX_PATTERN_H
+
+// widest row hqx_patternRow() handles, wider images use the per-pixel Diff() path
+#define HQX_PATTERN_MAX_WIDTH 1024
+
+// Computes the neighbour pattern of each pixel in an RGB565 row like the per-pixel
+// Diff() tests do: bit 0-7 set when w1-w4,w6-w9 differs from w5 by more than
+// treshold in luminance. prev/next are the rows above/below, or cur at the edges.
+void hqx_patternRow(const int* luminance, int treshold,
+    const unsigned short* prev, const unsigned short* cur, const unsigned short* next,
+    int Xres, unsigned char* pattern);
+
+#endif
@@ -32,6 +32,33 @@ class SystemOptionView : public OptionView
 		}
 	}
 
+	BoolMenuItem skipIdleLoops {"Skip Idle Loops", BoolMenuItem::SelectDelegate::create<&skipIdleLoopsHandler>()};
+
+	static void skipIdleLoopsHandler(BoolMenuItem &item, const Input::Event &e)
+	{
+		item.toggle();
+		optionSkipIdleLoops = item.on;
+	}
+
+	BoolMenuItem threadedRender {"Threaded Rendering", BoolMenuItem::SelectDelegate::create<&threadedRenderHandler>()};
+
+	static void threadedRenderHandler(BoolMenuItem &item, const Input::Event &e)
+	{
+		item.toggle();
+		optionThreadedRender = item.on;
+	}
+
+	#ifdef VBAM_USE_JIT
+	BoolMenuItem cpuJit {"Dynamic Recompiler", BoolMenuItem::SelectDelegate::create<&cpuJitHandler>()};
+
+	static void cpuJitHandler(BoolMenuItem &item, const Input::Event &e)
+	{
+		item.toggle();
+		optionCpuJit = item.on;
+		jitFlush();
+	}
+	#endif
+
 public:
 	constexpr SystemOptionView() { }
 
@@ -39,6 +66,11 @@ public:
 	{
 		OptionView::loadSystemItems(item, items);
 		rtcInit(); item[items++] = &rtc;
+		skipIdleLoops.init(optionSkipIdleLoops); item[items++] = &skipIdleLoops;
+		threadedRender.init(optionThreadedRender); item[items++] = &threadedRender;
+		#ifdef VBAM_USE_JIT
+		cpuJit.init(optionCpuJit); item[items++] = &cpuJit;
+		#endif
 	}
 };
 
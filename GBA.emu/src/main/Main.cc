@@ -30,6 +30,7 @@
 #include <vbam/gba/GBA.h>
 #include <vbam/gba/Sound.h>
 #include <vbam/gba/RTC.h>
+#include <vbam/gba/GBAJit.h>
 #include <vbam/common/SoundDriver.h>
 #include <vbam/Util.h>
 void setGameSpecificSettings(GBASys &gba);
@@ -162,11 +163,17 @@ void EmuSystem::handleInputAction(uint state, uint emuKey)
 
 enum
 {
-	CFGKEY_RTC_EMULATION = 256
+	CFGKEY_RTC_EMULATION = 256, CFGKEY_CPU_JIT = 257,
+	CFGKEY_SKIP_IDLE_LOOPS = 259, CFGKEY_THREADED_RENDER = 260
 };
 
 Byte1Option optionRtcEmulation(CFGKEY_RTC_EMULATION, RTC_EMU_AUTO, 0, optionIsValidWithMax<2>);
 bool detectedRtcGame = 0;
+Option<OptionMethodRef<bool, cpuSkipIdleLoops>, uint8> optionSkipIdleLoops(CFGKEY_SKIP_IDLE_LOOPS, 1);
+Option<OptionMethodRef<bool, gfxThreadedRender>, uint8> optionThreadedRender(CFGKEY_THREADED_RENDER, 1);
+#ifdef VBAM_USE_JIT
+Option<OptionMethodRef<bool, cpuJitEnabled>, uint8> optionCpuJit(CFGKEY_CPU_JIT, 1);
+#endif
 
 bool EmuSystem::readConfig(Io *io, uint key, uint readSize)
 {
@@ -174,6 +181,11 @@ bool EmuSystem::readConfig(Io *io, uint key, uint readSize)
 	{
 		default: return 0;
 		bcase CFGKEY_RTC_EMULATION: optionRtcEmulation.readFromIO(io, readSize);
+		bcase CFGKEY_SKIP_IDLE_LOOPS: optionSkipIdleLoops.readFromIO(io, readSize);
+		bcase CFGKEY_THREADED_RENDER: optionThreadedRender.readFromIO(io, readSize);
+		#ifdef VBAM_USE_JIT
+		bcase CFGKEY_CPU_JIT: optionCpuJit.readFromIO(io, readSize);
+		#endif
 	}
 	return 1;
 }
@@ -181,6 +193,11 @@ bool EmuSystem::readConfig(Io *io, uint key, uint readSize)
 void EmuSystem::writeConfig(Io *io)
 {
 	optionRtcEmulation.writeWithKeyIfNotDefault(io);
+	optionSkipIdleLoops.writeWithKeyIfNotDefault(io);
+	optionThreadedRender.writeWithKeyIfNotDefault(io);
+	#ifdef VBAM_USE_JIT
+	optionCpuJit.writeWithKeyIfNotDefault(io);
+	#endif
 }
 
 static bool isGBAExtension(const char *name)
@@ -256,20 +273,29 @@ int EmuSystem::saveState()
 	#ifdef CONFIG_BASE_IOS_SETUID
 		fixFilePermissions(saveStr);
 	#endif
-	if(CPUWriteState(gGba, saveStr))
-		return STATE_RESULT_OK;
-	else
-		return STATE_RESULT_IO_ERROR;
+	return saveMemStateFile(saveStr);
 }
 
 int EmuSystem::loadState(int saveStateSlot)
 {
 	FsSys::cPath saveStr;
 	sprintStateFilename(saveStr, saveStateSlot);
-	if(CPUReadState(gGba, saveStr))
-		return STATE_RESULT_OK;
-	else
-		return STATE_RESULT_IO_ERROR;
+	return loadMemStateFile(saveStr);
+}
+
+uint EmuSystem::memStateSize()
+{
+	return CPUWriteRawMemState(gGba, nullptr, 0x7FFFFFFF);
+}
+
+uint EmuSystem::saveMemState(uchar *buff, uint size)
+{
+	return CPUWriteRawMemState(gGba, (char*)buff, size);
+}
+
+bool EmuSystem::loadMemState(const uchar *buff, uint size)
+{
+	return CPUReadRawMemState(gGba, (const char*)buff, size);
 }
 
 void EmuSystem::saveAutoState()
@@ -281,7 +307,7 @@ void EmuSystem::saveAutoState()
 		#ifdef CONFIG_BASE_IOS_SETUID
 			fixFilePermissions(saveStr);
 		#endif
-		CPUWriteState(gGba, saveStr);
+		saveMemStateFileAsync(saveStr);
 	}
 }
 
@@ -348,7 +374,7 @@ void systemDrawScreen()
 #ifdef USE_NEW_AUDIO
 u16 *systemObtainSoundBuffer(uint samples, uint &buffSamples, void *&ctx)
 {
-	auto aBuff = Audio::getPlayBuffer(samples/2);
+	auto aBuff = EmuAudio::getPlayBuffer(samples/2);
 	if(unlikely(!aBuff))
 	{
 		return nullptr;
@@ -361,18 +387,19 @@ u16 *systemObtainSoundBuffer(uint samples, uint &buffSamples, void *&ctx)
 void systemCommitSoundBuffer(uint writtenSamples, void *&ctx)
 {
 	//logMsg("%d audio frames", writtenSamples/2);
-	Audio::commitPlayBuffer((Audio::BufferContext*)ctx, writtenSamples/2);
+	EmuAudio::commitPlayBuffer((Audio::BufferContext*)ctx, writtenSamples/2);
 }
 #else
 void systemOnWriteDataToSoundBuffer(const u16 * finalWave, int length)
 {
 	//logMsg("%d audio frames", Audio::pPCM.bytesToFrames(length));
-	Audio::writePcm((uchar*)finalWave, EmuSystem::pcmFormat.bytesToFrames(length));
+	EmuAudio::writePcm((uchar*)finalWave, EmuSystem::pcmFormat.bytesToFrames(length));
 }
 #endif
 
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	CPULoop(gGba, renderGfx, processGfx, renderAudio);
 }
 
@@ -1,8 +1,14 @@
 #pragma once
 
 #include <Option.hh>
+#include <vbam/gba/GBAJit.h>
 
 static const uint RTC_EMU_AUTO = 0, RTC_EMU_OFF = 1, RTC_EMU_ON = 2;
 
 extern Byte1Option optionRtcEmulation;
 extern bool detectedRtcGame;
+extern Option<OptionMethodRef<bool, cpuSkipIdleLoops>, uint8> optionSkipIdleLoops;
+extern Option<OptionMethodRef<bool, gfxThreadedRender>, uint8> optionThreadedRender;
+#ifdef VBAM_USE_JIT
+extern Option<OptionMethodRef<bool, cpuJitEnabled>, uint8> optionCpuJit;
+#endif
@@ -58,6 +58,7 @@ struct GameSettings
 	int rtcEnabled;
 	int flashSize;
 	int mirroringEnabled;
+	u32 idleLoop; // see cpuIdleLoop, 0 to detect idle loops
 };
 
 static void resetGameSettings()
@@ -66,6 +67,7 @@ static void resetGameSettings()
 	rtcEnable(0);
 	cpuSaveType = 0;
 	flashSetSize(0x10000);
+	cpuIdleLoop = 0;
 }
 
 void setGameSpecificSettings(GBASys &gba)
@@ -957,6 +959,11 @@ void setGameSpecificSettings(GBASys &gba)
 				logMsg("using mirroring");
 				mirroringEnable = e->mirroringEnabled;
 			}
+			if(e->idleLoop)
+			{
+				logMsg("using idle loop 0x%X", e->idleLoop);
+				cpuIdleLoop = e->idleLoop;
+			}
 			break;
 		}
 	}
@@ -362,10 +362,7 @@ static int utilGetSize(int size)
   return res;
 }
 
-u8 *utilLoad(const char *file,
-             bool (*accept)(const char *),
-             u8 *data,
-             int &size)
+fex_t *utilOpenImage(const char *file, bool (*accept)(const char *))
 {
 	// find image file
 	char buffer [2048];
@@ -386,10 +383,25 @@ u8 *utilLoad(const char *file,
 	free(file_conv);
 #else
 	fex_t *fe = scan_arc(file,accept,buffer);
-	if(!fe)
-		return NULL;
 #endif
+	return fe;
+}
+
+bool utilImageCRC(fex_t *fe, u32 &crc)
+{
+	if(fex_stat(fe))
+		return false;
+	crc = fex_crc32(fe);
+	return true;
+}
+
+void utilCloseImage(fex_t *fe)
+{
+	fex_close(fe);
+}
 
+u8 *utilLoadImage(fex_t *fe, u8 *data, int &size)
+{
 	// Allocate space for image
 	fex_err_t err = fex_stat(fe);
 	int fileSize = fex_size(fe);
@@ -413,20 +425,32 @@ u8 *utilLoad(const char *file,
 	// Read image
 	int read = fileSize <= size ? fileSize : size; // do not read beyond file
 	err = fex_read(fe, image, read);
-	fex_close(fe);
 	if(err) {
 		systemMessage(MSG_ERROR_READING_IMAGE,
-									N_("Error reading image from %s: %s"), buffer, err);
+									N_("Error reading image from %s: %s"), fex_name(fe), err);
+		fex_close(fe);
 		if(data == NULL)
 			free(image);
 		return NULL;
 	}
+	fex_close(fe);
 
 	size = fileSize;
 
 	return image;
 }
 
+u8 *utilLoad(const char *file,
+             bool (*accept)(const char *),
+             u8 *data,
+             int &size)
+{
+	fex_t *fe = utilOpenImage(file, accept);
+	if(!fe)
+		return NULL;
+	return utilLoadImage(fe, data, size);
+}
+
 void utilWriteInt(gzFile gzFile, int i)
 {
   utilGzWrite(gzFile, &i, sizeof(int));
@@ -483,6 +507,80 @@ gzFile utilMemGzOpen(char *memory, int available, const char *mode)
   return memgzopen(memory, available, mode);
 }
 
+// uncompressed in-memory stream, used for rewind snapshots where gzip would
+// cost more than the state copy itself, a null memory pointer only counts bytes
+struct MemRawFile
+{
+  char *memory;
+  int available;
+  int pos;
+  bool error;
+};
+
+static MemRawFile memRawFile;
+
+static int ZEXPORT memrawwrite(gzFile file, voidpc buf, unsigned len)
+{
+  MemRawFile *f = (MemRawFile*)file;
+  if(f->memory) {
+    if(f->pos + (int)len > f->available) {
+      f->error = true;
+      return 0;
+    }
+    memcpy(f->memory + f->pos, buf, len);
+  }
+  f->pos += len;
+  return len;
+}
+
+static int ZEXPORT memrawread(gzFile file, voidp buf, unsigned len)
+{
+  MemRawFile *f = (MemRawFile*)file;
+  if(f->pos + (int)len > f->available) {
+    f->error = true;
+    len = f->available - f->pos;
+  }
+  memcpy(buf, f->memory + f->pos, len);
+  f->pos += len;
+  return len;
+}
+
+static int ZEXPORT memrawclose(gzFile file)
+{
+  return ((MemRawFile*)file)->error ? -1 : 0;
+}
+
+static z_off_t ZEXPORT memrawseek(gzFile file, z_off_t offset, int whence)
+{
+  MemRawFile *f = (MemRawFile*)file;
+  int pos = whence == SEEK_CUR ? f->pos + offset : offset;
+  if(pos < 0 || pos > f->available) {
+    f->error = true;
+    return -1;
+  }
+  f->pos = pos;
+  return pos;
+}
+
+gzFile utilMemRawOpen(char *memory, int available)
+{
+  utilGzWriteFunc = memrawwrite;
+  utilGzReadFunc = memrawread;
+  utilGzCloseFunc = memrawclose;
+  utilGzSeekFunc = memrawseek;
+
+  memRawFile.memory = memory;
+  memRawFile.available = available;
+  memRawFile.pos = 0;
+  memRawFile.error = false;
+  return (gzFile)&memRawFile;
+}
+
+long utilMemRawTell(gzFile file)
+{
+  return ((MemRawFile*)file)->pos;
+}
+
 int utilGzWrite(gzFile file, const voidp buffer, unsigned int len)
 {
   return utilGzWriteFunc(file, buffer, len);
@@ -25,6 +25,14 @@ void utilStripDoubleExtension(const char *, char *);
 IMAGE_TYPE utilFindType(const char *);
 IMAGE_TYPE utilFindType(const char *, char (&)[2048]);
 u8 *utilLoad(const char *, bool (*)(const char*), u8 *, int &);
+// utilLoad() in steps, so the image's CRC can be read from the archive directory
+// before deciding to decompress it: utilOpenImage() finds the image, then
+// utilLoadImage() reads it or utilCloseImage() skips it, both close the handle
+typedef struct fex_t fex_t;
+fex_t *utilOpenImage(const char *, bool (*)(const char*));
+bool utilImageCRC(fex_t *, u32 &);
+u8 *utilLoadImage(fex_t *, u8 *, int &);
+void utilCloseImage(fex_t *);
 
 void utilPutDword(u8 *, u32);
 void utilPutWord(u8 *, u16);
@@ -35,6 +43,8 @@ int utilReadInt(gzFile);
 void utilWriteInt(gzFile, int);
 gzFile utilGzOpen(const char *file, const char *mode);
 gzFile utilMemGzOpen(char *memory, int available, const char *mode);
+gzFile utilMemRawOpen(char *memory, int available);
+long utilMemRawTell(gzFile file);
 int utilGzWrite(gzFile file, const voidp buffer, unsigned int len);
 int utilGzRead(gzFile file, voidp buffer, unsigned int len);
 int utilGzClose(gzFile file);
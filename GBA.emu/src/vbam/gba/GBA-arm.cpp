@@ -2031,6 +2031,7 @@ static INSN_REGPARM void arm9F0(ARM7TDMI &cpu, u32 opcode, int &clockTicks)
 // B <offset>
 static INSN_REGPARM void armA00(ARM7TDMI &cpu, u32 opcode, int &clockTicks)
 {
+    u32 branchPC = reg[15].I - 8;
     int offset = opcode & 0x00FFFFFF;
     if (offset & 0x00800000)
         offset |= 0xFF000000;  // negative offset
@@ -2042,6 +2043,7 @@ static INSN_REGPARM void armA00(ARM7TDMI &cpu, u32 opcode, int &clockTicks)
     clockTicks += 2 + codeTicksAccess32(cpu, armNextPC)
                     + codeTicksAccessSeq32(cpu, armNextPC);
     busPrefetchCount = 0;
+    checkIdleLoop(cpu, branchPC, armNextPC, 0);
 }
 
 // BL <offset>
@@ -2293,100 +2295,102 @@ static void tester(void) {
 }
 #endif
 
-int armExecute(ARM7TDMI &cpu)
+static inline ATTRS(always_inline) bool armCondition(ARM7TDMI &cpu, int cond)
 {
-	//ARM7TDMI cpu = cpuO;
-	int &cpuNextEvent = cpu.cpuNextEvent;
-	int &cpuTotalTicks = cpu.cpuTotalTicks;
-    do {
-		if( cheatsEnabled ) {
-			cpuMasterCodeCheck(cpu);
-		}
+    switch(cond) {
+      case 0x00: // EQ
+        return Z_FLAG;
+      case 0x01: // NE
+        return !Z_FLAG;
+      case 0x02: // CS
+        return C_FLAG;
+      case 0x03: // CC
+        return !C_FLAG;
+      case 0x04: // MI
+        return N_FLAG;
+      case 0x05: // PL
+        return !N_FLAG;
+      case 0x06: // VS
+        return V_FLAG;
+      case 0x07: // VC
+        return !V_FLAG;
+      case 0x08: // HI
+        return C_FLAG && !Z_FLAG;
+      case 0x09: // LS
+        return !C_FLAG || Z_FLAG;
+      case 0x0A: // GE
+        return N_FLAG == V_FLAG;
+      case 0x0B: // LT
+        return N_FLAG != V_FLAG;
+      case 0x0C: // GT
+        return !Z_FLAG &&(N_FLAG == V_FLAG);
+      case 0x0D: // LE
+        return Z_FLAG || (N_FLAG != V_FLAG);
+      case 0x0E: // AL
+        return true;
+      /*case 0x0F:
+      default:
+        // ???
+        return false;*/
+    }
+    return true;
+}
 
-        if ((armNextPC & 0x0803FFFF) == 0x08020000)
-          busPrefetchCount = 0x100;
+static inline ATTRS(always_inline) int armExecuteInsn(ARM7TDMI &cpu)
+{
+    if( cheatsEnabled ) {
+        cpuMasterCodeCheck(cpu);
+    }
 
-        u32 opcode = cpu.prefetchArmOpcode();
+    if ((armNextPC & 0x0803FFFF) == 0x08020000)
+      busPrefetchCount = 0x100;
 
-        busPrefetch = false;
-        if (busPrefetchCount & 0xFFFFFE00)
-            busPrefetchCount = 0x100 | (busPrefetchCount & 0xFF);
+    u32 opcode = cpu.prefetchArmOpcode();
 
-        int clockTicks = 0;
-        int oldArmNextPC = armNextPC;
+    busPrefetch = false;
+    if (busPrefetchCount & 0xFFFFFE00)
+        busPrefetchCount = 0x100 | (busPrefetchCount & 0xFF);
+
+    int clockTicks = 0;
+    int oldArmNextPC = armNextPC;
 
 #ifndef FINAL_VERSION
-        if (armNextPC == stop) {
-            armNextPC++;
-        }
+    if (armNextPC == stop) {
+        armNextPC++;
+    }
 #endif
 
-        armNextPC = reg[15].I;
-        reg[15].I += 4;
-        ARM_PREFETCH_NEXT;
-
-        int cond = opcode >> 28;
-        u32 cond_res = true;
-        if (UNLIKELY(cond != 0x0E)) {  // most opcodes are AL (always)
-            switch(cond) {
-              case 0x00: // EQ
-                cond_res = Z_FLAG;
-                break;
-              case 0x01: // NE
-                cond_res = !Z_FLAG;
-                break;
-              case 0x02: // CS
-                cond_res = C_FLAG;
-                break;
-              case 0x03: // CC
-                cond_res = !C_FLAG;
-                break;
-              case 0x04: // MI
-                cond_res = N_FLAG;
-                break;
-              case 0x05: // PL
-                cond_res = !N_FLAG;
-                break;
-              case 0x06: // VS
-                cond_res = V_FLAG;
-                break;
-              case 0x07: // VC
-                cond_res = !V_FLAG;
-                break;
-              case 0x08: // HI
-                cond_res = C_FLAG && !Z_FLAG;
-                break;
-              case 0x09: // LS
-                cond_res = !C_FLAG || Z_FLAG;
-                break;
-              case 0x0A: // GE
-                cond_res = N_FLAG == V_FLAG;
-                break;
-              case 0x0B: // LT
-                cond_res = N_FLAG != V_FLAG;
-                break;
-              case 0x0C: // GT
-                cond_res = !Z_FLAG &&(N_FLAG == V_FLAG);
-                break;
-              case 0x0D: // LE
-                cond_res = Z_FLAG || (N_FLAG != V_FLAG);
-                break;
-              /*case 0x0E: // AL (impossible, checked above)
-                cond_res = true;
-                break;
-              case 0x0F:
-              default:
-                // ???
-                cond_res = false;
-                break;*/
-            }
-        }
+    armNextPC = reg[15].I;
+    reg[15].I += 4;
+    ARM_PREFETCH_NEXT;
 
-        if (cond_res)
-            (*armInsnTable[((opcode>>16)&0xFF0) | ((opcode>>4)&0x0F)])(cpu, opcode, clockTicks);
+    int cond = opcode >> 28;
+    u32 cond_res = true;
+    if (UNLIKELY(cond != 0x0E)) {  // most opcodes are AL (always)
+        cond_res = armCondition(cpu, cond);
+    }
+
+    if (cond_res)
+        (*armInsnTable[((opcode>>16)&0xFF0) | ((opcode>>4)&0x0F)])(cpu, opcode, clockTicks);
 #ifdef INSN_COUNTER
-        count(opcode, cond_res);
-#endif
+    count(opcode, cond_res);
+#endif
+		#ifdef BKPT_SUPPORT
+    if (clockTicks < 0)
+        return clockTicks;
+		#endif
+    if (clockTicks == 0)
+        clockTicks = 1 + codeTicksAccessSeq32(cpu, oldArmNextPC);
+    return clockTicks;
+}
+
+int armExecute(ARM7TDMI &cpu)
+{
+	//ARM7TDMI cpu = cpuO;
+	int &cpuNextEvent = cpu.cpuNextEvent;
+	int &cpuTotalTicks = cpu.cpuTotalTicks;
+    do {
+        int clockTicks = armExecuteInsn(cpu);
 				#ifdef BKPT_SUPPORT
         if (clockTicks < 0)
         {
@@ -2394,8 +2398,6 @@ int armExecute(ARM7TDMI &cpu)
             return 0;
         }
 				#endif
-        if (clockTicks == 0)
-            clockTicks = 1 + codeTicksAccessSeq32(cpu, oldArmNextPC);
         cpuTotalTicks += clockTicks;
 
     } while (cpuTotalTicks<cpuNextEvent &&
@@ -2408,3 +2410,13 @@ int armExecute(ARM7TDMI &cpu)
     //cpuO = cpu;
     return 1;
 }
+
+void armStep(ARM7TDMI &cpu)
+{
+    cpu.cpuTotalTicks += armExecuteInsn(cpu);
+}
+
+ArmInsnFunc armInsnFunc(u32 opcode)
+{
+    return armInsnTable[((opcode>>16)&0xFF0) | ((opcode>>4)&0x0F)];
+}
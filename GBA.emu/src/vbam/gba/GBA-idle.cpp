@@ -0,0 +1,291 @@
+#include <string.h>
+#include "GBA.h"
+#include "GBAcpu.h"
+#include "GBAinline.h"
+#include "Globals.h"
+
+// Skips loops that only wait for the next event, like polling VCOUNT, DISPSTAT
+// or a flag set by an interrupt handler. A short backward branch is checked once:
+// the loop must be straight-line code of ALU ops and loads from memory that only
+// changes at events, and must not carry a register or flag from one iteration to
+// the next. Every iteration then does the same until the next event, so the CPU
+// jumps to it instead of spinning.
+
+bool cpuSkipIdleLoops = true;
+u32 cpuIdleLoop;
+
+static const u32 FLAG_N = 1 << 16, FLAG_Z = 1 << 17, FLAG_C = 1 << 18, FLAG_V = 1 << 19;
+static const u32 FLAGS_NZ = FLAG_N | FLAG_Z, FLAGS_NZC = FLAGS_NZ | FLAG_C,
+	FLAGS_NZCV = FLAGS_NZC | FLAG_V;
+static const uint rejectedLoopsSize = 64;
+
+// branches of loops found not to be idle, as address | thumb
+static u32 rejectedLoops[rejectedLoopsSize];
+// last branch of an idle loop taken with no other branch or skip since,
+// skipping happens the next time it's taken
+u32 idleLoopLastBranch;
+
+// registers (bits 0-14, R15 reads are constant) and flags an instruction uses
+struct InsnUse
+{
+	u32 reads, writes, maybeWrites;
+};
+
+static u32 regBit(uint r) { return r == 15 ? 0 : 1 << r; }
+
+// memory that only changes by CPU stores, DMA or at events
+static bool isIdleAddress(u32 address)
+{
+	switch(address >> 24)
+	{
+		case 0x02 ... 0x03:
+		case 0x05 ... 0x07:
+		case 0x08 ... 0x0C:
+			return 1;
+		case 0x04:
+		{
+			uint io = address & 0xFFFFFF;
+			// timer counters run between events, serial reads have side effects
+			return io < 0x400 && !(io >= 0x100 && io < 0x110) && !(io >= 0x120 && io < 0x160);
+		}
+	}
+	return 0;
+}
+
+static bool thumbInsnUse(ARM7TDMI &cpu, u32 pc, u32 opcode, InsnUse &u)
+{
+	uint rd = opcode & 7, rs = (opcode >> 3) & 7, rn = (opcode >> 6) & 7;
+	switch(opcode >> 11)
+	{
+		case 0x00 ... 0x02: // LSL/LSR/ASR Rd, Rs, #imm5
+			u.reads = regBit(rs);
+			u.writes = regBit(rd) | FLAGS_NZ;
+			u.maybeWrites = FLAG_C; // unchanged by LSL #0
+			return 1;
+		case 0x03: // ADD/SUB Rd, Rs, Rn/#imm3
+			u.reads = regBit(rs) | ((opcode & 0x400) ? 0 : regBit(rn));
+			u.writes = regBit(rd) | FLAGS_NZCV;
+			return 1;
+		case 0x04 ... 0x07: // MOV/CMP/ADD/SUB Rd, #imm8
+		{
+			uint op = (opcode >> 11) & 3;
+			rd = (opcode >> 8) & 7;
+			u.reads = op ? regBit(rd) : 0;
+			u.writes = (op == 1 ? 0 : regBit(rd)) | (op ? FLAGS_NZCV : FLAGS_NZ);
+			return 1;
+		}
+		case 0x08:
+		{
+			if(opcode & 0x400)
+			{
+				// ADD/CMP/MOV with high registers, BX
+				uint op = (opcode >> 8) & 3;
+				rd |= (opcode >> 4) & 8;
+				rs = (opcode >> 3) & 0xF;
+				if(op == 1)
+				{
+					u.reads = regBit(rd) | regBit(rs);
+					u.writes = FLAGS_NZCV;
+					return 1;
+				}
+				if(op == 3 || rd == 15)
+					return 0;
+				u.reads = (op == 0 ? regBit(rd) : 0) | regBit(rs);
+				u.writes = regBit(rd);
+				return 1;
+			}
+			static const u32 aluFlags[16]
+			{
+				FLAGS_NZ, FLAGS_NZ, FLAGS_NZ, FLAGS_NZ, // AND, EOR, LSL, LSR
+				FLAGS_NZ, FLAGS_NZCV, FLAGS_NZCV, FLAGS_NZ, // ASR, ADC, SBC, ROR
+				FLAGS_NZ, FLAGS_NZCV, FLAGS_NZCV, FLAGS_NZCV, // TST, NEG, CMP, CMN
+				FLAGS_NZ, FLAGS_NZ, FLAGS_NZ, FLAGS_NZ // ORR, MUL, BIC, MVN
+			};
+			uint op = (opcode >> 6) & 0xF;
+			u.reads = regBit(rs) | (op == 9 || op == 15 ? 0 : regBit(rd)) | (op == 5 || op == 6 ? FLAG_C : 0);
+			u.writes = (op == 8 || op == 10 || op == 11 ? 0 : regBit(rd)) | aluFlags[op];
+			if(op == 2 || op == 3 || op == 4 || op == 7)
+				u.maybeWrites = FLAG_C; // unchanged by a shift of 0
+			return 1;
+		}
+		case 0x09: // LDR Rd, [PC, #imm8]
+			u.writes = regBit((opcode >> 8) & 7);
+			return isIdleAddress(((pc + 4) & ~2) + (opcode & 0xFF) * 4);
+		case 0x0A ... 0x0B: // loads/stores with register offset
+			if(((opcode >> 9) & 7) < 3)
+				return 0; // STR, STRH, STRB
+			u.reads = regBit(rs) | regBit(rn);
+			u.writes = regBit(rd);
+			return isIdleAddress(cpu.reg[rs].I + cpu.reg[rn].I);
+		case 0x0D: // LDR Rd, [Rs, #imm5]
+		case 0x0F: // LDRB
+		case 0x11: // LDRH
+		{
+			uint scale = (opcode >> 11) == 0x0D ? 4 : (opcode >> 11) == 0x11 ? 2 : 1;
+			u.reads = regBit(rs);
+			u.writes = regBit(rd);
+			return isIdleAddress(cpu.reg[rs].I + ((opcode >> 6) & 0x1F) * scale);
+		}
+		case 0x13: // LDR Rd, [SP, #imm8]
+			u.reads = regBit(13);
+			u.writes = regBit((opcode >> 8) & 7);
+			return isIdleAddress(cpu.reg[13].I + (opcode & 0xFF) * 4);
+		case 0x14: // ADD Rd, PC, #imm8
+		case 0x15: // ADD Rd, SP, #imm8
+			u.reads = (opcode & 0x800) ? regBit(13) : 0;
+			u.writes = regBit((opcode >> 8) & 7);
+			return 1;
+	}
+	return 0;
+}
+
+static bool armLoadUse(ARM7TDMI &cpu, u32 pc, u32 opcode, u32 offset, InsnUse &u)
+{
+	uint rn = (opcode >> 16) & 15;
+	bool pre = opcode & (1 << 24), writeback = !pre || (opcode & (1 << 21));
+	if(writeback && rn == 15)
+		return 0;
+	u32 base = rn == 15 ? pc + 8 : cpu.reg[rn].I;
+	u.reads |= regBit(rn);
+	u.writes = regBit((opcode >> 12) & 15) | (writeback ? regBit(rn) : 0);
+	if(pre)
+		base = (opcode & (1 << 23)) ? base + offset : base - offset;
+	return isIdleAddress(base);
+}
+
+static bool armInsnUse(ARM7TDMI &cpu, u32 pc, u32 opcode, InsnUse &u)
+{
+	uint rd = (opcode >> 12) & 15, rn = (opcode >> 16) & 15, rm = opcode & 15;
+	if(rd == 15)
+		return 0;
+	if((opcode & 0x0E000090) == 0x00000090)
+	{
+		// multiplies, swaps and halfword transfers, only LDRH/LDRSB/LDRSH are allowed
+		if((opcode & 0x0E100090) != 0x00100090 || !(opcode & 0x60))
+			return 0;
+		u32 offset = (opcode & (1 << 22)) ? ((opcode >> 4) & 0xF0) | (opcode & 0xF) : cpu.reg[rm].I;
+		u.reads = (opcode & (1 << 22)) ? 0 : regBit(rm);
+		return armLoadUse(cpu, pc, opcode, offset, u);
+	}
+	switch((opcode >> 26) & 3)
+	{
+		case 0: // data processing
+		{
+			uint op = (opcode >> 21) & 15;
+			bool setFlags = opcode & (1 << 20);
+			if(op >= 8 && op <= 11 && !setFlags)
+				return 0; // MRS, MSR, BX
+			u.reads = (op == 13 || op == 15) ? 0 : regBit(rn);
+			if(!(opcode & (1 << 25)))
+			{
+				u.reads |= regBit(rm);
+				if(opcode & 0x10)
+					u.reads |= regBit((opcode >> 8) & 15);
+				else if((opcode & 0xFF0) == 0x060)
+					u.reads |= FLAG_C; // RRX
+			}
+			if(op >= 5 && op <= 7)
+				u.reads |= FLAG_C; // ADC, SBC, RSC
+			u.writes = (op >= 8 && op <= 11) ? 0 : regBit(rd);
+			if(setFlags)
+			{
+				bool arithmetic = (op >= 2 && op <= 7) || op == 10 || op == 11;
+				if(arithmetic)
+					u.writes |= FLAGS_NZCV;
+				else
+				{
+					u.writes |= FLAGS_NZ;
+					u.maybeWrites = FLAG_C; // the shifter's carry, or unchanged
+				}
+			}
+			return 1;
+		}
+		case 1: // LDR/LDRB
+		{
+			if(!(opcode & (1 << 20)))
+				return 0;
+			u32 offset = opcode & 0xFFF;
+			if(opcode & (1 << 25))
+			{
+				if(opcode & 0x70)
+					return 0; // only register offsets shifted by LSL #imm
+				offset = cpu.reg[rm].I << ((opcode >> 7) & 0x1F);
+				u.reads = regBit(rm);
+			}
+			return armLoadUse(cpu, pc, opcode, offset, u);
+		}
+	}
+	return 0;
+}
+
+// checks the loop from target up to the backward branch at branchPC,
+// registers hold the values of the last iteration
+static bool isIdleLoop(ARM7TDMI &cpu, u32 target, u32 branchPC, bool thumb)
+{
+	u32 readFirst = 0, written = 0, setFirst = 0;
+	for(u32 pc = target; pc < branchPC; pc += thumb ? 2 : 4)
+	{
+		InsnUse u {};
+		if(thumb)
+		{
+			if(!thumbInsnUse(cpu, pc, CPUReadHalfWordQuick(cpu, pc), u))
+				return 0;
+		}
+		else
+		{
+			u32 opcode = CPUReadMemoryQuick(cpu, pc);
+			uint cond = opcode >> 28;
+			if(cond == 0xF || !armInsnUse(cpu, pc, opcode, u))
+				return 0;
+			if(cond != 0xE)
+			{
+				u.reads |= FLAGS_NZCV;
+				u.maybeWrites |= u.writes;
+				u.writes = 0;
+			}
+		}
+		readFirst |= u.reads & ~setFirst;
+		written |= u.writes | u.maybeWrites;
+		setFirst |= u.writes;
+	}
+	bool conditional = thumb ? (CPUReadHalfWordQuick(cpu, branchPC) & 0xF000) == 0xD000
+		: (CPUReadMemoryQuick(cpu, branchPC) >> 28) != 0xE;
+	if(conditional)
+		readFirst |= FLAGS_NZCV & ~setFirst;
+	// a value carried over from the previous iteration can make this one differ
+	return !(readFirst & written);
+}
+
+void idleLoopBranch(ARM7TDMI &cpu, u32 branchPC, u32 target, bool thumb)
+{
+	u32 key = branchPC | thumb;
+	u32 &rejected = rejectedLoops[(branchPC >> 1) & (rejectedLoopsSize - 1)];
+	if(rejected == key)
+	{
+		idleLoopLastBranch = 0;
+		return;
+	}
+	if(!isIdleLoop(cpu, target, branchPC, thumb))
+	{
+		rejected = key;
+		idleLoopLastBranch = 0;
+		return;
+	}
+	if(idleLoopLastBranch != key)
+	{
+		// the code before the loop may have jumped straight to the branch,
+		// wait for an iteration that ran from the start
+		idleLoopLastBranch = key;
+		return;
+	}
+	// the event may change what the loop reads, so the next skip also
+	// waits for a whole iteration
+	idleLoopLastBranch = 0;
+	idleLoopSkip(cpu);
+}
+
+void idleLoopReset()
+{
+	memset(rejectedLoops, 0, sizeof(rejectedLoops));
+	idleLoopLastBranch = 0;
+}
@@ -0,0 +1,1017 @@
+#include <stdlib.h>
+#include <string.h>
+#include "GBA.h"
+#include "GBAcpu.h"
+#include "GBAinline.h"
+#include "GBAJit.h"
+#include "Globals.h"
+
+#ifdef VBAM_USE_JIT
+
+#include <sys/mman.h>
+
+// Translates basic blocks of ARM/Thumb code from ROM and work/internal RAM to
+// x86-64. Common data processing instructions become native code, everything else
+// is a direct call to its interpreter handler with the opcode and PC as
+// constants, so fetch, decode and dispatch disappear while the handlers stay the
+// single source of truth for the ARM7TDMI's behavior. The pipeline, tick counting
+// and event checks after every instruction mirror armExecute()/thumbExecute()
+// exactly, and a block can be left and re-entered at any instruction. Stores to
+// RAM pages holding code drop their blocks. Blocks whose recorded pipeline doesn't
+// match the CPU's (code modified right ahead of the PC), RAM pages that keep getting
+// rewritten and code outside ROM/RAM run one instruction at a time in the interpreter.
+
+bool cpuJitEnabled = true;
+u8 jitWorkRAMCode[0x40000 >> JIT_PAGE_SHIFT];
+u8 jitInternalRAMCode[0x8000 >> JIT_PAGE_SHIFT];
+
+// entry point into translated code, every instruction of a block has one so
+// execution resumes in place after an event
+struct JitBlock
+{
+	u8 *code;
+	u32 pc;
+	u32 prefetch[2]; // pipeline contents when entering here
+	u16 entries; // in a block's first entry, the number of entries it has
+	bool thumb;
+};
+
+// links a RAM page to the blocks translated from it
+struct JitPageLink
+{
+	JitBlock *block; // first entry
+	JitPageLink *next;
+};
+
+static const uint codeBufferSize = 16 * 1024 * 1024;
+static const uint maxBlockBytes = 32 * 1024;
+static const uint maxBlockInsns = 64;
+static const uint maxBlocks = 0x20000; // entries
+static const uint maxPageLinks = maxBlocks;
+static const uint lookupPageShift = 12;
+static const uint lookupPages = 0x0E000000 >> lookupPageShift;
+static const uint lookupPageEntries = (1 << lookupPageShift) / 2;
+static const uint workRAMPages = 0x40000 >> JIT_PAGE_SHIFT;
+static const uint internalRAMPages = 0x8000 >> JIT_PAGE_SHIFT;
+// pages rewritten this often while holding code are left to the interpreter
+static const uint maxPageInvalidations = 32;
+
+static u8 *codeBuffer; // starts with the exit flag, the entry/exit code, then translated code
+// the flag gets its own page since stores near running code are expensive on x86
+static const uint enterOffset = 4096, exitOffset = enterOffset + 32, blocksOffset = enterOffset + 64;
+static u8 *codePos;
+static JitBlock *blocks;
+static uint usedBlocks;
+static JitPageLink *pageLinks;
+static uint usedPageLinks;
+static JitPageLink *ramPageBlocks[workRAMPages + internalRAMPages];
+static u8 ramPageInvalidations[workRAMPages + internalRAMPages];
+static JitBlock ***lookup; // [lookupPages][lookupPageEntries], second level allocated on use
+static bool initFailed, flushPending;
+
+static volatile u8 &exitFlag() { return codeBuffer[0]; }
+
+// sets up rbx as the ARM7TDMI and jumps to code
+static void enter(ARM7TDMI &cpu, u8 *code)
+{
+	((void (*)(ARM7TDMI*, u8*))(codeBuffer + enterOffset))(&cpu, code);
+}
+
+static uint ramPage(u32 address)
+{
+	if((address >> 24) == 0x02)
+		return (address & 0x3FFFF) >> JIT_PAGE_SHIFT;
+	else
+		return workRAMPages + ((address & 0x7FFF) >> JIT_PAGE_SHIFT);
+}
+
+static JitPageLink *&ramPageList(u32 address)
+{
+	return ramPageBlocks[ramPage(address)];
+}
+
+static bool isTranslated(u32 pc)
+{
+	switch(pc >> 24)
+	{
+		case 0x02:
+		case 0x03:
+			return ramPageInvalidations[ramPage(pc)] < maxPageInvalidations;
+		case 0x08 ... 0x0D:
+			return 1;
+	}
+	return 0;
+}
+
+// returns the lookup slot of pc, allocating its page if alloc is set,
+// or nullptr if the page doesn't exist or is out of memory
+static JitBlock **lookupEntry(u32 pc, bool alloc = 1)
+{
+	auto &page = lookup[pc >> lookupPageShift];
+	if(!page)
+	{
+		if(!alloc)
+			return nullptr;
+		page = (JitBlock**)calloc(lookupPageEntries, sizeof(JitBlock*));
+		if(!page)
+			return nullptr;
+	}
+	return &page[(pc & ((1 << lookupPageShift) - 1)) >> 1];
+}
+
+static bool init()
+{
+	void *mem = mmap(nullptr, codeBufferSize, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if(mem == MAP_FAILED)
+	{
+		logErr("can't map JIT code buffer");
+		return 0;
+	}
+	codeBuffer = (u8*)mem;
+	blocks = (JitBlock*)malloc(sizeof(JitBlock) * maxBlocks);
+	pageLinks = (JitPageLink*)malloc(sizeof(JitPageLink) * maxPageLinks);
+	lookup = (JitBlock***)calloc(lookupPages, sizeof(JitBlock**));
+	if(!blocks || !pageLinks || !lookup)
+	{
+		logErr("out of memory for JIT tables");
+		munmap(mem, codeBufferSize);
+		codeBuffer = nullptr;
+		return 0;
+	}
+	static const u8 enterCode[]
+	{
+		0x53, // push rbx
+		0x48, 0x83, 0xEC, 16, // sub rsp, 16
+		0x48, 0x89, 0xFB, // mov rbx, rdi
+		0xFF, 0xE6 // jmp rsi
+	};
+	static const u8 exitCode[]
+	{
+		0x48, 0x83, 0xC4, 16, // add rsp, 16
+		0x5B, // pop rbx
+		0xC3 // ret
+	};
+	memcpy(codeBuffer + enterOffset, enterCode, sizeof(enterCode));
+	memcpy(codeBuffer + exitOffset, exitCode, sizeof(exitCode));
+	codePos = codeBuffer + blocksOffset;
+	logMsg("JIT code buffer at %p", codeBuffer);
+	return 1;
+}
+
+void jitFlush()
+{
+	if(!codeBuffer)
+		return;
+	iterateTimes(lookupPages, i)
+	{
+		if(lookup[i])
+			memset(lookup[i], 0, lookupPageEntries * sizeof(JitBlock*));
+	}
+	memset(ramPageBlocks, 0, sizeof(ramPageBlocks));
+	memset(ramPageInvalidations, 0, sizeof(ramPageInvalidations));
+	memset(jitWorkRAMCode, 0, sizeof(jitWorkRAMCode));
+	memset(jitInternalRAMCode, 0, sizeof(jitInternalRAMCode));
+	usedBlocks = usedPageLinks = 0;
+	codePos = codeBuffer + blocksOffset;
+	// translated code is only reused after the running block returns
+	exitFlag() = 1;
+}
+
+void jitInvalidatePage(u32 address)
+{
+	auto &list = ramPageList(address);
+	for(auto link = list; link; link = link->next)
+	{
+		auto block = link->block;
+		iterateTimes(block->entries, i)
+		{
+			auto entry = lookupEntry(block[i].pc, 0);
+			if(entry && *entry == &block[i])
+				*entry = nullptr;
+		}
+	}
+	list = nullptr;
+	auto &invalidations = ramPageInvalidations[ramPage(address)];
+	if(invalidations < maxPageInvalidations)
+		invalidations++;
+	if((address >> 24) == 0x02)
+		jitWorkRAMCode[(address & 0x3FFFF) >> JIT_PAGE_SHIFT] = 0;
+	else
+		jitInternalRAMCode[(address & 0x7FFF) >> JIT_PAGE_SHIFT] = 0;
+	exitFlag() = 1;
+}
+
+void jitLoadRAM(u8 *dest, const u8 *src, u32 address, u32 size)
+{
+	if(codeBuffer)
+	{
+		auto code = (address >> 24) == 0x02 ? jitWorkRAMCode : jitInternalRAMCode;
+		for(u32 offset = 0; offset < size; offset += 1 << JIT_PAGE_SHIFT)
+		{
+			if(code[offset >> JIT_PAGE_SHIFT] && memcmp(&dest[offset], &src[offset], 1 << JIT_PAGE_SHIFT) != 0)
+				jitInvalidatePage(address + offset);
+		}
+	}
+	memcpy(dest, src, size);
+}
+
+static void addRamPageLink(u32 address, JitBlock *block)
+{
+	auto &list = ramPageList(address);
+	if(list && list->block == block)
+		return;
+	auto link = &pageLinks[usedPageLinks++];
+	link->block = block;
+	link->next = list;
+	list = link;
+	if((address >> 24) == 0x02)
+		jitWorkRAMCode[(address & 0x3FFFF) >> JIT_PAGE_SHIFT] = 1;
+	else
+		jitInternalRAMCode[(address & 0x7FFF) >> JIT_PAGE_SHIFT] = 1;
+}
+
+// x86-64 encoding, the ARM7TDMI is always addressed through rbx
+class X64Emitter
+{
+public:
+	u8 *p;
+
+	X64Emitter(u8 *p): p(p) { }
+
+	void byte(u8 b) { *p++ = b; }
+	void dword(u32 v) { memcpy(p, &v, 4); p += 4; }
+	void qword(u64 v) { memcpy(p, &v, 8); p += 8; }
+
+	// op with a [rbx+disp32] operand, reg is a register or opcode extension
+	void rbxOp(u8 op, uint reg, int32 disp) { byte(op); byte(0x83 | (reg << 3)); dword(disp); }
+	void rbxOp2(u8 op, u8 op2, uint reg, int32 disp) { byte(op); rbxOp(op2, reg, disp); }
+
+	void movMemImm32(int32 disp, u32 imm) { rbxOp(0xC7, 0, disp); dword(imm); }
+	void movMemImm8(int32 disp, u8 imm) { rbxOp(0xC6, 0, disp); byte(imm); }
+	void movEaxMem(int32 disp) { rbxOp(0x8B, 0, disp); }
+	void movMemEax(int32 disp) { rbxOp(0x89, 0, disp); }
+	void movMemEcx(int32 disp) { rbxOp(0x89, 1, disp); }
+	void movEcxMem(int32 disp) { rbxOp(0x8B, 1, disp); }
+	void addMemEax(int32 disp) { rbxOp(0x01, 0, disp); }
+	void cmpEaxMem(int32 disp) { rbxOp(0x3B, 0, disp); }
+	void cmpMemImm32(int32 disp, u32 imm) { rbxOp(0x81, 7, disp); dword(imm); }
+	void cmpMemImm8(int32 disp, u8 imm) { rbxOp(0x80, 7, disp); byte(imm); }
+	void cmpAlMem(int32 disp) { rbxOp(0x3A, 0, disp); }
+	// ALU op eax, [rbx+disp32], op being the 0x03 (add) style opcode
+	void aluEaxMem(u8 op, int32 disp) { rbxOp(op, 0, disp); }
+	void aluEaxImm(u8 op, u32 imm) { byte(op); dword(imm); }
+	// ALU op eax, ecx, op being the 0x01 (add) style opcode
+	void aluEaxEcx(u8 op) { byte(op); byte(0xC8); }
+	// setcc [rbx+disp32], cc being the low nibble of the Jcc opcode
+	void setccMem(uint cc, int32 disp) { rbxOp2(0x0F, 0x90 | cc, 0, disp); }
+	void shiftEaxImm(uint ext, u8 count) { byte(0xC1); byte(0xC0 | (ext << 3)); byte(count); }
+	void shiftEcxImm(uint ext, u8 count) { byte(0xC1); byte(0xC1 | (ext << 3)); byte(count); }
+	void notEax() { byte(0xF7); byte(0xD0); }
+	void notEcx() { byte(0xF7); byte(0xD1); }
+	void movEaxEcx() { byte(0x89); byte(0xC8); }
+	void movEcxImm(u32 imm) { byte(0xB9); dword(imm); }
+	void xorEaxEax() { byte(0x31); byte(0xC0); }
+	void movEaxImm(u32 imm) { byte(0xB8); dword(imm); }
+	void movEsiImm(u32 imm) { byte(0xBE); dword(imm); }
+	void movEdxImm(u32 imm) { byte(0xBA); dword(imm); }
+	void movRdiRbx() { byte(0x48); byte(0x89); byte(0xDF); }
+	void movRdxRsp() { byte(0x48); byte(0x89); byte(0xE2); }
+	void movStackImm(u32 imm) { byte(0xC7); byte(0x04); byte(0x24); dword(imm); }
+	void movEaxStack() { byte(0x8B); byte(0x04); byte(0x24); }
+	void testEaxEax() { byte(0x85); byte(0xC0); }
+	void testAlAl() { byte(0x84); byte(0xC0); }
+	void testEaxImm(u32 imm) { byte(0xA9); dword(imm); }
+
+	template <class F>
+	void call(F func)
+	{
+		byte(0x48); byte(0xB8); qword((u64)func); // mov rax, func
+		byte(0xFF); byte(0xD0); // call rax
+	}
+
+	void cmpRipImm8(const volatile u8 *addr, u8 imm)
+	{
+		byte(0x80); byte(0x3D);
+		dword((u8*)addr - (p + 5));
+		byte(imm);
+	}
+
+	// 32-bit relative jumps, cc = -1 for jmp
+	void jump(int cc, const u8 *target)
+	{
+		if(cc < 0)
+		{
+			byte(0xE9);
+		}
+		else
+		{
+			byte(0x0F); byte(0x80 | cc);
+		}
+		dword(target - (p + 4));
+	}
+
+	u8 *jumpForward(int cc)
+	{
+		jump(cc, p);
+		return p - 4;
+	}
+
+	// 8-bit forward jump, bound later with bind()
+	u8 *jumpShort(int cc)
+	{
+		byte(cc < 0 ? 0xEB : 0x70 | cc);
+		byte(0);
+		return p - 1;
+	}
+
+	void bind(u8 *rel8) { *rel8 = p - (rel8 + 1); }
+	void bind32(u8 *rel32) { u32 rel = p - (rel32 + 4); memcpy(rel32, &rel, 4); }
+};
+
+enum { CC_O = 0x0, CC_C = 0x2, CC_NC = 0x3, CC_Z = 0x4, CC_NZ = 0x5, CC_BE = 0x6, CC_A = 0x7,
+	CC_S = 0x8, CC_NS = 0x9, CC_GE = 0xD, JMP = -1 };
+
+// byte offsets of the ARM7TDMI fields used by translated code
+static struct CpuOffsets
+{
+	int32 reg, armNextPC, totalTicks, nextEvent, prefetch, busPrefetchCount,
+		lastArithmeticRes, cFlag, vFlag, busPrefetch, armState, memoryWait, memoryWait32, memoryWaitSeq, memoryWaitSeq32;
+} ofs;
+
+template <class T>
+static int32 fieldOffset(ARM7TDMI &cpu, T &field)
+{
+	return (u8*)&field - (u8*)&cpu;
+}
+
+static void setOffsets(ARM7TDMI &cpu)
+{
+	ofs.reg = fieldOffset(cpu, cpu.reg);
+	ofs.armNextPC = fieldOffset(cpu, cpu.armNextPC);
+	ofs.totalTicks = fieldOffset(cpu, cpu.cpuTotalTicks);
+	ofs.nextEvent = fieldOffset(cpu, cpu.cpuNextEvent);
+	ofs.prefetch = fieldOffset(cpu, *cpu.prefetchBuffer());
+	ofs.busPrefetchCount = fieldOffset(cpu, cpu.busPrefetchCount);
+	ofs.lastArithmeticRes = fieldOffset(cpu, cpu.lastArithmeticRes);
+	ofs.cFlag = fieldOffset(cpu, cpu.C_FLAG);
+	ofs.vFlag = fieldOffset(cpu, cpu.V_FLAG);
+	ofs.busPrefetch = fieldOffset(cpu, cpu.busPrefetch);
+	ofs.armState = fieldOffset(cpu, cpu.armState);
+	ofs.memoryWait = fieldOffset(cpu, cpu.memoryWait);
+	ofs.memoryWait32 = fieldOffset(cpu, cpu.memoryWait32);
+	ofs.memoryWaitSeq = fieldOffset(cpu, cpu.memoryWaitSeq);
+	ofs.memoryWaitSeq32 = fieldOffset(cpu, cpu.memoryWaitSeq32);
+}
+
+static int32 regOffset(uint r) { return ofs.reg + r * 4; }
+
+// state the interpreter leaves after fetching the instruction at pc
+struct FetchState
+{
+	u32 prefetch[2];
+	u32 armNextPC, r15;
+};
+
+static void emitFetchState(X64Emitter &e, const FetchState &s)
+{
+	e.movMemImm32(ofs.prefetch, s.prefetch[0]);
+	e.movMemImm32(ofs.prefetch + 4, s.prefetch[1]);
+	e.movMemImm8(ofs.busPrefetch, 0);
+	e.movMemImm32(ofs.armNextPC, s.armNextPC);
+	e.movMemImm32(regOffset(15), s.r15);
+}
+
+static void emitEventCheck(X64Emitter &e, const u8 *exit)
+{
+	e.movEaxMem(ofs.totalTicks);
+	e.cmpEaxMem(ofs.nextEvent);
+	e.jump(CC_GE, exit);
+}
+
+// after a handler: leave on invalidated code, a branch, a state switch or a due event
+static void emitHandlerChecks(X64Emitter &e, const u8 *exit, u32 nextPC, bool armState)
+{
+	e.cmpRipImm8(&exitFlag(), 0);
+	e.jump(CC_NZ, exit);
+	e.cmpMemImm32(ofs.armNextPC, nextPC);
+	e.jump(CC_NZ, exit);
+	e.cmpMemImm8(ofs.armState, armState);
+	e.jump(CC_NZ, exit);
+	emitEventCheck(e, exit);
+}
+
+// codeTicksAccessSeq16(cpu, pc) + 1 added to cpuTotalTicks
+static void emitThumbSeqTicks(X64Emitter &e, u32 pc)
+{
+	uint region = (pc >> 24) & 15;
+	if(region >= 0x08 && region <= 0x0D)
+	{
+		e.movEaxMem(ofs.busPrefetchCount);
+		e.byte(0xA8); e.byte(1); // test al, 1
+		auto notPrefetched = e.jumpShort(CC_Z);
+		// busPrefetchCount = ((busPrefetchCount & 0xFF) >> 1) | (busPrefetchCount & 0xFFFFFF00)
+		e.byte(0x0F); e.byte(0xB6); e.byte(0xC8); // movzx ecx, al
+		e.byte(0xD1); e.byte(0xE9); // shr ecx, 1
+		e.aluEaxImm(0x25, 0xFFFFFF00); // and eax
+		e.byte(0x09); e.byte(0xC8); // or eax, ecx
+		e.movMemEax(ofs.busPrefetchCount);
+		e.movEaxImm(1);
+		auto done1 = e.jumpShort(JMP);
+		e.bind(notPrefetched);
+		e.aluEaxImm(0x3D, 0xFF); // cmp eax, 0xFF
+		auto seq = e.jumpShort(CC_BE);
+		e.movMemImm32(ofs.busPrefetchCount, 0);
+		e.movEaxMem(ofs.memoryWait + region * 4);
+		auto done2 = e.jumpShort(JMP);
+		e.bind(seq);
+		e.movEaxMem(ofs.memoryWaitSeq + region * 4);
+		e.bind(done2);
+		e.aluEaxImm(0x05, 1); // add eax, 1
+		e.bind(done1);
+	}
+	else
+	{
+		e.movMemImm32(ofs.busPrefetchCount, 0);
+		e.movEaxMem(ofs.memoryWaitSeq + region * 4);
+		e.aluEaxImm(0x05, 1);
+	}
+	e.addMemEax(ofs.totalTicks);
+}
+
+// codeTicksAccessSeq32(cpu, pc) + 1 left in eax
+static void emitArmSeqTicks(X64Emitter &e, u32 pc)
+{
+	uint region = (pc >> 24) & 15;
+	if(region >= 0x08 && region <= 0x0D)
+	{
+		e.movEaxMem(ofs.busPrefetchCount);
+		e.byte(0xA8); e.byte(1); // test al, 1
+		auto notPrefetched = e.jumpShort(CC_Z);
+		// busPrefetchCount = ((busPrefetchCount & 0xFF) >> 1 or 2) | (busPrefetchCount & 0xFFFFFF00)
+		e.byte(0x0F); e.byte(0xB6); e.byte(0xC8); // movzx ecx, al
+		e.aluEaxImm(0x25, 0xFFFFFF00); // and eax
+		e.byte(0xF6); e.byte(0xC1); e.byte(2); // test cl, 2
+		auto oneWord = e.jumpShort(CC_Z);
+		e.byte(0xC1); e.byte(0xE9); e.byte(2); // shr ecx, 2
+		e.aluEaxEcx(0x09);
+		e.movMemEax(ofs.busPrefetchCount);
+		e.movEaxImm(1);
+		auto done1 = e.jumpShort(JMP);
+		e.bind(oneWord);
+		e.byte(0xD1); e.byte(0xE9); // shr ecx, 1
+		e.aluEaxEcx(0x09);
+		e.movMemEax(ofs.busPrefetchCount);
+		e.movEaxMem(ofs.memoryWaitSeq + region * 4);
+		auto done2 = e.jumpShort(JMP);
+		e.bind(notPrefetched);
+		e.aluEaxImm(0x3D, 0xFF); // cmp eax, 0xFF
+		auto seq = e.jumpShort(CC_BE);
+		e.movMemImm32(ofs.busPrefetchCount, 0);
+		e.movEaxMem(ofs.memoryWait32 + region * 4);
+		auto done3 = e.jumpShort(JMP);
+		e.bind(seq);
+		e.movEaxMem(ofs.memoryWaitSeq32 + region * 4);
+		e.bind(done2);
+		e.bind(done3);
+		e.aluEaxImm(0x05, 1);
+		e.bind(done1);
+	}
+	else
+	{
+		e.movEaxMem(ofs.memoryWaitSeq32 + region * 4);
+		e.aluEaxImm(0x05, 1);
+	}
+}
+
+// if (busPrefetchCount & 0xFFFFFE00) busPrefetchCount = 0x100 | (busPrefetchCount & 0xFF)
+static void emitArmBusPrefetchFix(X64Emitter &e)
+{
+	e.movEaxMem(ofs.busPrefetchCount);
+	e.testEaxImm(0xFFFFFE00);
+	auto noFix = e.jumpShort(CC_Z);
+	e.byte(0x0F); e.byte(0xB6); e.byte(0xC0); // movzx eax, al
+	e.aluEaxImm(0x0D, 0x100); // or eax
+	e.movMemEax(ofs.busPrefetchCount);
+	e.bind(noFix);
+}
+
+// compares N (bit 31 of lastArithmeticRes) with V
+static void emitCmpNV(X64Emitter &e)
+{
+	e.movEaxMem(ofs.lastArithmeticRes);
+	e.shiftEaxImm(5, 31); // shr
+	e.cmpAlMem(ofs.vFlag);
+}
+
+// mirrors armCondition(), returns the number of jumps taken when it fails
+static uint emitArmCondition(X64Emitter &e, uint cond, u8 *skips[2])
+{
+	switch(cond)
+	{
+		case 0x0 ... 0x1: // EQ, NE
+			e.cmpMemImm32(ofs.lastArithmeticRes, 0);
+			skips[0] = e.jumpForward(cond == 0x0 ? CC_NZ : CC_Z);
+			return 1;
+		case 0x2 ... 0x3: // CS, CC
+			e.cmpMemImm8(ofs.cFlag, 0);
+			skips[0] = e.jumpForward(cond == 0x2 ? CC_Z : CC_NZ);
+			return 1;
+		case 0x4 ... 0x5: // MI, PL
+			e.cmpMemImm32(ofs.lastArithmeticRes, 0);
+			skips[0] = e.jumpForward(cond == 0x4 ? CC_NS : CC_S);
+			return 1;
+		case 0x6 ... 0x7: // VS, VC
+			e.cmpMemImm8(ofs.vFlag, 0);
+			skips[0] = e.jumpForward(cond == 0x6 ? CC_Z : CC_NZ);
+			return 1;
+		case 0x8: // HI, C && !Z
+			e.cmpMemImm8(ofs.cFlag, 0);
+			skips[0] = e.jumpForward(CC_Z);
+			e.cmpMemImm32(ofs.lastArithmeticRes, 0);
+			skips[1] = e.jumpForward(CC_Z);
+			return 2;
+		case 0x9: // LS, !C || Z
+		{
+			e.cmpMemImm8(ofs.cFlag, 0);
+			auto pass = e.jumpShort(CC_Z);
+			e.cmpMemImm32(ofs.lastArithmeticRes, 0);
+			skips[0] = e.jumpForward(CC_NZ);
+			e.bind(pass);
+			return 1;
+		}
+		case 0xA ... 0xB: // GE, LT
+			emitCmpNV(e);
+			skips[0] = e.jumpForward(cond == 0xA ? CC_NZ : CC_Z);
+			return 1;
+		case 0xC: // GT, !Z && N == V
+			e.cmpMemImm32(ofs.lastArithmeticRes, 0);
+			skips[0] = e.jumpForward(CC_Z);
+			emitCmpNV(e);
+			skips[1] = e.jumpForward(CC_NZ);
+			return 2;
+		case 0xD: // LE, Z || N != V
+		{
+			e.cmpMemImm32(ofs.lastArithmeticRes, 0);
+			auto pass = e.jumpShort(CC_Z);
+			emitCmpNV(e);
+			skips[0] = e.jumpForward(CC_Z);
+			e.bind(pass);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void emitSetNZ(X64Emitter &e, uint rd)
+{
+	if(rd < 8)
+		e.movMemEax(regOffset(rd));
+	e.movMemEax(ofs.lastArithmeticRes);
+}
+
+static void emitAddFlags(X64Emitter &e)
+{
+	e.setccMem(CC_C, ofs.cFlag);
+	e.setccMem(CC_O, ofs.vFlag);
+}
+
+static void emitSubFlags(X64Emitter &e)
+{
+	// ARM's carry is the inverse of x86's borrow
+	e.setccMem(CC_NC, ofs.cFlag);
+	e.setccMem(CC_O, ofs.vFlag);
+}
+
+// native code for Thumb data processing that only touches r0-r7 and the flags,
+// returns false for anything left to the handler
+static bool emitThumbNative(X64Emitter &e, u32 opcode)
+{
+	uint rd = opcode & 7, rs = (opcode >> 3) & 7;
+	switch(opcode >> 11)
+	{
+		case 0x00 ... 0x02: // LSL/LSR/ASR Rd, Rs, #imm5
+		{
+			uint op = opcode >> 11, shift = (opcode >> 6) & 0x1F;
+			if(!shift && op)
+				return 0; // LSR/ASR #32
+			e.movEaxMem(regOffset(rs));
+			if(shift)
+			{
+				static const uint ext[] { 4, 5, 7 }; // shl, shr, sar
+				e.shiftEaxImm(ext[op], shift);
+				e.setccMem(CC_C, ofs.cFlag);
+			}
+			emitSetNZ(e, rd);
+			return 1;
+		}
+		case 0x03: // ADD/SUB Rd, Rs, Rn/#imm3
+		{
+			bool sub = opcode & 0x200;
+			uint rn = (opcode >> 6) & 7;
+			e.movEaxMem(regOffset(rs));
+			if(opcode & 0x400)
+				e.aluEaxImm(sub ? 0x2D : 0x05, rn);
+			else
+				e.aluEaxMem(sub ? 0x2B : 0x03, regOffset(rn));
+			if(sub)
+				emitSubFlags(e);
+			else
+				emitAddFlags(e);
+			emitSetNZ(e, rd);
+			return 1;
+		}
+		case 0x04 ... 0x07: // MOV/CMP/ADD/SUB Rd, #imm8
+		{
+			uint op = (opcode >> 11) & 3, imm = opcode & 0xFF;
+			rd = (opcode >> 8) & 7;
+			if(op == 0)
+			{
+				e.movEaxImm(imm);
+				emitSetNZ(e, rd);
+				return 1;
+			}
+			e.movEaxMem(regOffset(rd));
+			e.aluEaxImm(op == 2 ? 0x05 : 0x2D, imm);
+			if(op == 2)
+				emitAddFlags(e);
+			else
+				emitSubFlags(e);
+			emitSetNZ(e, op == 1 ? 8 : rd);
+			return 1;
+		}
+		case 0x08: // ALU Rd, Rs
+		{
+			switch((opcode >> 6) & 0x1F)
+			{
+				case 0x00: // AND
+				case 0x01: // EOR
+				case 0x08: // TST
+				case 0x0C: // ORR
+				{
+					static const u8 aluOp[] { 0x23, 0x33 };
+					uint op = (opcode >> 6) & 0xF;
+					e.movEaxMem(regOffset(rd));
+					e.aluEaxMem(op == 0x0C ? 0x0B : aluOp[op & 1], regOffset(rs));
+					emitSetNZ(e, op == 0x08 ? 8 : rd);
+					return 1;
+				}
+				case 0x09: // NEG
+					e.xorEaxEax();
+					e.aluEaxMem(0x2B, regOffset(rs));
+					emitSubFlags(e);
+					emitSetNZ(e, rd);
+					return 1;
+				case 0x0A: // CMP
+				case 0x0B: // CMN
+				{
+					bool cmn = opcode & 0x40;
+					e.movEaxMem(regOffset(rd));
+					e.aluEaxMem(cmn ? 0x03 : 0x2B, regOffset(rs));
+					if(cmn)
+						emitAddFlags(e);
+					else
+						emitSubFlags(e);
+					emitSetNZ(e, 8);
+					return 1;
+				}
+				case 0x0E: // BIC
+					e.movEaxMem(regOffset(rs));
+					e.notEax();
+					e.aluEaxMem(0x23, regOffset(rd));
+					emitSetNZ(e, rd);
+					return 1;
+				case 0x0F: // MVN
+					e.movEaxMem(regOffset(rs));
+					e.notEax();
+					emitSetNZ(e, rd);
+					return 1;
+			}
+			return 0;
+		}
+	}
+	return 0;
+}
+
+// ARM data processing with an immediate or immediate shifted register operand,
+// not involving R15 as destination and with flags computed the same way as the handler
+static bool isArmNative(u32 opcode)
+{
+	if((opcode & 0x0C000000) || (!(opcode & 0x02000000) && (opcode & 0x10)))
+		return 0; // not data processing, or register shifted by register, multiply, SWP and so on
+	uint op = (opcode >> 21) & 0xF;
+	bool setFlags = opcode & 0x00100000;
+	if(((opcode >> 12) & 15) == 15 || (op >= 0x8 && op <= 0xB && !setFlags))
+		return 0; // PC writes, MRS/MSR/BX
+	if((op >= 0x5 && op <= 0x7) || (op == 0x3 && setFlags))
+		return 0; // ADC/SBC/RSC, and RSBS since the handler computes its flags with SUB's operand order
+	if(!(opcode & 0x02000000) && !((opcode >> 7) & 0x1F) && (opcode & 0x60))
+		return 0; // LSR/ASR #32, RRX
+	return 1;
+}
+
+// native code for an instruction passing isArmNative(), results and flags go straight to the CPU
+static void emitArmNative(X64Emitter &e, u32 opcode, u32 pc)
+{
+	// and, xor, sub, add, or with eax, ecx operands
+	static const u8 aluOp[16] { 0x21, 0x31, 0x29, 0x29, 0x01, 0, 0, 0, 0x21, 0x31, 0x29, 0x01, 0x09, 0, 0x21, 0 };
+	uint op = (opcode >> 21) & 0xF, rd = (opcode >> 12) & 15, rn = (opcode >> 16) & 15;
+	bool setFlags = opcode & 0x00100000;
+	bool arithmetic = (op >= 0x2 && op <= 0x4) || op == 0xA || op == 0xB;
+	// the second operand into ecx, R15 reads as the instruction's address + 8
+	if(opcode & 0x02000000)
+	{
+		uint shift = (opcode >> 7) & 0x1E;
+		u32 imm = opcode & 0xFF;
+		u32 value = shift ? (imm >> shift) | (imm << (32 - shift)) : imm;
+		e.movEcxImm(value);
+		if(shift && setFlags && !arithmetic)
+			e.movMemImm8(ofs.cFlag, value >> 31);
+	}
+	else
+	{
+		uint rm = opcode & 15, type = (opcode >> 5) & 3, shift = (opcode >> 7) & 0x1F;
+		if(rm == 15)
+			e.movEcxImm(pc + 8);
+		else
+			e.movEcxMem(regOffset(rm));
+		if(shift)
+		{
+			static const uint ext[] { 4, 5, 7, 1 }; // shl, shr, sar, ror
+			e.shiftEcxImm(ext[type], shift);
+			if(setFlags && !arithmetic)
+				e.setccMem(CC_C, ofs.cFlag);
+		}
+	}
+	if(op == 0x3 || op == 0xD || op == 0xF) // RSB, MOV, MVN
+	{
+		e.movEaxEcx();
+		if(op == 0xF)
+			e.notEax();
+		else if(op == 0x3)
+		{
+			if(rn == 15)
+				e.aluEaxImm(0x2D, pc + 8);
+			else
+				e.aluEaxMem(0x2B, regOffset(rn));
+		}
+	}
+	else
+	{
+		if(rn == 15)
+			e.movEaxImm(pc + 8);
+		else
+			e.movEaxMem(regOffset(rn));
+		if(op == 0xE) // BIC
+			e.notEcx();
+		e.aluEaxEcx(aluOp[op]);
+	}
+	if(setFlags)
+	{
+		if(op == 0x4 || op == 0xB) // ADD, CMN
+			emitAddFlags(e);
+		else if(arithmetic)
+			emitSubFlags(e);
+		e.movMemEax(ofs.lastArithmeticRes);
+	}
+	if(op < 0x8 || op > 0xB)
+		e.movMemEax(regOffset(rd));
+}
+
+// instructions that always leave the block
+static bool thumbEndsBlock(u32 opcode)
+{
+	return (opcode & 0xF800) == 0xE000 // B
+		|| (opcode & 0xF800) == 0xF800 // BL suffix
+		|| (opcode & 0xFF00) == 0x4700 // BX
+		|| (opcode & 0xFF87) == 0x4487 || (opcode & 0xFF87) == 0x4687 // ADD/MOV PC, Rs
+		|| (opcode & 0xFF00) == 0xBD00 // POP {..., PC}
+		|| (opcode & 0xFF00) == 0xDE00 || (opcode & 0xFF00) == 0xDF00 // undefined, SWI
+		|| (opcode & 0xF800) == 0xE800; // undefined
+}
+
+static bool armEndsBlock(u32 opcode)
+{
+	if((opcode >> 28) != 0xE)
+		return 0; // conditional, the block continues on the not taken path
+	return (opcode & 0x0E000000) == 0x0A000000 // B, BL
+		|| (opcode & 0x0FFFFFF0) == 0x012FFF10 // BX
+		|| (opcode & 0x0F000000) == 0x0F000000 // SWI
+		|| ((opcode & 0x0C000000) == 0x00000000 && (opcode & 0xF000) == 0xF000) // data processing/MSR to PC
+		|| ((opcode & 0x0C100000) == 0x04100000 && (opcode & 0xF000) == 0xF000) // LDR PC
+		|| ((opcode & 0x0E108000) == 0x08108000) // LDM with PC
+		|| (opcode & 0x0E000010) == 0x06000010 // undefined
+		|| (opcode & 0x0C000000) == 0x0C000000; // coprocessor
+}
+
+static void emitThumbBlock(X64Emitter &e, ARM7TDMI &cpu, JitBlock *block, const u8 *exit)
+{
+	struct Stub { u8 *rel32; FetchState state; } stubs[maxBlockInsns];
+	uint usedStubs = 0;
+	u32 pc = block->pc;
+	iterateTimes(maxBlockInsns, i)
+	{
+		block[i] = { e.p, pc, { CPUReadHalfWordQuick(cpu, pc), CPUReadHalfWordQuick(cpu, pc + 2) }, 0, 1 };
+		block->entries = i + 1;
+		u32 opcode = CPUReadHalfWordQuick(cpu, pc);
+		FetchState state { { CPUReadHalfWordQuick(cpu, pc + 2), CPUReadHalfWordQuick(cpu, pc + 4) }, pc + 2, pc + 4 };
+		bool last = i == maxBlockInsns - 1 || thumbEndsBlock(opcode);
+		if(!last && emitThumbNative(e, opcode))
+		{
+			emitThumbSeqTicks(e, pc);
+			// the fetch state is only written when leaving the block
+			e.movEaxMem(ofs.totalTicks);
+			e.cmpEaxMem(ofs.nextEvent);
+			stubs[usedStubs] = { e.jumpForward(CC_GE), state };
+			usedStubs++;
+		}
+		else
+		{
+			emitFetchState(e, state);
+			e.movRdiRbx();
+			e.movEsiImm(opcode);
+			e.movEdxImm(pc);
+			e.call(thumbInsnFunc(opcode));
+			e.addMemEax(ofs.totalTicks);
+			if(last)
+			{
+				e.jump(JMP, exit);
+				break;
+			}
+			emitHandlerChecks(e, exit, pc + 2, 0);
+		}
+		pc += 2;
+	}
+	iterateTimes(usedStubs, i)
+	{
+		e.bind32(stubs[i].rel32);
+		emitFetchState(e, stubs[i].state);
+		e.jump(JMP, exit);
+	}
+	// the block depends on its code and the 2 halfwords prefetched after it
+	if((block->pc >> 24) <= 0x03)
+	{
+		for(u32 addr = block->pc; addr != pc + 6; addr += 2)
+			addRamPageLink(addr, block);
+	}
+}
+
+static void emitArmBlock(X64Emitter &e, ARM7TDMI &cpu, JitBlock *block, const u8 *exit)
+{
+	struct Stub { u8 *rel32; FetchState state; } stubs[maxBlockInsns];
+	uint usedStubs = 0;
+	u32 pc = block->pc;
+	iterateTimes(maxBlockInsns, i)
+	{
+		block[i] = { e.p, pc, { CPUReadMemoryQuick(cpu, pc), CPUReadMemoryQuick(cpu, pc + 4) }, 0, 0 };
+		block->entries = i + 1;
+		u32 opcode = CPUReadMemoryQuick(cpu, pc);
+		FetchState state { { CPUReadMemoryQuick(cpu, pc + 4), CPUReadMemoryQuick(cpu, pc + 8) }, pc + 4, pc + 8 };
+		bool last = i == maxBlockInsns - 1 || armEndsBlock(opcode);
+		if((pc & 0x0803FFFF) == 0x08020000)
+			e.movMemImm32(ofs.busPrefetchCount, 0x100);
+		u8 *skips[2];
+		if(!last && isArmNative(opcode))
+		{
+			emitArmBusPrefetchFix(e);
+			uint conditionJumps = emitArmCondition(e, opcode >> 28, skips);
+			emitArmNative(e, opcode, pc);
+			emitArmSeqTicks(e, pc + 4);
+			if(conditionJumps)
+			{
+				// not executed, ticks as for clockTicks == 0
+				auto done = e.jumpShort(JMP);
+				iterateTimes(conditionJumps, j)
+				{
+					e.bind32(skips[j]);
+				}
+				emitArmSeqTicks(e, pc);
+				e.bind(done);
+			}
+			e.addMemEax(ofs.totalTicks);
+			// the fetch state is only written when leaving the block
+			e.movEaxMem(ofs.totalTicks);
+			e.cmpEaxMem(ofs.nextEvent);
+			stubs[usedStubs] = { e.jumpForward(CC_GE), state };
+			usedStubs++;
+			pc += 4;
+			continue;
+		}
+		emitFetchState(e, state);
+		emitArmBusPrefetchFix(e);
+		e.movStackImm(0);
+		uint conditionJumps = emitArmCondition(e, opcode >> 28, skips);
+		e.movRdiRbx();
+		e.movEsiImm(opcode);
+		e.movRdxRsp();
+		e.call(armInsnFunc(opcode));
+		iterateTimes(conditionJumps, j)
+		{
+			e.bind32(skips[j]);
+		}
+		// clockTicks == 0 means 1 + codeTicksAccessSeq32(cpu, pc)
+		e.movEaxStack();
+		e.testEaxEax();
+		auto haveTicks = e.jumpShort(CC_NZ);
+		emitArmSeqTicks(e, pc);
+		e.bind(haveTicks);
+		e.addMemEax(ofs.totalTicks);
+		if(last)
+		{
+			e.jump(JMP, exit);
+			break;
+		}
+		emitHandlerChecks(e, exit, pc + 4, 1);
+		// the next fetch is from R15, which some instructions (writeback, MUL) can set
+		// without branching
+		e.cmpMemImm32(regOffset(15), pc + 8);
+		e.jump(CC_NZ, exit);
+		pc += 4;
+	}
+	iterateTimes(usedStubs, i)
+	{
+		e.bind32(stubs[i].rel32);
+		emitFetchState(e, stubs[i].state);
+		e.jump(JMP, exit);
+	}
+	if((block->pc >> 24) <= 0x03)
+	{
+		for(u32 addr = block->pc; addr != pc + 12; addr += 4)
+			addRamPageLink(addr, block);
+	}
+}
+
+static JitBlock *compileBlock(ARM7TDMI &cpu, u32 pc, bool thumb)
+{
+	if(codePos + maxBlockBytes > codeBuffer + codeBufferSize || usedBlocks + maxBlockInsns > maxBlocks
+		|| usedPageLinks + 3 > maxPageLinks)
+	{
+		logMsg("JIT cache full, flushing");
+		jitFlush();
+	}
+	setOffsets(cpu);
+	auto block = &blocks[usedBlocks];
+	block->pc = pc;
+	X64Emitter e(codePos);
+	if(thumb)
+		emitThumbBlock(e, cpu, block, codeBuffer + exitOffset);
+	else
+		emitArmBlock(e, cpu, block, codeBuffer + exitOffset);
+	codePos = (u8*)(((uintptr_t)e.p + 15) & ~(uintptr_t)15);
+	usedBlocks += block->entries;
+	iterateTimes(block->entries, i)
+	{
+		if(auto entry = lookupEntry(block[i].pc))
+			*entry = &block[i];
+	}
+	return block;
+}
+
+int jitExecute(ARM7TDMI &cpu)
+{
+	if(!codeBuffer && !initFailed && !cheatsEnabled)
+		initFailed = !init();
+	if(!codeBuffer || cheatsEnabled)
+	{
+		// cheats may patch memory behind the write checks
+		flushPending = 1;
+		return cpu.armState ? armExecute(cpu) : thumbExecute(cpu);
+	}
+	if(flushPending)
+	{
+		jitFlush();
+		flushPending = 0;
+	}
+	bool armState = cpu.armState;
+	auto prefetch = cpu.prefetchBuffer();
+	do
+	{
+		u32 pc = cpu.armNextPC;
+		if(!isTranslated(pc))
+		{
+			armState ? armStep(cpu) : thumbStep(cpu);
+			continue;
+		}
+		auto entry = lookupEntry(pc);
+		if(!entry)
+		{
+			// no memory for the lookup page, interpret instead
+			armState ? armStep(cpu) : thumbStep(cpu);
+			continue;
+		}
+		auto block = *entry;
+		if(!block || block->thumb == armState)
+			block = compileBlock(cpu, pc, !armState);
+		if(block->prefetch[0] != prefetch[0] || block->prefetch[1] != prefetch[1]
+			|| cpu.reg[15].I != pc + (armState ? 4 : 2))
+		{
+			// pipeline holds code that has changed since, or R15 was written
+			armState ? armStep(cpu) : thumbStep(cpu);
+			continue;
+		}
+		exitFlag() = 0;
+		enter(cpu, block->code);
+	} while(cpu.cpuTotalTicks < cpu.cpuNextEvent && cpu.armState == armState);
+	return 1;
+}
+
+#endif
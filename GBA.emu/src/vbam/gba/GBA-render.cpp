@@ -0,0 +1,229 @@
+#include <string.h>
+#include <unistd.h>
+#include "GBA.h"
+#include "Globals.h"
+#include "GBAGfx.h"
+#include <logger/interface.h>
+#include <util/thread/pthread.hh>
+#include <trace/Trace.hh>
+
+// Renders the lines of a frame on a second thread while the CPU runs the next ones.
+// A queued line keeps a copy of the LCD registers and the display settings the CPU
+// picked for it, and the thread draws from its own GBALCD with a copy of VRAM,
+// palette and OAM, so the CPU can keep writing them. Palette and OAM written since
+// the last line ride along with the next one. Written VRAM blocks are copied over
+// before the next line is queued, which first waits for the lines already queued,
+// so games that update VRAM every line render in step with the CPU. The frame's
+// lines are all rendered before it's drawn.
+
+bool gfxThreadedRender = true;
+
+static const uint lcdRegsSize = 0x56; // DISPCNT to COLY
+static const uint queueSize = 160;
+
+struct QueuedLine
+{
+	GBAMem::IoMem ioMem; // only the LCD registers are set
+	GBALCD::RenderLineFunc renderLine;
+	MixColorType *lineMix;
+	uint layerEnable;
+	uint clearedLayers;
+	int gfxBG2Changed;
+	int gfxBG3Changed;
+	bool paletteChanged, oamChanged;
+	u8 paletteRAM[0x400];
+	u8 oam[0x400];
+};
+
+static GBALCD renderLcd;
+static QueuedLine queue[queueSize];
+static uint queued, rendered; // line counts, a line's entry is its count % queueSize
+static int lastWin0H = -1, lastWin1H = -1; // window registers of renderLcd's masks
+static ThreadPThread thread;
+static MutexPThread mutex;
+static CondVarPThread lineCond, idleCond;
+static bool threadStarted, threadFailed;
+
+static void renderQueuedLine(const QueuedLine &line)
+{
+	if(line.paletteChanged)
+		memcpy(renderLcd.paletteRAM, line.paletteRAM, sizeof(renderLcd.paletteRAM));
+	if(line.oamChanged)
+		memcpy(renderLcd.oam, line.oam, sizeof(renderLcd.oam));
+	gfxClearLayers(renderLcd, line.clearedLayers);
+	renderLcd.layerEnable = line.layerEnable;
+	if(line.ioMem.WIN0H != lastWin0H)
+	{
+		gfxUpdateWindow(renderLcd.gfxInWin0, line.ioMem.WIN0H);
+		lastWin0H = line.ioMem.WIN0H;
+	}
+	if(line.ioMem.WIN1H != lastWin1H)
+	{
+		gfxUpdateWindow(renderLcd.gfxInWin1, line.ioMem.WIN1H);
+		lastWin1H = line.ioMem.WIN1H;
+	}
+	renderLcd.gfxBG2Changed |= line.gfxBG2Changed;
+	renderLcd.gfxBG3Changed |= line.gfxBG3Changed;
+	line.renderLine(line.lineMix, renderLcd, line.ioMem);
+}
+
+static ptrsize runRenderThread(ThreadPThread &thread)
+{
+	Trace::setThreadName("gba render");
+	mutex.lock();
+	for(;;)
+	{
+		while(rendered == queued)
+			lineCond.wait();
+		auto &line = queue[rendered % queueSize];
+		mutex.unlock();
+		renderQueuedLine(line);
+		mutex.lock();
+		if(++rendered == queued)
+			idleCond.signal();
+	}
+	return 0;
+}
+
+static bool startThread()
+{
+	if(threadStarted)
+		return 1;
+	if(threadFailed)
+		return 0;
+	if(sysconf(_SC_NPROCESSORS_ONLN) < 2)
+	{
+		logMsg("single core, rendering on the emulation thread");
+		threadFailed = 1;
+		return 0;
+	}
+	mutex.create();
+	lineCond.create(&mutex);
+	idleCond.create(&mutex);
+	if(!thread.create(1, ThreadPThread::EntryDelegate::create<&runRenderThread>()))
+	{
+		logErr("error creating render thread");
+		threadFailed = 1;
+		return 0;
+	}
+	threadStarted = 1;
+	return 1;
+}
+
+// called with the mutex locked and the thread idle
+static void copyVram(GBALCD &lcd)
+{
+	static const uint blockSize = 1 << GBALCD::VRAM_DIRTY_SHIFT;
+	iterateTimes(sizeofArray(lcd.vramDirty), i)
+	{
+		for(u32 bits = lcd.vramDirty[i]; bits; bits &= bits - 1)
+		{
+			uint offset = (i * 32 + __builtin_ctz(bits)) * blockSize;
+			memcpy(&renderLcd.vram[offset], &lcd.vram[offset], blockSize);
+		}
+		lcd.vramDirty[i] = 0;
+	}
+}
+
+static bool anyVramDirty(const GBALCD &lcd)
+{
+	for(auto bits : lcd.vramDirty)
+	{
+		if(bits)
+			return 1;
+	}
+	return 0;
+}
+
+// moves the state the mode functions carry from line to line between the GBALCDs
+static void moveLineState(GBALCD &from, GBALCD &to)
+{
+	to.gfxBG2X = from.gfxBG2X;
+	to.gfxBG2Y = from.gfxBG2Y;
+	to.gfxBG3X = from.gfxBG3X;
+	to.gfxBG3Y = from.gfxBG3Y;
+	to.gfxLastVCOUNT = from.gfxLastVCOUNT;
+	to.gfxBG2Changed |= from.gfxBG2Changed;
+	to.gfxBG3Changed |= from.gfxBG3Changed;
+	from.gfxBG2Changed = from.gfxBG3Changed = 0;
+}
+
+bool gfxBeginFrame(GBALCD &lcd)
+{
+	bool threaded = gfxThreadedRender && startThread();
+	if(threaded != lcd.renderThreaded)
+	{
+		gfxFinishLines();
+		if(threaded)
+		{
+			logMsg("rendering on separate thread");
+			moveLineState(lcd, renderLcd);
+			memcpy(renderLcd.line0, lcd.line0, sizeof(lcd.line0));
+			memcpy(renderLcd.line1, lcd.line1, sizeof(lcd.line1));
+			memcpy(renderLcd.line2, lcd.line2, sizeof(lcd.line2));
+			memcpy(renderLcd.line3, lcd.line3, sizeof(lcd.line3));
+			lcd.clearedLayers = 0;
+			lastWin0H = lastWin1H = -1;
+			// VRAM written through the memory pages wasn't tracked
+			lcd.markAllDirty();
+		}
+		else
+		{
+			logMsg("rendering on emulation thread");
+			moveLineState(renderLcd, lcd);
+			memcpy(lcd.line0, renderLcd.line0, sizeof(lcd.line0));
+			memcpy(lcd.line1, renderLcd.line1, sizeof(lcd.line1));
+			memcpy(lcd.line2, renderLcd.line2, sizeof(lcd.line2));
+			memcpy(lcd.line3, renderLcd.line3, sizeof(lcd.line3));
+		}
+		lcd.renderThreaded = threaded;
+	}
+	return threaded;
+}
+
+void gfxQueueLine(GBALCD &lcd, const GBAMem::IoMem &ioMem)
+{
+	mutex.lock();
+	if(anyVramDirty(lcd) || queued - rendered == queueSize)
+	{
+		while(rendered != queued)
+			idleCond.wait();
+		copyVram(lcd);
+	}
+
+	auto &line = queue[queued % queueSize];
+	memcpy(line.ioMem.b, ioMem.b, lcdRegsSize);
+	line.renderLine = lcd.renderLine;
+	line.lineMix = lcd.lineMix;
+	line.layerEnable = lcd.layerEnable;
+	line.clearedLayers = lcd.clearedLayers;
+	lcd.clearedLayers = 0;
+	line.gfxBG2Changed = lcd.gfxBG2Changed;
+	line.gfxBG3Changed = lcd.gfxBG3Changed;
+	lcd.gfxBG2Changed = lcd.gfxBG3Changed = 0;
+	line.paletteChanged = lcd.paletteDirty;
+	if(lcd.paletteDirty)
+	{
+		memcpy(line.paletteRAM, lcd.paletteRAM, sizeof(lcd.paletteRAM));
+		lcd.paletteDirty = false;
+	}
+	line.oamChanged = lcd.oamDirty;
+	if(lcd.oamDirty)
+	{
+		memcpy(line.oam, lcd.oam, sizeof(lcd.oam));
+		lcd.oamDirty = false;
+	}
+	queued++;
+	lineCond.signal();
+	mutex.unlock();
+}
+
+void gfxFinishLines()
+{
+	if(!threadStarted)
+		return;
+	mutex.lock();
+	while(rendered != queued)
+		idleCond.wait();
+	mutex.unlock();
+}
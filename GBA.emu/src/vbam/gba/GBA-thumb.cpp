@@ -1376,6 +1376,7 @@ static INSN_REGPARM int thumbC8(ARM7TDMI &cpu, u32 opcode, u32 oldArmNextPC)
 // B
 static INSN_REGPARM int thumbBInst(ARM7TDMI &cpu, u32 opcode)
 {
+  u32 branchPC = reg[15].I - 4;
   reg[15].I += ((s8)(opcode & 0xFF)) << 1;
   armNextPC = reg[15].I;
   reg[15].I += 2;
@@ -1383,6 +1384,7 @@ static INSN_REGPARM int thumbBInst(ARM7TDMI &cpu, u32 opcode)
   int clockTicks = codeTicksAccessSeq16(cpu, armNextPC) + codeTicksAccessSeq16(cpu, armNextPC) +
       codeTicksAccess16(cpu, armNextPC)+3;
   busPrefetchCount=0;
+  checkIdleLoop(cpu, branchPC, armNextPC, 1);
   return clockTicks;
 }
 
@@ -1543,6 +1545,7 @@ static INSN_REGPARM int thumbDF(ARM7TDMI &cpu, u32 opcode, u32 oldArmNextPC)
 // B offset
 static INSN_REGPARM int thumbE0(ARM7TDMI &cpu, u32 opcode, u32 oldArmNextPC)
 {
+  u32 branchPC = reg[15].I - 4;
   int offset = (opcode & 0x3FF) << 1;
   if(opcode & 0x0400)
     offset |= 0xFFFFF800;
@@ -1553,6 +1556,7 @@ static INSN_REGPARM int thumbE0(ARM7TDMI &cpu, u32 opcode, u32 oldArmNextPC)
   int clockTicks = codeTicksAccessSeq16(cpu, armNextPC) + codeTicksAccessSeq16(cpu, armNextPC) +
       codeTicksAccess16(cpu, armNextPC) + 3;
   busPrefetchCount=0;
+  checkIdleLoop(cpu, branchPC, armNextPC, 1);
   return clockTicks;
 }
 
@@ -1730,37 +1734,42 @@ static const insnfunc_t thumbInsnTable[1024] = {
 
 // Wrapper routine (execution loop) ///////////////////////////////////////
 
-int thumbExecute(ARM7TDMI &cpu)
+static inline ATTRS(always_inline) int thumbExecuteInsn(ARM7TDMI &cpu)
 {
-	//ARM7TDMI cpu = cpuO;
-	int &cpuNextEvent = cpu.cpuNextEvent;
-	int &cpuTotalTicks = cpu.cpuTotalTicks;
-  do {
-	  if( cheatsEnabled ) {
-		  cpuMasterCodeCheck(cpu);
-	  }
+  if( cheatsEnabled ) {
+	  cpuMasterCodeCheck(cpu);
+  }
 
-    //if ((armNextPC & 0x0803FFFF) == 0x08020000)
-    //    busPrefetchCount=0x100;
+  //if ((armNextPC & 0x0803FFFF) == 0x08020000)
+  //    busPrefetchCount=0x100;
 
-    u32 opcode = cpu.prefetchThumbOpcode();
+  u32 opcode = cpu.prefetchThumbOpcode();
 
-    busPrefetch = false;
-    // TODO: check if used
-    /*if (busPrefetchCount & 0xFFFFFF00)
-      busPrefetchCount = 0x100 | (busPrefetchCount & 0xFF);*/
-    u32 oldArmNextPC = armNextPC;
+  busPrefetch = false;
+  // TODO: check if used
+  /*if (busPrefetchCount & 0xFFFFFF00)
+    busPrefetchCount = 0x100 | (busPrefetchCount & 0xFF);*/
+  u32 oldArmNextPC = armNextPC;
 #ifndef FINAL_VERSION
-    if(armNextPC == stop) {
-      armNextPC++;
-    }
+  if(armNextPC == stop) {
+    armNextPC++;
+  }
 #endif
 
-    armNextPC = reg[15].I;
-    reg[15].I += 2;
-    THUMB_PREFETCH_NEXT;
+  armNextPC = reg[15].I;
+  reg[15].I += 2;
+  THUMB_PREFETCH_NEXT;
 
-    int clockTicks = (*thumbInsnTable[opcode>>6])(cpu, opcode, oldArmNextPC);
+  return (*thumbInsnTable[opcode>>6])(cpu, opcode, oldArmNextPC);
+}
+
+int thumbExecute(ARM7TDMI &cpu)
+{
+	//ARM7TDMI cpu = cpuO;
+	int &cpuNextEvent = cpu.cpuNextEvent;
+	int &cpuTotalTicks = cpu.cpuTotalTicks;
+  do {
+    int clockTicks = thumbExecuteInsn(cpu);
 
 		#ifdef BKPT_SUPPORT
     if (clockTicks < 0)
@@ -1781,3 +1790,13 @@ int thumbExecute(ARM7TDMI &cpu)
   //cpuO = cpu;
   return 1;
 }
+
+void thumbStep(ARM7TDMI &cpu)
+{
+  cpu.cpuTotalTicks += thumbExecuteInsn(cpu);
+}
+
+ThumbInsnFunc thumbInsnFunc(u32 opcode)
+{
+  return thumbInsnTable[(opcode & 0xFFFF)>>6];
+}
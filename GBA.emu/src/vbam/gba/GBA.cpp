@@ -23,6 +23,8 @@
 #include "GBALink.h"
 #include <logger/interface.h>
 #include <io/sys.hh>
+#include <MappedRom.hh>
+#include <RomCache.hh>
 
 #ifdef PROFILING
 #include "prof/prof.h"
@@ -676,50 +678,19 @@ inline int CPUUpdateTicks(ARM7TDMI &cpu)
 
 static void CPUUpdateWindow0(GBASys &gba)
 {
-  int x00 = gba.mem.ioMem.WIN0H>>8;
-  int x01 = gba.mem.ioMem.WIN0H & 255;
-
-  if(x00 <= x01) {
-    for(int i = 0; i < 240; i++) {
-      gba.lcd.gfxInWin0[i] = (i >= x00 && i < x01);
-    }
-  } else {
-    for(int i = 0; i < 240; i++) {
-    	gba.lcd.gfxInWin0[i] = (i >= x00 || i < x01);
-    }
-  }
+  gfxUpdateWindow(gba.lcd.gfxInWin0, gba.mem.ioMem.WIN0H);
 }
 
 static void CPUUpdateWindow1(GBASys &gba)
 {
-  int x00 = gba.mem.ioMem.WIN1H>>8;
-  int x01 = gba.mem.ioMem.WIN1H & 255;
-
-  if(x00 <= x01) {
-    for(int i = 0; i < 240; i++) {
-    	gba.lcd.gfxInWin1[i] = (i >= x00 && i < x01);
-    }
-  } else {
-    for(int i = 0; i < 240; i++) {
-    	gba.lcd.gfxInWin1[i] = (i >= x00 || i < x01);
-    }
-  }
+  gfxUpdateWindow(gba.lcd.gfxInWin1, gba.mem.ioMem.WIN1H);
 }
 
 static void CPUUpdateRenderBuffers(GBASys &gba, bool force)
 {
-  if(!(gba.lcd.layerEnable & 0x0100) || force) {
-    gfxClearArray(gba.lcd.line0);
-  }
-  if(!(gba.lcd.layerEnable & 0x0200) || force) {
-  	gfxClearArray(gba.lcd.line1);
-  }
-  if(!(gba.lcd.layerEnable & 0x0400) || force) {
-  	gfxClearArray(gba.lcd.line2);
-  }
-  if(!(gba.lcd.layerEnable & 0x0800) || force) {
-  	gfxClearArray(gba.lcd.line3);
-  }
+  uint layers = force ? 0xF : (~gba.lcd.layerEnable >> 8) & 0xF;
+  gfxClearLayers(gba.lcd, layers);
+  gba.lcd.clearedLayers |= layers;
 }
 
 static bool CPUWriteState(GBASys &gba, gzFile gzFile)
@@ -803,6 +774,20 @@ bool CPUWriteMemState(GBASys &gba, char *memory, int available)
   return res;
 }
 
+int CPUWriteRawMemState(GBASys &gba, char *memory, int available)
+{
+  gzFile gzFile = utilMemRawOpen(memory, available);
+
+  bool res = CPUWriteState(gba, gzFile);
+
+  long pos = utilMemRawTell(gzFile);
+
+  if(utilGzClose(gzFile) != 0)
+    res = false;
+
+  return res ? pos : 0;
+}
+
 static bool CPUReadState(GBASys &gba, gzFile gzFile)
 {
   int version = utilReadInt(gzFile);
@@ -873,11 +858,16 @@ static bool CPUReadState(GBASys &gba, gzFile gzFile)
 #endif
   }
 
-  utilGzRead(gzFile, gba.mem.internalRAM, 0x8000);
+  // keep translated code from pages the state doesn't change
+  static u8 ramBuffer[0x40000];
+  utilGzRead(gzFile, ramBuffer, 0x8000);
+  jitLoadRAM(gba.mem.internalRAM, ramBuffer, 0x03000000, 0x8000);
   utilGzRead(gzFile, gba.lcd.paletteRAM, 0x400);
-  utilGzRead(gzFile, gba.mem.workRAM, 0x40000);
+  utilGzRead(gzFile, ramBuffer, 0x40000);
+  jitLoadRAM(gba.mem.workRAM, ramBuffer, 0x02000000, 0x40000);
   utilGzRead(gzFile, gba.lcd.vram, 0x20000);
   utilGzRead(gzFile, gba.lcd.oam, 0x400);
+  gba.lcd.markAllDirty(); // read around the render thread's write tracking
   u32 dummyPix[241*162];
   if(version < SAVE_GAME_VERSION_6)
     utilGzRead(gzFile, dummyPix, 4*240*160);
@@ -995,6 +985,18 @@ bool CPUReadMemState(GBASys &gba, char *memory, int available)
   return res;
 }
 
+bool CPUReadRawMemState(GBASys &gba, const char *memory, int size)
+{
+  gzFile gzFile = utilMemRawOpen((char*)memory, size);
+
+  bool res = CPUReadState(gba, gzFile);
+
+  if(utilGzClose(gzFile) != 0)
+    res = false;
+
+  return res;
+}
+
 bool CPUReadState(GBASys &gba, const char * file)
 {
   gzFile gzFile = utilGzOpen(file, "rb");
@@ -1430,6 +1432,8 @@ bool CPUIsELF(const char *file)
   return false;
 }
 
+static MappedRom romMapping;
+
 void CPUCleanUp()
 {
 #ifdef PROFILING
@@ -1442,6 +1446,8 @@ void CPUCleanUp()
   elfCleanUp();
 #endif //NO_DEBUGGER
 
+  romMapping.close();
+
   systemSaveUpdateCounter = SYSTEM_SAVE_NOT_UPDATED;
 }
 
@@ -1455,6 +1461,7 @@ int CPULoadRom(GBASys &gba, const char *szFile)
   systemSaveUpdateCounter = SYSTEM_SAVE_NOT_UPDATED;
 
   memset(gba.mem.workRAM, 0, sizeof(gba.mem.workRAM));
+  jitFlush();
 
   u8 *whereToLoad = cpuIsMultiBoot ? gba.mem.workRAM : gba.mem.rom;
 
@@ -1473,13 +1480,36 @@ int CPULoadRom(GBASys &gba, const char *szFile)
     }
   } else
 #endif //NO_DEBUGGER
-  if(szFile!=NULL)
+  if(szFile!=NULL && utilIsGBAImage(szFile) && !cpuIsMultiBoot
+		  && romMapping.openAt(gba.mem.rom, szFile, sizeof(gba.mem.rom)))
   {
-	  if(!utilLoad(szFile,
-						  utilIsGBAImage,
-						  whereToLoad,
-						  romSize)) {
-		return 0;
+	  // pages are read on demand, in-place patches and mirroring stay copy-on-write
+	  romSize = romMapping.size();
+  }
+  else if(szFile!=NULL)
+  {
+	  // one scan of the archive serves both the cache lookup and the load
+	  fex_t *fe = utilOpenImage(szFile, utilIsGBAImage);
+	  if(!fe)
+		  return 0;
+	  u32 crc = 0;
+	  FsSys::cPath cachePath;
+	  bool cacheable = !cpuIsMultiBoot && MappedRom::isArchive(szFile) && utilImageCRC(fe, crc);
+	  if(cacheable && RomCache::lookup(szFile, crc, cachePath)
+		  && romMapping.openAt(gba.mem.rom, cachePath, sizeof(gba.mem.rom)))
+	  {
+		  utilCloseImage(fe);
+		  romSize = romMapping.size();
+	  }
+	  else
+	  {
+		  if(!utilLoadImage(fe,
+							  whereToLoad,
+							  romSize)) {
+			return 0;
+		  }
+		  if(cacheable)
+			  RomCache::store(szFile, crc, gba.mem.rom, romSize);
 	  }
   }
 
@@ -1496,6 +1526,7 @@ int CPULoadRom(GBASys &gba, const char *szFile)
 
   memset(gba.mem.ioMem.b, 0, sizeof(gba.mem.ioMem));
 
+  gfxFinishLines();
   gba.lcd.reset();
 
   flashInit();
@@ -2892,6 +2923,52 @@ void applyTimer(GBASys &gba, ARM7TDMI &cpu)
   timerOnOffDelay = 0;
 }
 
+// Fills the page tables of CPURead*()/CPUWrite*() for memory without side effects:
+// work/internal RAM and their mirrors, VRAM outside the mode dependent 0x18000 block,
+// and ROM except the page with the RTC registers. Byte writes to VRAM and everything
+// else go through the memory switch.
+static void CPUInitMemoryPages(GBASys &gba)
+{
+  static const u8 noCode[1 << (MEM_PAGE_SHIFT - 8)] {0};
+  auto &pages = gba.memPages;
+  for(u32 i = 0; i < MEM_PAGES; i++) {
+    u32 address = i << MEM_PAGE_SHIFT;
+    pages.read[i] = nullptr;
+    pages.write[i] = {};
+    switch(address >> 24) {
+    case 0x02:
+      pages.read[i] = &gba.mem.workRAM[address & 0x3FFFF];
+#ifdef VBAM_USE_JIT
+      pages.write[i] = { pages.read[i], &jitWorkRAMCode[(address & 0x3FFFF) >> JIT_PAGE_SHIFT], 1 | 2 | 4 };
+#else
+      pages.write[i] = { pages.read[i], noCode, 1 | 2 | 4 };
+#endif
+      break;
+    case 0x03:
+      pages.read[i] = &gba.mem.internalRAM[address & 0x7FFF];
+#ifdef VBAM_USE_JIT
+      pages.write[i] = { pages.read[i], &jitInternalRAMCode[(address & 0x7FFF) >> JIT_PAGE_SHIFT], 1 | 2 | 4 };
+#else
+      pages.write[i] = { pages.read[i], noCode, 1 | 2 | 4 };
+#endif
+      break;
+    case 0x06:
+      if((address & 0x1FFFF) < 0x18000) {
+        pages.read[i] = &gba.lcd.vram[address & 0x1FFFF];
+        // byte writes depend on the display mode, the render thread
+        // needs the switch to track written VRAM
+        if(!gba.lcd.renderThreaded)
+          pages.write[i] = { pages.read[i], noCode, 2 | 4 };
+      }
+      break;
+    case 0x08 ... 0x0C:
+      if(address != 0x08000000)
+        pages.read[i] = &gba.mem.rom[address & 0x1FFFFFF];
+      break;
+    }
+  }
+}
+
 void CPUInit(GBASys &gba, const char *biosFileName, bool useBiosFile)
 {
 #ifdef WORDS_BIGENDIAN
@@ -2984,6 +3061,7 @@ void CPUInit(GBASys &gba, const char *biosFileName, bool useBiosFile)
     ioReadable[i] = false;*/
 
   memcpy(gba.cpu.map, gbaMap, sizeof(gbaMap));
+  CPUInitMemoryPages(gba);
 
   if(romSize < 0x1fe2000) {
   	*((uint16a *)&gba.mem.rom[0x1fe209c]) = 0xdffa; // SWI 0xFA
@@ -3011,6 +3089,9 @@ void CPUReset(GBASys &gba)
       }
   }
   rtcReset();
+  jitFlush();
+  idleLoopReset();
+  gfxFinishLines();
   // clean io memory
   memset(gba.mem.ioMem.b, 0, 0x400);
   // clean OAM, palette, picture, & vram
@@ -3182,6 +3263,7 @@ void CPUReset(GBASys &gba)
 
 void CPUInterrupt(GBASys &gba, ARM7TDMI &cpu)
 {
+	idleLoopLastBranch = 0; // the handler may change what the interrupted loop polls
 	cpu.interrupt(gba.mem.ioMem);
 
   //  if(!holdState)
@@ -3251,6 +3333,11 @@ void CPULoop(GBASys &gba, bool renderGfx, bool processGfx, bool renderAudio)
     		&& !SWITicks
 #endif
     		) {
+#ifdef VBAM_USE_JIT
+      if(cpuJitEnabled)
+        jitExecute(cpu);
+      else
+#endif
       if(cpu.armState) {
         if (!armExecute(cpu))
         {
@@ -3276,6 +3363,7 @@ void CPULoop(GBASys &gba, bool renderGfx, bool processGfx, bool renderAudio)
 
     if(cpu.cpuTotalTicks >= cpu.cpuNextEvent) {
       int remainingTicks = cpu.cpuTotalTicks - cpu.cpuNextEvent;
+      idleLoopLastBranch = 0; // events can change what a loop polls, let it run again first
 
 #ifdef VBAM_USE_SWITICKS
       if (SWITicks)
@@ -3400,7 +3488,15 @@ void CPULoop(GBASys &gba, bool renderGfx, bool processGfx, bool renderAudio)
             	{
             	}*/
 
-              (*gba.lcd.renderLine)(gba.lcd.lineMix, gba.lcd, ioMem);
+              if(ioMem.VCOUNT == 0) {
+                bool wasThreaded = gba.lcd.renderThreaded;
+                if(gfxBeginFrame(gba.lcd) != wasThreaded)
+                  CPUInitMemoryPages(gba);
+              }
+              if(gba.lcd.renderThreaded)
+                gfxQueueLine(gba.lcd, ioMem);
+              else
+                (*gba.lcd.renderLine)(gba.lcd.lineMix, gba.lcd, ioMem);
               /*switch(systemColorDepth) {
 				#ifdef SUPPORT_PIX_16BIT
                 case 16:
@@ -3440,6 +3536,8 @@ void CPULoop(GBASys &gba, bool renderGfx, bool processGfx, bool renderAudio)
 				#endif
               }*/
             }
+            if(ioMem.VCOUNT == 159 && gba.lcd.renderThreaded)
+              gfxFinishLines();
             if(ioMem.VCOUNT == 159 && likely(renderGfx))
             {
             	if(likely(processGfx) && !directColorLookup)
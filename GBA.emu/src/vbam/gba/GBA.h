@@ -205,7 +205,8 @@ struct GBAMem
 	IoMem ioMem;
 	u8 internalRAM[0x8000] __attribute__ ((aligned(4))) {0};
 	u8 workRAM[0x40000] __attribute__ ((aligned(4))) {0};
-	u8 rom[0x2000000] __attribute__ ((aligned(4)))
+	// page aligned so uncompressed ROMs can be mapped directly over it
+	u8 rom[0x2000000] __attribute__ ((aligned(16384)))
 #ifndef __clang__
 	{0}
 #endif
@@ -313,6 +314,26 @@ struct GBALCD
 	int layerEnableDelay = 0;
 	int lcdTicks = 0;
 	u16 gfxLastVCOUNT = 0;
+	// lines of this frame go to the render thread, see GBA-render.cpp
+	bool renderThreaded = false;
+	// BG line buffers cleared since the last line was queued, bit per layer
+	uint clearedLayers = 0;
+	// VRAM blocks, palette and OAM written since the render thread's copy was updated
+	static const uint VRAM_DIRTY_SHIFT = 10;
+	u32 vramDirty[(0x20000 >> VRAM_DIRTY_SHIFT) / 32] {0};
+	bool paletteDirty = false;
+	bool oamDirty = false;
+
+	void markVramDirty(u32 address)
+	{
+		vramDirty[address >> (VRAM_DIRTY_SHIFT + 5)] |= 1 << ((address >> VRAM_DIRTY_SHIFT) & 31);
+	}
+
+	void markAllDirty()
+	{
+		memset(vramDirty, 0xFF, sizeof(vramDirty));
+		paletteDirty = oamDirty = true;
+	}
 
 	void registerRamReset(u32 flags)
 	{
@@ -328,6 +349,8 @@ struct GBALCD
       // clean OAM
       memset(oam, 0, 0x400);
     }
+    if(flags & 0x1C)
+      markAllDirty();
 	}
 
 	void reset()
@@ -336,6 +359,7 @@ struct GBALCD
 		memset(vram, 0, sizeof(vram));
 		memset(oam, 0, sizeof(oam));
 		memset(pix, 0, sizeof(pix));
+		markAllDirty();
 	}
 
 	void resetAll(bool useBios, bool skipBios, GBAMem::IoMem &ioMem)
@@ -449,6 +473,25 @@ struct memoryMap {
 #endif
 };
 
+// host memory of a 32KB page that CPURead*()/CPUWrite*() access directly,
+// see CPUInitMemoryPages()
+static const uint MEM_PAGE_SHIFT = 15;
+static const uint MEM_PAGES = 0x0E000000 >> MEM_PAGE_SHIFT;
+struct MemWritePage
+{
+	u8 *mem;
+	const u8 *code; // code page flags of the JIT for this page
+	uint sizes; // access sizes in bytes allowed, or'd together
+};
+
+// plain RAM, VRAM and ROM pages, nullptr/empty where the access needs the memory switch,
+// kept out of ARM7TDMI since CPULoop() works on a copy of it
+struct MemPages
+{
+	u8 *read[MEM_PAGES] {nullptr};
+	MemWritePage write[MEM_PAGES] {};
+};
+
 //#define VBAM_USE_SWITICKS
 //#define VBAM_USE_IRQTICKS
 #define VBAM_USE_CPU_PREFETCH
@@ -458,7 +501,7 @@ struct GBASys;
 
 struct ARM7TDMI
 {
-	constexpr ARM7TDMI(GBASys *gba): gba(gba) { }
+	constexpr ARM7TDMI(GBASys *gba, MemPages *pages): gba(gba), pages(pages) { }
 
 	reg_pair reg[45] {{{0}}};
 	u32 armNextPC = 0;
@@ -509,6 +552,7 @@ public:
 	uint memoryWaitSeq32[16] =
 	  { 0, 0, 5, 0, 0, 1, 1, 0, 5, 5, 9, 9, 17, 17, 4, 0 };
 	memoryMap map[256];
+	MemPages *pages;
 
 	static bool calcNFlag(u32 result)
 	{
@@ -657,6 +701,10 @@ public:
 #endif
 	}
 
+#ifdef VBAM_USE_CPU_PREFETCH
+	u32 *prefetchBuffer() { return cpuPrefetch; }
+#endif
+
 	void softReset(int b)
 	{
 		armState = true;
@@ -962,12 +1010,13 @@ struct GBASys
 #endif
 	bool intState = false;
 	bool stopState = false;
-	ARM7TDMI cpu {this};
+	ARM7TDMI cpu {this, &memPages};
 	u8 biosProtected[4] {0};
 	GBALCD lcd;
 	GBATimers timers;
 	GBADMA dma;
 	GBAMem mem;
+	MemPages memPages;
 };
 
 extern GBASys gGba;
@@ -1027,6 +1076,8 @@ extern bool CPUReadMemState(GBASys &gba, char *, int);
 extern bool CPUReadState(GBASys &gba, const char *);
 extern bool CPUWriteMemState(GBASys &gba, char *, int);
 extern bool CPUWriteState(GBASys &gba, const char *);
+extern int CPUWriteRawMemState(GBASys &gba, char *, int);
+extern bool CPUReadRawMemState(GBASys &gba, const char *, int);
 extern int CPULoadRom(GBASys &gba, const char *);
 extern void doMirroring(GBASys &gba, bool);
 extern void CPUUpdateRegister(ARM7TDMI &cpu, u32, u16);
@@ -84,6 +84,13 @@ void mode5RenderLine(MixColorType *, GBALCD &lcd, const GBAMem::IoMem &ioMem);
 void mode5RenderLineNoWindow(MixColorType *, GBALCD &lcd, const GBAMem::IoMem &ioMem);
 void mode5RenderLineAll(MixColorType *, GBALCD &lcd, const GBAMem::IoMem &ioMem);
 
+// Render thread (GBA-render.cpp), takes the lines of a frame in place of calling lcd.renderLine
+// called before line 0, returns if the frame's lines go to the render thread
+bool gfxBeginFrame(GBALCD &lcd);
+void gfxQueueLine(GBALCD &lcd, const GBAMem::IoMem &ioMem);
+// waits until the queued lines are in lcd.pix
+void gfxFinishLines();
+
 static const int coeff[32] = {
   0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
   16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16};
@@ -115,6 +122,36 @@ static inline void gfxClearArray(u32 *array)
   }
 }
 
+// clears the line buffers of BG layers, bit per layer
+static inline void gfxClearLayers(GBALCD &lcd, uint layers)
+{
+  if(layers & 1)
+    gfxClearArray(lcd.line0);
+  if(layers & 2)
+    gfxClearArray(lcd.line1);
+  if(layers & 4)
+    gfxClearArray(lcd.line2);
+  if(layers & 8)
+    gfxClearArray(lcd.line3);
+}
+
+// pixels inside a window from its WINxH register
+static inline void gfxUpdateWindow(bool *inWin, u16 winH)
+{
+  int x00 = winH>>8;
+  int x01 = winH & 255;
+
+  if(x00 <= x01) {
+    for(int i = 0; i < 240; i++) {
+      inWin[i] = (i >= x00 && i < x01);
+    }
+  } else {
+    for(int i = 0; i < 240; i++) {
+      inWin[i] = (i >= x00 || i < x01);
+    }
+  }
+}
+
 static inline void gfxDrawTextScreen(u8 vram[0x20000], u16 control, u16 hofs, u16 vofs,
 				     u32 *line, const u16 VCOUNT, const u16 MOSAIC, const u16 *palette)
 {
@@ -0,0 +1,50 @@
+#ifndef GBAJIT_H
+#define GBAJIT_H
+
+#include <string.h>
+#include "GBA.h"
+
+// Dynamic recompiler for x86-64 hosts, see GBA-jit.cpp
+#if defined __x86_64__ && !defined _WIN32 && defined VBAM_USE_CPU_PREFETCH && defined VBAM_USE_DELAYED_CPU_FLAGS
+#define VBAM_USE_JIT
+#endif
+
+#ifdef VBAM_USE_JIT
+
+// granularity of code invalidation in work/internal RAM
+static const uint JIT_PAGE_SHIFT = 8;
+
+extern bool cpuJitEnabled;
+extern u8 jitWorkRAMCode[0x40000 >> JIT_PAGE_SHIFT];
+extern u8 jitInternalRAMCode[0x8000 >> JIT_PAGE_SHIFT];
+
+// runs translated code until the next event, in place of armExecute()/thumbExecute()
+int jitExecute(ARM7TDMI &cpu);
+// drops all translations, needed when memory changes without going through CPUWrite*()
+void jitFlush();
+void jitInvalidatePage(u32 address);
+// copies a RAM snapshot into work/internal RAM, only dropping translations of changed pages
+void jitLoadRAM(u8 *dest, const u8 *src, u32 address, u32 size);
+
+static inline void jitCheckWorkRAMWrite(u32 address)
+{
+	if(unlikely(jitWorkRAMCode[(address & 0x3FFFF) >> JIT_PAGE_SHIFT]))
+		jitInvalidatePage(address);
+}
+
+static inline void jitCheckInternalRAMWrite(u32 address)
+{
+	if(unlikely(jitInternalRAMCode[(address & 0x7FFF) >> JIT_PAGE_SHIFT]))
+		jitInvalidatePage(address);
+}
+
+#else
+
+static inline void jitFlush() { }
+static inline void jitLoadRAM(u8 *dest, const u8 *src, u32 address, u32 size) { memcpy(dest, src, size); }
+static inline void jitCheckWorkRAMWrite(u32 address) { }
+static inline void jitCheckInternalRAMWrite(u32 address) { }
+
+#endif
+
+#endif // GBAJIT_H
@@ -4,6 +4,14 @@
 extern int armExecute(ARM7TDMI &cpu) ATTRS(hot);
 extern int thumbExecute(ARM7TDMI &cpu) ATTRS(hot);
 
+// single instructions and handler lookup for the recompiler
+typedef void (*ArmInsnFunc)(ARM7TDMI &cpu, u32 opcode, int &clockTicks);
+typedef int (*ThumbInsnFunc)(ARM7TDMI &cpu, u32 opcode, u32 oldArmNextPC);
+extern void armStep(ARM7TDMI &cpu);
+extern void thumbStep(ARM7TDMI &cpu);
+extern ArmInsnFunc armInsnFunc(u32 opcode);
+extern ThumbInsnFunc thumbInsnFunc(u32 opcode);
+
 #ifdef __GNUC__
 /*#ifndef __APPLE__
 # define INSN_REGPARM //__attribute__((regparm(1)))
@@ -22,6 +30,31 @@ extern int thumbExecute(ARM7TDMI &cpu) ATTRS(hot);
 
 static const bool CONFIG_TRIGGER_ARM_STATE_EVENT = 0;
 
+// idle loop skipping, see GBA-idle.cpp
+static const u32 idleLoopMaxBytes = 32;
+extern u32 idleLoopLastBranch;
+extern void idleLoopBranch(ARM7TDMI &cpu, u32 branchPC, u32 target, bool thumb);
+extern void idleLoopReset();
+
+static inline void idleLoopSkip(ARM7TDMI &cpu)
+{
+  if (cpu.cpuTotalTicks < cpu.cpuNextEvent)
+    cpu.cpuTotalTicks = cpu.cpuNextEvent;
+}
+
+// called by taken branches after setting up the target
+static inline void checkIdleLoop(ARM7TDMI &cpu, u32 branchPC, u32 target, bool thumb)
+{
+  if (UNLIKELY(cpuIdleLoop)) {
+    // known loop from the game settings, or IDLE_LOOP_NONE, of any length
+    if (target == cpuIdleLoop && target <= branchPC && cpuSkipIdleLoops)
+      idleLoopSkip(cpu);
+  } else if (UNLIKELY(branchPC - target <= idleLoopMaxBytes) && cpuSkipIdleLoops)
+    idleLoopBranch(cpu, branchPC, target, thumb);
+  else
+    idleLoopLastBranch = 0; // a loop entered after this hasn't run from its start
+}
+
 #define UPDATE_REG(gba, address, value)\
   {\
     WRITE16LE(((u16 *)&(gba)->mem.ioMem.b[address]),value);\
@@ -7,6 +7,7 @@
 #include "Sound.h"
 #include "agbprint.h"
 #include "GBAcpu.h"
+#include "GBAJit.h"
 #include "GBALink.h"
 
 static const u32  objTilesAddress [3] = {0x010000, 0x014000, 0x014000};
@@ -112,10 +113,39 @@ static inline u32 unreadableRead8(ARM7TDMI &cpu, u32 address)
 	}
 }
 
+// direct access to plain RAM, VRAM and ROM, the switches below handle the rest
+static inline u8 *memReadPage(ARM7TDMI &cpu, u32 address)
+{
+	return address < 0x0E000000 ? cpu.pages->read[address >> MEM_PAGE_SHIFT] : nullptr;
+}
+
+static inline MemWritePage *memWritePage(ARM7TDMI &cpu, u32 address, uint bytes)
+{
+#ifdef BKPT_SUPPORT
+	return nullptr; // freeze checks
+#else
+	if(address >= 0x0E000000)
+		return nullptr;
+	auto page = &cpu.pages->write[address >> MEM_PAGE_SHIFT];
+	return (page->sizes & bytes) ? page : nullptr;
+#endif
+}
+
+static inline void memWritePageDone(MemWritePage *page, u32 address)
+{
+#ifdef VBAM_USE_JIT
+	if(unlikely(page->code[(address & ((1 << MEM_PAGE_SHIFT) - 1)) >> JIT_PAGE_SHIFT]))
+		jitInvalidatePage(address);
+#endif
+}
+
 #ifndef USE_MEM_HANDLERS
 template <bool rot>
 static inline u32 CPUReadMemoryBase(ARM7TDMI &cpu, u32 address)
 {
+	if(u8 *page = memReadPage(cpu, address))
+		return armRotLoad32(READ32LE(((u32 *)&page[address & 0x7FFC])), address, rot);
+
 	bool &armState = cpu.armState;
 	auto &reg = cpu.reg;
 	auto &paletteRAM = cpu.gba->lcd.paletteRAM;
@@ -263,6 +293,8 @@ static inline u32 CPUReadMemoryNoRot(ARM7TDMI &cpu, u32 address)
 template <bool rot>
 static inline u32 CPUReadHalfWordBase(ARM7TDMI &cpu, u32 address)
 {
+	if(u8 *page = memReadPage(cpu, address))
+		return armRotLoad16(READ16LE(((u16 *)&page[address & 0x7FFE])), address, rot);
 	auto &armState = cpu.armState;
 	auto &cpuNextEvent = cpu.cpuNextEvent;
 	auto &cpuTotalTicks = cpu.cpuTotalTicks;
@@ -426,6 +458,8 @@ static inline u16 CPUReadHalfWordSigned(ARM7TDMI &cpu, u32 address)
 
 static inline u8 CPUReadByte(ARM7TDMI &cpu, u32 address)
 {
+	if(u8 *page = memReadPage(cpu, address))
+		return page[address & 0x7FFF];
 	auto &armState = cpu.armState;
 	auto &reg = cpu.reg;
 	auto &paletteRAM = cpu.gba->lcd.paletteRAM;
@@ -576,6 +610,12 @@ static inline u8 CPUReadByte(ARM7TDMI &cpu, u32 address)
 
 static inline void CPUWriteMemory(ARM7TDMI &cpu, u32 address, u32 value)
 {
+	if(auto page = memWritePage(cpu, address, 4))
+	{
+		WRITE32LE(((u32 *)&page->mem[address & 0x7FFC]), value);
+		memWritePageDone(page, address);
+		return;
+	}
 	auto &paletteRAM = cpu.gba->lcd.paletteRAM;
 	auto &vram = cpu.gba->lcd.vram;
 	auto &oam = cpu.gba->lcd.oam;
@@ -599,7 +639,10 @@ static inline void CPUWriteMemory(ARM7TDMI &cpu, u32 address, u32 value)
       value);
     else
 #endif
+    {
       WRITE32LE(((u32 *)&cpu.gba->mem.workRAM[address & 0x3FFFC]), value);
+      jitCheckWorkRAMWrite(address);
+    }
     break;
   case 0x03:
 #ifdef BKPT_SUPPORT
@@ -608,7 +651,10 @@ static inline void CPUWriteMemory(ARM7TDMI &cpu, u32 address, u32 value)
       value);
     else
 #endif
+    {
       WRITE32LE(((u32 *)&cpu.gba->mem.internalRAM[address & 0x7ffC]), value);
+      jitCheckInternalRAMWrite(address);
+    }
     break;
   case 0x04:
     if(address < 0x4000400) {
@@ -624,6 +670,7 @@ static inline void CPUWriteMemory(ARM7TDMI &cpu, u32 address, u32 value)
     else
 #endif
       WRITE32LE(((u32 *)&paletteRAM[address & 0x3FC]), value);
+    cpu.gba->lcd.paletteDirty = true;
     break;
   case 0x06:
     address = (address & 0x1fffc);
@@ -639,6 +686,7 @@ static inline void CPUWriteMemory(ARM7TDMI &cpu, u32 address, u32 value)
 #endif
 
       WRITE32LE(((u32 *)&vram[address]), value);
+    cpu.gba->lcd.markVramDirty(address);
     break;
   case 0x07:
 #ifdef BKPT_SUPPORT
@@ -648,7 +696,7 @@ static inline void CPUWriteMemory(ARM7TDMI &cpu, u32 address, u32 value)
     else
 #endif
       WRITE32LE(((u32 *)&oam[address & 0x3fc]), value);
-      //oamUpdated = 1;
+    cpu.gba->lcd.oamDirty = true;
     break;
   case 0x0D:
     if(cpuEEPROMEnabled) {
@@ -678,6 +726,12 @@ unwritable:
 
 static inline void CPUWriteHalfWord(ARM7TDMI &cpu, u32 address, u16 value)
 {
+	if(auto page = memWritePage(cpu, address, 2))
+	{
+		WRITE16LE(((u16 *)&page->mem[address & 0x7FFE]), value);
+		memWritePageDone(page, address);
+		return;
+	}
 	auto &paletteRAM = cpu.gba->lcd.paletteRAM;
 	auto &vram = cpu.gba->lcd.vram;
 	auto &oam = cpu.gba->lcd.oam;
@@ -700,7 +754,10 @@ static inline void CPUWriteHalfWord(ARM7TDMI &cpu, u32 address, u16 value)
       value);
     else
 #endif
+    {
       WRITE16LE(((u16 *)&cpu.gba->mem.workRAM[address & 0x3FFFE]),value);
+      jitCheckWorkRAMWrite(address);
+    }
     break;
   case 3:
 #ifdef BKPT_SUPPORT
@@ -709,7 +766,10 @@ static inline void CPUWriteHalfWord(ARM7TDMI &cpu, u32 address, u16 value)
       value);
     else
 #endif
+    {
       WRITE16LE(((u16 *)&cpu.gba->mem.internalRAM[address & 0x7ffe]), value);
+      jitCheckInternalRAMWrite(address);
+    }
     break;
   case 4:
     if(address < 0x4000400)
@@ -724,6 +784,7 @@ static inline void CPUWriteHalfWord(ARM7TDMI &cpu, u32 address, u16 value)
     else
 #endif
       WRITE16LE(((u16 *)&paletteRAM[address & 0x3fe]), value);
+    cpu.gba->lcd.paletteDirty = true;
     break;
   case 6:
     address = (address & 0x1fffe);
@@ -738,6 +799,7 @@ static inline void CPUWriteHalfWord(ARM7TDMI &cpu, u32 address, u16 value)
     else
 #endif
       WRITE16LE(((u16 *)&vram[address]), value);
+    cpu.gba->lcd.markVramDirty(address);
     break;
   case 7:
 #ifdef BKPT_SUPPORT
@@ -747,7 +809,7 @@ static inline void CPUWriteHalfWord(ARM7TDMI &cpu, u32 address, u16 value)
     else
 #endif
       WRITE16LE(((u16 *)&oam[address & 0x3fe]), value);
-      //oamUpdated = 1;
+    cpu.gba->lcd.oamDirty = true;
     break;
   case 8:
   case 9:
@@ -788,6 +850,12 @@ unwritable:
 
 static inline void CPUWriteByte(ARM7TDMI &cpu, u32 address, u8 b)
 {
+	if(auto page = memWritePage(cpu, address, 1))
+	{
+		page->mem[address & 0x7FFF] = b;
+		memWritePageDone(page, address);
+		return;
+	}
 	auto &cpuNextEvent = cpu.cpuNextEvent;
 	auto &cpuTotalTicks = cpu.cpuTotalTicks;
 	auto &holdState = cpu.holdState;
@@ -801,7 +869,10 @@ static inline void CPUWriteByte(ARM7TDMI &cpu, u32 address, u8 b)
       cheatsWriteByte(address & 0x203FFFF, b);
     else
 #endif
+    {
     	cpu.gba->mem.workRAM[address & 0x3FFFF] = b;
+    	jitCheckWorkRAMWrite(address);
+    }
     break;
   case 3:
 #ifdef BKPT_SUPPORT
@@ -809,7 +880,10 @@ static inline void CPUWriteByte(ARM7TDMI &cpu, u32 address, u8 b)
       cheatsWriteByte(address & 0x3007fff, b);
     else
 #endif
+    {
     	cpu.gba->mem.internalRAM[address & 0x7fff] = b;
+    	jitCheckInternalRAMWrite(address);
+    }
     break;
   case 4:
     if(address < 0x4000400) {
@@ -879,6 +953,7 @@ static inline void CPUWriteByte(ARM7TDMI &cpu, u32 address, u8 b)
   case 5:
     // no need to switch
   	*((uint16a *)&cpu.gba->lcd.paletteRAM[address & 0x3FE]) = (b << 8) | b;
+    cpu.gba->lcd.paletteDirty = true;
     break;
   case 6:
     address = (address & 0x1fffe);
@@ -897,6 +972,7 @@ static inline void CPUWriteByte(ARM7TDMI &cpu, u32 address, u8 b)
       else
 #endif
       	*((uint16a *)&vram[address]) = (b << 8) | b;
+      cpu.gba->lcd.markVramDirty(address);
     }
     break;
   case 7:
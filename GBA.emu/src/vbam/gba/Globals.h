@@ -67,6 +67,11 @@ extern bool cpuIsMultiBoot;
 extern bool parseDebug;
 static const bool speedHack = 1;
 extern int cpuSaveType;
+extern bool cpuSkipIdleLoops;
+// start of a loop known to wait for the next event, set per game, 0 to detect them instead
+static const u32 IDLE_LOOP_NONE = 0xFFFFFFFF; // skip no loops
+extern u32 cpuIdleLoop;
+extern bool gfxThreadedRender; // render lines on a second thread when there's more than one core
 #ifdef USE_CHEATS
 extern bool cheatsEnabled;
 #else
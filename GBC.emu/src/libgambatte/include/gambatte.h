@@ -23,6 +23,7 @@
 #include "loadres.h"
 #include "gbint.h"
 #include <string>
+#include <iosfwd>
 
 namespace gambatte {
 enum { BG_PALETTE = 0, SP1_PALETTE = 1, SP2_PALETTE = 2 };
@@ -125,6 +126,16 @@ public:
 	  */
 	bool loadState(const std::string &filepath);
 	
+	/** Saves emulator state to 'stream', in the same format as a state file.
+	  * @return success, false if the stream failed (e.g. a full fixed size buffer)
+	  */
+	bool saveState(const gambatte::PixelType *videoBuf, int pitch, std::ostream &stream);
+	
+	/** Loads emulator state from 'stream' without writing persistent cartridge data first.
+	 * @return success
+	  */
+	bool loadState(std::istream &stream);
+	
 	/** Selects which state slot to save state to or load state from.
 	  * There are 10 such slots, numbered from 0 to 9 (periodically extended for all n).
 	  */
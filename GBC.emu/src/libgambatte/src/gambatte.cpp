@@ -190,6 +190,30 @@ bool GB::saveState(const gambatte::PixelType *const videoBuf, const int pitch, c
 	return false;
 }
 
+bool GB::saveState(const gambatte::PixelType *const videoBuf, const int pitch, std::ostream &stream) {
+	if (p_->cpu.loaded()) {
+		SaveState state;
+		p_->cpu.setStatePtrs(state);
+		p_->cpu.saveState(state);
+		return StateSaver::saveState(state, videoBuf, pitch, stream);
+	}
+
+	return false;
+}
+
+bool GB::loadState(std::istream &stream) {
+	if (p_->cpu.loaded()) {
+		SaveState state;
+		p_->cpu.setStatePtrs(state);
+		
+		if (StateSaver::loadState(state, stream)) {
+			p_->cpu.loadState(state);
+			return true;
+		}
+	}
+	return false;
+}
+
 void GB::selectState(int n) {
 	n -= (n / 10) * 10;
 	p_->stateNo = n < 0 ? n + 10 : n;
@@ -21,6 +21,7 @@
 
 #include "gbint.h"
 #include <string>
+#include <iosfwd>
 
 namespace gambatte {
 
@@ -38,6 +39,9 @@ public:
 	static bool saveState(const SaveState &state,
 			const PixelType *videoBuf, int pitch, const std::string &filename);
 	static bool loadState(SaveState &state, const std::string &filename);
+	static bool saveState(const SaveState &state,
+			const PixelType *videoBuf, int pitch, std::ostream &file);
+	static bool loadState(SaveState &state, std::istream &file);
 };
 
 }
@@ -12,6 +12,7 @@
 #include <EmuSystem.hh>
 #include <CommonFrameworkIncludes.hh>
 #include <gambatte.h>
+#include <sstream>
 #include <resample/resamplerinfo.h>
 #include <main/Cheats.hh>
 
@@ -249,10 +250,7 @@ int EmuSystem::saveState()
 		fixFilePermissions(saveStr);
 	#endif
 	logMsg("saving state %s", saveStr);
-	if(!gbEmu.saveState(/*screenBuff*/0, 160, saveStr))
-		return STATE_RESULT_IO_ERROR;
-	else
-		return STATE_RESULT_OK;
+	return saveMemStateFile(saveStr, 0);
 }
 
 int EmuSystem::loadState(int saveStateSlot)
@@ -262,10 +260,8 @@ int EmuSystem::loadState(int saveStateSlot)
 	if(FsSys::fileExists(saveStr))
 	{
 		logMsg("loading state %s", saveStr);
-		if(!gbEmu.loadState(saveStr))
-			return STATE_RESULT_IO_ERROR;
-		else
-			return STATE_RESULT_OK;
+		gbEmu.saveSavedata();
+		return loadMemStateFile(saveStr);
 	}
 	return STATE_RESULT_NO_FILE;
 }
@@ -283,6 +279,43 @@ void EmuSystem::savePathChanged()
 	gbEmu.setSaveDir(savePath());
 }
 
+// stream buffer over caller memory, writing past the end fails the stream
+class StateStreamBuf : public std::streambuf
+{
+public:
+	StateStreamBuf(char *buff, uint size)
+	{
+		setp(buff, buff + size);
+		setg(buff, buff, buff + size);
+	}
+
+	uint written() const { return pptr() - pbase(); }
+};
+
+uint EmuSystem::memStateSize()
+{
+	std::ostringstream stream;
+	if(!gbEmu.saveState(0, 160, stream))
+		return 0;
+	return stream.tellp();
+}
+
+uint EmuSystem::saveMemState(uchar *buff, uint size)
+{
+	StateStreamBuf buf((char*)buff, size);
+	std::ostream stream(&buf);
+	if(!gbEmu.saveState(0, 160, stream) || !stream)
+		return 0; // also when the state didn't fit
+	return buf.written();
+}
+
+bool EmuSystem::loadMemState(const uchar *buff, uint size)
+{
+	StateStreamBuf buf((char*)buff, size);
+	std::istream stream(&buf);
+	return gbEmu.loadState(stream);
+}
+
 void EmuSystem::saveAutoState()
 {
 	if(gameIsRunning() && optionAutoSaveState)
@@ -293,7 +326,7 @@ void EmuSystem::saveAutoState()
 		#ifdef CONFIG_BASE_IOS_SETUID
 			fixFilePermissions(saveStr);
 		#endif
-		gbEmu.saveState(/*screenBuff*/0, 160, saveStr);
+		saveMemStateFileAsync(saveStr, 0);
 	}
 }
 
@@ -358,7 +391,7 @@ void EmuSystem::configAudioRate()
 static void writeAudio(const int16 *srcBuff, unsigned srcFrames)
 {
 	#ifdef USE_NEW_AUDIO
-	Audio::BufferContext *aBuff = Audio::getPlayBuffer(Audio::maxRate/58);
+	Audio::BufferContext *aBuff = EmuAudio::getPlayBuffer(Audio::maxRate/58);
 	if(!aBuff)
 		return;
 	short *destBuff = (short*)aBuff->data;
@@ -369,11 +402,11 @@ static void writeAudio(const int16 *srcBuff, unsigned srcFrames)
 	uint destFrames = resampler->resample(destBuff, (const short*)srcBuff, srcFrames);
 	//logMsg("%d audio frames from %d, %d", destFrames, srcFrames, (int)destBuff[0]);
 	#ifdef USE_NEW_AUDIO
-	Audio::commitPlayBuffer(aBuff, destFrames);
+	EmuAudio::commitPlayBuffer(aBuff, destFrames);
 	#else
 	assert(Audio::maxFormat.framesToBytes(destFrames) <= sizeof(destBuff));
 	//mem_zero(destBuff);
-	Audio::writePcm((uchar*)destBuff, destFrames);
+	EmuAudio::writePcm((uchar*)destBuff, destFrames);
 	#endif
 }
 
@@ -384,6 +417,7 @@ static void commitVideoFrame()
 
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	uint8 snd[(35112+2064)*4] ATTRS(aligned(4));
 	unsigned samples;
 
@@ -24,24 +24,14 @@
 
 //static unsigned char state[STATE_SIZE] __attribute__ ((aligned (4)));
 
-int state_load(const unsigned char *buffer)
+int state_loadRaw(const unsigned char *stateBuff, int size)
 {
-	unsigned char *state = (unsigned char*)malloc(STATE_SIZE);
-	if(!state)
-		return -1;
+  unsigned char *state = (unsigned char*)stateBuff;
 
   /* buffer size */
   int bufferptr = 0;
-
-  /* uncompress savestate */
-  unsigned long inbytes, outbytes;
-  memcpy(&inbytes, buffer, 4);
-  outbytes = STATE_SIZE;
-  if(uncompress((Bytef *)state, &outbytes, (Bytef *)(buffer + 4), inbytes) != Z_OK)
-  {
-    free(state);
+  if(size < 16)
     return -1;
-  }
 
   /* signature check (GENPLUS-GX x.x.x) */
   char version[17];
@@ -49,14 +39,12 @@ int state_load(const unsigned char *buffer)
   version[16] = 0;
   if (strncmp(version,STATE_VERSION,11))
   {
-  	free(state);
     return -1;
   }
 
   /* version check (1.5.0 and above) */
   if ((version[11] < 0x31) || ((version[11] == 0x31) && (version[13] < 0x35)))
   {
-  	free(state);
     return -1;
   }
 
@@ -176,16 +164,11 @@ int state_load(const unsigned char *buffer)
 	}
 	#endif
 
-	free(state);
   return 1;
 }
 
-int state_save(unsigned char *buffer)
+int state_saveRaw(unsigned char *state)
 {
-	unsigned char *state = (unsigned char*)malloc(STATE_SIZE);
-	if(!state)
-		return -1;
-
   /* buffer size */
   int bufferptr = 0;
 
@@ -280,8 +263,39 @@ int state_save(unsigned char *buffer)
 	}
 	#endif
 
+  /* return uncompressed size */
+  return bufferptr;
+}
+
+int state_load(const unsigned char *buffer)
+{
+	unsigned char *state = (unsigned char*)malloc(STATE_SIZE);
+	if(!state)
+		return -1;
+
+  /* uncompress savestate */
+  unsigned long inbytes, outbytes;
+  memcpy(&inbytes, buffer, 4);
+  outbytes = STATE_SIZE;
+  if(uncompress((Bytef *)state, &outbytes, (Bytef *)(buffer + 4), inbytes) != Z_OK)
+  {
+    free(state);
+    return -1;
+  }
+
+  int ret = state_loadRaw(state, outbytes);
+  free(state);
+  return ret;
+}
+
+int state_save(unsigned char *buffer)
+{
+	unsigned char *state = (unsigned char*)malloc(STATE_SIZE);
+	if(!state)
+		return -1;
+
   /* compress state file */
-  unsigned long inbytes   = bufferptr;
+  unsigned long inbytes   = state_saveRaw(state);
   unsigned long outbytes  = STATE_SIZE;
   logMsg("compressing %d bytes to buffer of %d size", (int)inbytes, (int)outbytes);
   int ret = compress2 ((Bytef *)(buffer + 4), &outbytes, (Bytef *)state, inbytes, 9);
@@ -42,5 +42,8 @@
 /* Function prototypes */
 extern int state_load(const unsigned char *buffer);
 extern int state_save(unsigned char *buffer);
+/* uncompressed state in a STATE_SIZE buffer, state_saveRaw returns the used size */
+extern int state_loadRaw(const unsigned char *state, int size);
+extern int state_saveRaw(unsigned char *state);
 
 #endif
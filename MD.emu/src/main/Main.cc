@@ -278,6 +278,7 @@ void commitVideoFrame()
 
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	//logMsg("frame start");
 	RAMCheatUpdate();
 	system_frame(!processGfx, renderGfx);
@@ -288,7 +289,7 @@ void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 	Audio::BufferContext *aBuff = nullptr;
 	if(renderAudio)
 	{
-		if(!(aBuff = Audio::getPlayBuffer(snd.buffer_size)))
+		if(!(aBuff = EmuAudio::getPlayBuffer(snd.buffer_size)))
 		{
 			return;
 		}
@@ -309,10 +310,10 @@ void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 		//logMsg("%d frames", frames);
 		#ifdef USE_NEW_AUDIO
 		if(renderAudio)
-			Audio::commitPlayBuffer(aBuff, frames);
+			EmuAudio::commitPlayBuffer(aBuff, frames);
 		#else
 		if(renderAudio)
-			Audio::writePcm((uchar*)audioBuff, frames);
+			EmuAudio::writePcm((uchar*)audioBuff, frames);
 		#endif
 	}
 	//logMsg("frame end");
@@ -493,6 +494,23 @@ void EmuSystem::saveBackupMem() // for manually saving when not closing game
 	writeCheatFile();
 }
 
+uint EmuSystem::memStateSize()
+{
+	return STATE_SIZE;
+}
+
+uint EmuSystem::saveMemState(uchar *buff, uint size)
+{
+	if(size < STATE_SIZE)
+		return 0;
+	return state_saveRaw(buff);
+}
+
+bool EmuSystem::loadMemState(const uchar *buff, uint size)
+{
+	return state_loadRaw(buff, size) > 0;
+}
+
 void EmuSystem::saveAutoState()
 {
 	if(gameIsRunning() && optionAutoSaveState)
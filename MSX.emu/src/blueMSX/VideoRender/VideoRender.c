@@ -31,8 +31,8 @@
 #include "ArchTimer.h"
 #include "Emulator.h"
 #include "Scalebit.h"
-#include "hq2x.h"
-#include "hq3x.h"
+#include <scaler/hq2x.h>
+#include <scaler/hq3x.h>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
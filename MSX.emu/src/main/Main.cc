@@ -855,6 +855,10 @@ void EmuSystem::saveBackupMem()
 	}
 }
 
+uint EmuSystem::memStateSize() { return 0; }
+uint EmuSystem::saveMemState(uchar *buff, uint size) { return 0; }
+bool EmuSystem::loadMemState(const uchar *buff, uint size) { return 0; }
+
 void EmuSystem::saveAutoState()
 {
 	if(gameIsRunning() && optionAutoSaveState)
@@ -1064,6 +1068,7 @@ void RefreshScreen(int screenMode)
 
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	//skipFrame = !processGfx;
 
 	// fast-forward during floppy access, but stop if access ends
@@ -1085,7 +1090,7 @@ void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 			uchar *audio = (uchar*)mixerGetBuffer(mixer, &samples);
 			if(useFrame)
 			{
-				Audio::writePcm(audio, samples/2);
+				EmuAudio::writePcm(audio, samples/2);
 				return; // done with frame for this update
 			}
 		}
@@ -1102,7 +1107,7 @@ void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 	//logMsg("%d samples", samples/2);
 	if(renderAudio && samples)
 	{
-		Audio::writePcm(audio, samples/2);
+		EmuAudio::writePcm(audio, samples/2);
 	}
 }
 
@@ -392,6 +392,10 @@ void EmuSystem::saveBackupMem()
 	}
 }
 
+uint EmuSystem::memStateSize() { return 0; }
+uint EmuSystem::saveMemState(uchar *buff, uint size) { return 0; }
+bool EmuSystem::loadMemState(const uchar *buff, uint size) { return 0; }
+
 void EmuSystem::saveAutoState()
 {
 	if(gameIsRunning() && optionAutoSaveState)
@@ -683,6 +687,7 @@ CLINK void screen_update()
 
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	//logMsg("run frame %d", (int)processGfx);
 	renderToScreen = renderGfx;
 	skip_this_frame = !processGfx;
@@ -692,7 +697,7 @@ void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 	YM2610Update_stream(audioFramesPerUpdate);
 	if(renderAudio)
 	{
-		Audio::writePcm((uchar*)play_buffer, audioFramesPerUpdate);
+		EmuAudio::writePcm((uchar*)play_buffer, audioFramesPerUpdate);
 	}
 }
 
@@ -32,6 +32,8 @@ uint fceuCheats = 0;
 
 #include <fceu/driver.h>
 #include <fceu/state.h>
+#include <fceu/emufile.h>
+#include <zlib.h>
 #include <fceu/fceu.h>
 #include <fceu/ppu.h>
 #include <fceu/fds.h>
@@ -241,10 +243,7 @@ int EmuSystem::saveState()
 		fixFilePermissions(saveStr);
 	#endif
 	sprintStateFilename(saveStr, saveStateSlot);
-	if(!FCEUI_SaveState(saveStr))
-		return STATE_RESULT_IO_ERROR;
-	else
-		return STATE_RESULT_OK;
+	return saveMemStateFile(saveStr, 0);
 }
 
 int EmuSystem::loadState(int saveStateSlot)
@@ -254,10 +253,7 @@ int EmuSystem::loadState(int saveStateSlot)
 	if(FsSys::fileExists(saveStr))
 	{
 		logMsg("loading state %s", saveStr);
-		if(!FCEUI_LoadState(saveStr))
-			return STATE_RESULT_IO_ERROR;
-		else
-			return STATE_RESULT_OK;
+		return loadMemStateFile(saveStr);
 	}
 	else
 		return STATE_RESULT_NO_FILE;
@@ -276,6 +272,39 @@ void EmuSystem::saveBackupMem() // for manually saving when not closing game
 	}
 }
 
+// states are written uncompressed (FCSX header with a -1 compressed length)
+// so they stay readable by FCEUX, compressed ones from older versions still load
+static std::vector<u8> stateVec;
+
+static uint saveStateVec()
+{
+	EMUFILE_MEMORY ms(&stateVec);
+	ms.truncate(0); // keep the capacity from the last save
+	if(!FCEUSS_SaveMS(&ms, Z_NO_COMPRESSION))
+		return 0;
+	return ms.size();
+}
+
+uint EmuSystem::memStateSize()
+{
+	return saveStateVec();
+}
+
+uint EmuSystem::saveMemState(uchar *buff, uint size)
+{
+	uint bytes = saveStateVec();
+	if(!bytes || bytes > size)
+		return 0;
+	memcpy(buff, &stateVec[0], bytes);
+	return bytes;
+}
+
+bool EmuSystem::loadMemState(const uchar *buff, uint size)
+{
+	EMUFILE_MEMORY ms((void*)buff, size);
+	return FCEUSS_LoadFP(&ms, SSLOADPARAM_NOBACKUP);
+}
+
 void EmuSystem::saveAutoState()
 {
 	if(gameIsRunning() && optionAutoSaveState)
@@ -285,7 +314,7 @@ void EmuSystem::saveAutoState()
 		#ifdef CONFIG_BASE_IOS_SETUID
 			fixFilePermissions(saveStr);
 		#endif
-		FCEUI_SaveState(saveStr);
+		saveMemStateFileAsync(saveStr, 0);
 	}
 }
 
@@ -486,12 +515,13 @@ void FCEUD_commitVideoFrame()
 
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	uint8 *gfx; int32 ssize;
 
 	#ifdef USE_NEW_AUDIO
 	Audio::BufferContext *aBuff = 0;
 	int16 *sound = 0;
-	if(renderAudio && (aBuff = Audio::getPlayBuffer(audioMaxFramesPerUpdate)))
+	if(renderAudio && (aBuff = EmuAudio::getPlayBuffer(audioMaxFramesPerUpdate)))
 		sound = (int16*)aBuff->data;
 	#else
 	int16 sound[audioMaxFramesPerUpdate/2];
@@ -511,13 +541,13 @@ void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 	if(renderAudio && aBuff)
 	{
 		assert(ssize <= (int)aBuff->frames);
-		Audio::commitPlayBuffer(aBuff, ssize);
+		EmuAudio::commitPlayBuffer(aBuff, ssize);
 	}
 	#else
 	if(renderAudio && ssize)
 	{
 		assert(ssize <= (int)audioMaxFramesPerUpdate);
-		Audio::writePcm((uchar*)sound, ssize);
+		EmuAudio::writePcm((uchar*)sound, ssize);
 	}
 	#endif
 }
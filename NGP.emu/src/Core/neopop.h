@@ -376,6 +376,11 @@ RomHeader;
 	bool system_io_rom_read(char* filename, uint8* buffer, uint32 bufferLength);
 
 
+/*! Releases rom data loaded by the system, which may not come from malloc() */
+
+	void system_io_rom_free(uint8* buffer);
+
+
 /*! Reads the "appropriate" (system specific) flash data into the given
 	preallocated buffer. The emulation core doesn't care where from. */
 
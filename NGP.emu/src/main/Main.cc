@@ -14,6 +14,8 @@
 #include <util/time/sys.hh>
 #include <unzip.h>
 #include <EmuSystem.hh>
+#include <MappedRom.hh>
+#include <RomCache.hh>
 #include <CommonFrameworkIncludes.hh>
 
 const char *creditsViewStr = CREDITS_INFO_STRING "(c) 2011-2013\nRobert Broglia\nwww.explusalpha.com\n\n(c) 2004\nthe NeoPop Team\nwww.nih.at";
@@ -209,6 +211,16 @@ static void sprintSaveFilename(char (&str)[S])
 	snprintf(str, S, "%s/%s.ngf", EmuSystem::savePath(), EmuSystem::gameName);
 }
 
+static MappedRom romMapping;
+
+void system_io_rom_free(uchar* buffer)
+{
+	if(romMapping.isOpen() && buffer == romMapping.data())
+		romMapping.close();
+	else
+		free(buffer);
+}
+
 bool system_io_flash_read(uchar* buffer, uint32 len)
 {
 	FsSys::cPath saveStr;
@@ -236,6 +248,10 @@ void EmuSystem::saveBackupMem()
 	flash_commit();
 }
 
+uint EmuSystem::memStateSize() { return 0; }
+uint EmuSystem::saveMemState(uchar *buff, uint size) { return 0; }
+bool EmuSystem::loadMemState(const uchar *buff, uint size) { return 0; }
+
 void EmuSystem::saveAutoState()
 {
 	if(gameIsRunning() && optionAutoSaveState)
@@ -262,6 +278,9 @@ bool touchControlsApplicable() { return 1; }
 #define HAVE_LIBZ
 static bool romLoad(const char *filename)
 {
+	// the core may read up to maxRomSize past a smaller image, every path rejects or
+	// truncates larger ones and zero-pads smaller ones to it
+	const uint maxRomSize = 0x400000;
 #ifdef HAVE_LIBZ
 	unzFile z;
 	if ((z=unzOpen(filename)) != 0)
@@ -280,8 +299,25 @@ static bool romLoad(const char *filename)
 			if (strcasecmp(name+l-4, ".ngp") == 0 || strcasecmp(name+l-4, ".ngc") == 0
 					|| strcasecmp(name+l-4, ".npc") == 0)
 			{
+				FsSys::cPath cachePath;
+				if(RomCache::lookup(filename, zfi.crc, cachePath)
+					&& romMapping.open(cachePath, maxRomSize, maxRomSize))
+				{
+					unzClose(z);
+					rom.data = romMapping.data();
+					rom.length = romMapping.size();
+					logMsg("mapped 0x%X byte rom from cache", rom.length);
+					return 1;
+				}
+				if(zfi.uncompressed_size > maxRomSize)
+				{
+					logMsg("0x%X byte rom in %s is too large", (uint)zfi.uncompressed_size, filename);
+					unzClose(z);
+					return 0;
+				}
+				// zero-padded to maxRomSize like the other paths
 				rom.length = zfi.uncompressed_size;
-				rom.data = (uchar*)calloc(rom.length, 1);
+				rom.data = (uchar*)calloc(maxRomSize, 1);
 
 				if ((unzOpenCurrentFile(z) != UNZ_OK)
 				|| (unzReadCurrentFile(z, rom.data, rom.length)
@@ -304,6 +340,7 @@ static bool romLoad(const char *filename)
 				}
 				unzClose(z);
 				logMsg("read 0x%X byte rom", rom.length);
+				RomCache::store(filename, zfi.crc, rom.data, rom.length);
 				return 1;
 			}
 		}
@@ -313,7 +350,14 @@ static bool romLoad(const char *filename)
 	}
 #endif
 
-	const uint maxRomSize = 0x400000;
+	if(romMapping.open(filename, maxRomSize, maxRomSize))
+	{
+		rom.data = romMapping.data();
+		rom.length = romMapping.size();
+		logMsg("mapped 0x%X byte rom", rom.length);
+		return 1;
+	}
+
 	rom.data = (uchar*)calloc(maxRomSize, 1);
 
 	uint readSize = IoSys::readFromFile(filename, rom.data, maxRomSize);
@@ -385,16 +429,16 @@ void system_sound_chipreset(void)
 static void writeAudio()
 {
 #ifdef USE_NEW_AUDIO
-	Audio::BufferContext *aBuff = Audio::getPlayBuffer(Audio::maxRate/60);
+	Audio::BufferContext *aBuff = EmuAudio::getPlayBuffer(Audio::maxRate/60);
 	if(!aBuff) return;
 	assert(aBuff->frames >= Audio::maxRate/60);
 	sound_update((uint16*)aBuff->data, audioFramesPerUpdate*2);
-	Audio::commitPlayBuffer(aBuff, audioFramesPerUpdate);
+	EmuAudio::commitPlayBuffer(aBuff, audioFramesPerUpdate);
 #else
 	uint16 destBuff[(Audio::maxRate/60)];
 	uint destFrames = audioFramesPerUpdate;
 	sound_update(destBuff, audioFramesPerUpdate*2);
-	Audio::writePcm((uchar*)destBuff, destFrames);
+	EmuAudio::writePcm((uchar*)destBuff, destFrames);
 #endif
 }
 
@@ -409,6 +453,7 @@ void system_VBL(void)
 
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	if(renderGfx)
 		renderToScreen = 1;
 	frameskip_active = processGfx ? 0 : 1;
@@ -175,6 +175,36 @@ static void initVideoFormat()
 
 static uint16 inputBuff[5] = { 0 }; // 5 gamepad buffers
 
+static StateMem saveStateMem; // buffer kept between saves
+
+static uint saveStateMemBuff()
+{
+	saveStateMem.loc = saveStateMem.len = 0;
+	if(!MDFNSS_SaveSM(&saveStateMem, 0, 0))
+		return 0;
+	return saveStateMem.len;
+}
+
+uint EmuSystem::memStateSize()
+{
+	return saveStateMemBuff();
+}
+
+uint EmuSystem::saveMemState(uchar *buff, uint size)
+{
+	uint bytes = saveStateMemBuff();
+	if(!bytes || bytes > size)
+		return 0;
+	memcpy(buff, saveStateMem.data, bytes);
+	return bytes;
+}
+
+bool EmuSystem::loadMemState(const uchar *buff, uint size)
+{
+	StateMem st {(uint8*)buff, 0, size, 0, 0};
+	return MDFNSS_LoadSM(&st, 1, 0);
+}
+
 void EmuSystem::saveAutoState()
 {
 	if(gameIsRunning() && optionAutoSaveState)
@@ -184,7 +214,7 @@ void EmuSystem::saveAutoState()
 		#ifdef CONFIG_BASE_IOS_SETUID
 			fixFilePermissions(statePath.c_str());
 		#endif
-		MDFNI_SaveState(statePath.c_str(), 0, 0, 0, 0);
+		saveMemStateFileAsync(statePath.c_str());
 	}
 }
 
@@ -400,7 +430,7 @@ static int16 audioBuff[(Audio::maxRate/59)*2];
 static void setupEmuAudio(bool render)
 {
 	#ifdef USE_NEW_AUDIO
-	if(render && (aBuff = Audio::getPlayBuffer(audioMaxFramesPerUpdate)))
+	if(render && (aBuff = EmuAudio::getPlayBuffer(audioMaxFramesPerUpdate)))
 	{
 		espec.SoundBuf = (int16*)aBuff->data;
 		espec.SoundBufMaxSize = aBuff->frames-1;
@@ -424,11 +454,11 @@ static void commitEmuAudio(bool render)
 		if(aBuff)
 		{
 			assert((uint)espec.SoundBufSize <= aBuff->frames);
-			Audio::commitPlayBuffer(aBuff, espec.SoundBufSize);
+			EmuAudio::commitPlayBuffer(aBuff, espec.SoundBufSize);
 		}
 	#else
 		assert((uint)espec.SoundBufSize <= EmuSystem::pcmFormat.bytesToFrames(sizeof(audioBuff)));
-		Audio::writePcm((uchar*)audioBuff, espec.SoundBufSize);
+		EmuAudio::writePcm((uchar*)audioBuff, espec.SoundBufSize);
 	#endif
 	}
 }
@@ -504,6 +534,7 @@ void EmuSystem::handleInputAction(uint state, uint emuKey)
 
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	setupEmuAudio(renderAudio);
 	if(renderGfx)
 		renderToScreen = 1;
@@ -534,10 +565,7 @@ int EmuSystem::saveState()
 	#ifdef CONFIG_BASE_IOS_SETUID
 		fixFilePermissions(statePath.c_str());
 	#endif
-	if(!MDFNI_SaveState(statePath.c_str(), 0, 0, 0, 0))
-		return STATE_RESULT_IO_ERROR;
-	else
-		return STATE_RESULT_OK;
+	return saveMemStateFile(statePath.c_str());
 }
 
 int EmuSystem::loadState(int saveStateSlot)
@@ -548,10 +576,7 @@ int EmuSystem::loadState(int saveStateSlot)
 	if(FsSys::fileExists(statePath.c_str()))
 	{
 		logMsg("loading state %s", statePath.c_str());
-		if(!MDFNI_LoadState(statePath.c_str(), 0))
-			return STATE_RESULT_IO_ERROR;
-		else
-			return STATE_RESULT_OK;
+		return loadMemStateFile(statePath.c_str());
 	}
 	return STATE_RESULT_NO_FILE;
 }
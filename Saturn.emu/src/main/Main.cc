@@ -90,7 +90,7 @@ static void SNDImagineUpdateAudio(u32 *leftchanbuffer, u32 *rightchanbuffer, u32
 	{
 		mergeSamplesToStereo(leftchanbuffer[i], rightchanbuffer[i], &sample[i*2]);
 	}
-	Audio::writePcm((uchar*)sample, frames);
+	EmuAudio::writePcm((uchar*)sample, frames);
 }
 
 static u32 SNDImagineGetAudioSpace()
@@ -463,6 +463,10 @@ void EmuSystem::saveBackupMem() // for manually saving when not closing game
 	}
 }
 
+uint EmuSystem::memStateSize() { return 0; }
+uint EmuSystem::saveMemState(uchar *buff, uint size) { return 0; }
+bool EmuSystem::loadMemState(const uchar *buff, uint size) { return 0; }
+
 void EmuSystem::saveAutoState()
 {
 	if(gameIsRunning() && optionAutoSaveState)
@@ -531,6 +535,7 @@ void EmuSystem::configAudioRate()
 
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	if(renderGfx)
 		renderToScreen = 1;
 	SNDImagine.UpdateAudio = renderAudio ? SNDImagineUpdateAudio : SNDImagineUpdateAudioNull;
@@ -363,10 +363,14 @@ int EmuSystem::saveState()
 	#ifdef CONFIG_BASE_IOS_SETUID
 		fixFilePermissions(saveStr);
 	#endif
+	#ifndef SNES9X_VERSION_1_4
+	return saveMemStateFile(saveStr);
+	#else
 	if(!S9xFreezeGame(saveStr))
 		return STATE_RESULT_IO_ERROR;
 	else
 		return STATE_RESULT_OK;
+	#endif
 }
 
 int EmuSystem::loadState(int saveStateSlot)
@@ -376,6 +380,9 @@ int EmuSystem::loadState(int saveStateSlot)
 	if(FsSys::fileExists(saveStr))
 	{
 		logMsg("loading state %s", saveStr);
+		#ifndef SNES9X_VERSION_1_4
+		return loadMemStateFile(saveStr);
+		#else
 		if(S9xUnfreezeGame(saveStr))
 		{
 			IPPU.RenderThisFrame = TRUE;
@@ -383,6 +390,7 @@ int EmuSystem::loadState(int saveStateSlot)
 		}
 		else
 			return STATE_RESULT_IO_ERROR;
+		#endif
 	}
 	return STATE_RESULT_NO_FILE;
 }
@@ -401,6 +409,32 @@ void EmuSystem::saveBackupMem() // for manually saving when not closing game
 	}
 }
 
+#ifndef SNES9X_VERSION_1_4
+uint EmuSystem::memStateSize()
+{
+	return S9xFreezeSize();
+}
+
+uint EmuSystem::saveMemState(uchar *buff, uint size)
+{
+	memStream stream(buff, size);
+	S9xFreezeToStream(&stream);
+	return stream.pos();
+}
+
+bool EmuSystem::loadMemState(const uchar *buff, uint size)
+{
+	if(S9xUnfreezeGameMem(buff, size) != SUCCESS)
+		return 0;
+	IPPU.RenderThisFrame = TRUE;
+	return 1;
+}
+#else
+uint EmuSystem::memStateSize() { return 0; }
+uint EmuSystem::saveMemState(uchar *buff, uint size) { return 0; }
+bool EmuSystem::loadMemState(const uchar *buff, uint size) { return 0; }
+#endif
+
 void EmuSystem::saveAutoState()
 {
 	if(gameIsRunning() && optionAutoSaveState)
@@ -410,7 +444,11 @@ void EmuSystem::saveAutoState()
 		#ifdef CONFIG_BASE_IOS_SETUID
 			fixFilePermissions(saveStr);
 		#endif
+		#ifndef SNES9X_VERSION_1_4
+		if(saveMemStateFileAsync(saveStr) != STATE_RESULT_OK)
+		#else
 		if(!S9xFreezeGame(saveStr))
+		#endif
 			logMsg("error saving state %s", saveStr);
 	}
 }
@@ -611,17 +649,22 @@ void EmuSystem::clearInputBuffers()
 void EmuSystem::configAudioRate()
 {
 	pcmFormat.rate = optionSoundRate;
-	Settings.SoundPlaybackRate = optionSoundRate;
+	uint playbackRate = optionSoundRate;
 	#if defined(CONFIG_ENV_WEBOS)
 	if(optionFrameSkip != optionFrameSkipAuto)
-		Settings.SoundPlaybackRate = (float)optionSoundRate * (42660./44100.); // better sync with Pre's refresh rate
+		playbackRate = (float)optionSoundRate * (42660./44100.); // better sync with Pre's refresh rate
 	#endif
 	#ifndef SNES9X_VERSION_1_4
+	// DSP samples pass through at their native rate, EmuAudio's resampler converts them
+	Settings.SoundPlaybackRate = Settings.SoundInputRate;
 	S9xUpdatePlaybackRate();
+	EmuAudio::setSourceRate((uint64)Settings.SoundInputRate * optionSoundRate / playbackRate);
+	logMsg("emu sound rate %d -> %d", EmuAudio::sourceRate(), (int)optionSoundRate);
 	#else
+	Settings.SoundPlaybackRate = playbackRate;
 	S9xSetPlaybackRate(Settings.SoundPlaybackRate);
-	#endif
 	logMsg("emu sound rate %d", Settings.SoundPlaybackRate);
+	#endif
 }
 
 static void doS9xAudio(bool renderAudio)
@@ -639,7 +682,7 @@ static void doS9xAudio(bool renderAudio)
 		Audio::BufferContext *aBuff = nullptr;
 		if(renderAudio)
 		{
-			if(!(aBuff = Audio::getPlayBuffer(frames)))
+			if(!(aBuff = EmuAudio::getPlayBuffer(frames)))
 			{
 				return;
 			}
@@ -667,15 +710,16 @@ static void doS9xAudio(bool renderAudio)
 
 	#ifdef USE_NEW_AUDIO
 		if(renderAudio)
-			Audio::commitPlayBuffer(aBuff, frames);
+			EmuAudio::commitPlayBuffer(aBuff, frames);
 	#else
 		if(renderAudio)
-			Audio::writePcm((uchar*)audioBuff, frames);
+			EmuAudio::writePcm((uchar*)audioBuff, frames);
 	#endif
 }
 
 void EmuSystem::runFrame(bool renderGfx, bool processGfx, bool renderAudio)
 {
+	TRACE_SCOPE("EmuSystem::runFrame");
 	if(unlikely(snesActiveInputPort != SNES_JOYPAD))
 	{
 		if(doubleClickFrames)
@@ -24,10 +24,29 @@ PcmFormat preferredPcmFormat { 48000, &SampleFormats::s16, 2 };
 PcmFormat pcmFormat;
 static snd_output_t *debugOutput = nullptr;
 static snd_pcm_t *pcmHnd = 0;
-static snd_pcm_uframes_t bufferSize, periodSize;
+static snd_pcm_uframes_t bufferSize, periodSize, startThreshold;
 static bool useMmap;
 static uint bufferFrames = 800;
 static uint buffers = 8;
+static bool strictUnderrunCheck = 1;
+
+// The device buffer holds two writes of bufferFrames plus "buffers" periods of headroom.
+// Periods start at the smallest level and move up one whenever underruns repeat within
+// stableSecs of each other, the level is kept for later opens of the device.
+static const snd_pcm_uframes_t periodLevelFrames[] { 64, 128, 256, 512, 1024 }; // at 48KHz
+static const uint periodLevels = sizeofArray(periodLevelFrames);
+static const uint stableSecs = 10;
+static uint periodLevel = 0;
+static bool hadXRun = 0, reopenPending = 0;
+static uint64 framesSinceXRun = 0;
+
+// for writes that wrap around the end of the mmap area or don't fit the free space
+static uchar *bounceBuff = nullptr;
+static uint bounceFrames = 0;
+static BufferContext bounceCtx;
+
+static CallResult openAlsaPcm(const PcmFormat &format);
+static void closeAlsaPcm();
 
 void setHintPcmFramesPerWrite(uint frames)
 {
@@ -47,6 +66,16 @@ void setHintPcmMaxBuffers(uint maxBuffers)
 
 uint hintPcmMaxBuffers() { return buffers; }
 
+void setHintStrictUnderrunCheck(bool on)
+{
+	strictUnderrunCheck = on;
+}
+
+bool hintStrictUnderrunCheck()
+{
+	return strictUnderrunCheck;
+}
+
 static const SampleFormat *alsaFormatToPcm(snd_pcm_format_t format)
 {
 	switch(format)
@@ -72,31 +101,80 @@ static snd_pcm_format_t pcmFormatToAlsa(const SampleFormat &format)
 	}
 }
 
+// frames queued ahead of the one being heard, including the hardware/plugin delay
 int frameDelay()
 {
-	snd_pcm_sframes_t delay;
-	snd_pcm_delay(pcmHnd, &delay);
+	if(unlikely(!pcmHnd))
+		return 0;
+	snd_pcm_sframes_t avail, delay;
+	if(snd_pcm_avail_delay(pcmHnd, &avail, &delay) < 0)
+		return -1;
 	return delay;
 }
 
 int framesFree()
 {
+	if(unlikely(!pcmHnd))
+		return 0;
 	return snd_pcm_avail_update(pcmHnd);
 }
 
-static void startPlaybackIfNeeded()
+// a larger period is only applied by re-opening the device from getPlayBuffer()/writePcm()
+// since a bounce buffer may be in use, disabled along with the strict underrun check
+static bool recover(int err)
+{
+	if(err == -EPIPE)
+	{
+		if(hadXRun && strictUnderrunCheck && framesSinceXRun < (uint64)stableSecs * pcmFormat.rate
+			&& periodLevel + 1 < periodLevels)
+		{
+			periodLevel++;
+			logMsg("repeated underruns after %u frames, raising period to level %u",
+				(uint)framesSinceXRun, periodLevel);
+			reopenPending = 1;
+		}
+		hadXRun = 1;
+		framesSinceXRun = 0;
+	}
+	logMsg("recovering from: %s", snd_strerror(err));
+	if((err = snd_pcm_recover(pcmHnd, err, 1)) < 0)
+	{
+		logErr("can't recover pcm: %s", snd_strerror(err));
+		return 0;
+	}
+	return 1;
+}
+
+static void reopenIfPending()
+{
+	if(likely(!reopenPending))
+		return;
+	reopenPending = 0;
+	auto format = pcmFormat;
+	closeAlsaPcm();
+	openAlsaPcm(format);
+}
+
+static snd_pcm_uframes_t availFrames()
 {
-	auto state = snd_pcm_state(pcmHnd);
-	//logMsg("pcm state: %s", alsaPcmStateToString(state));
-	if(state == SND_PCM_STATE_XRUN)
+	auto avail = snd_pcm_avail_update(pcmHnd);
+	if(avail < 0)
 	{
-		logMsg("recovering from xrun");
-		snd_pcm_recover(pcmHnd, -EPIPE, 0);
+		if(!recover(avail))
+			return 0;
+		avail = snd_pcm_avail_update(pcmHnd);
 	}
-	else if(state == SND_PCM_STATE_PREPARED && framesFree() < (int)bufferFrames)
+	return IG::max(avail, (snd_pcm_sframes_t)0);
+}
+
+static void startPlaybackIfNeeded()
+{
+	if(snd_pcm_state(pcmHnd) != SND_PCM_STATE_PREPARED)
+		return;
+	auto avail = snd_pcm_avail_update(pcmHnd);
+	if(avail >= 0 && bufferSize - avail >= startThreshold)
 	{
-		// start playback when one "buffer" of audio is left to write
-		logMsg("starting prepared pcm with %d frames free", framesFree());
+		logMsg("starting prepared pcm with %d frames queued", int(bufferSize - avail));
 		snd_pcm_start(pcmHnd);
 	}
 }
@@ -112,7 +190,6 @@ public:
 	CallResult begin(snd_pcm_t *pcmHnd, snd_pcm_uframes_t *frames)
 	{
 		var_selfs(pcmHnd);
-		snd_pcm_uframes_t wantedFrames = *frames;
 		if(snd_pcm_mmap_begin(pcmHnd, &areas, &offset, frames) != 0)
 		{
 			logErr("error in snd_pcm_mmap_begin");
@@ -120,114 +197,182 @@ public:
 		}
 		if(*frames == 0)
 		{
-			//logWarn("unexpected 0 samples returned for MMAP");
 			snd_pcm_mmap_commit(pcmHnd, offset, 0);
 			return INVALID_PARAMETER;
 		}
-
-		if(wantedFrames != *frames)
-		{
-			//logMsg("got %d frames out of %d from mmap", (int)*frames, (int)wantedFrames);
-		}
 		data = (uchar*)areas->addr + offset * (areas->step / 8);
 		this->frames = *frames;
-
 		return OK;
 	}
 
-	CallResult commitBytes(uint bytesWritten)
-	{
-		return commit(pcmFormat.bytesToFrames(bytesWritten));
-	}
-
 	CallResult commit(snd_pcm_uframes_t framesWritten)
 	{
 		auto ret = snd_pcm_mmap_commit(pcmHnd, offset, framesWritten);
 		if(ret < 0 || ret != (snd_pcm_sframes_t)framesWritten)
 		{
 			logMsg("error in snd_pcm_mmap_commit");
+			if(ret < 0)
+				recover(ret);
 			return INVALID_PARAMETER;
 		}
+		framesSinceXRun += framesWritten;
 		return OK;
 	}
 };
 
-void writePcm(uchar *samples, uint framesToWrite)
+static AlsaMmapContext mmapCtx;
+
+static void writeFrames(const uchar *samples, uint framesToWrite)
 {
-	if(unlikely(!pcmHnd))
-		return;
-	auto framesFreeOnHW = framesFree();
-	if((uint)framesFreeOnHW < framesToWrite)
-	{
-		logWarn("sending %d frames but only %d free", framesToWrite, framesFreeOnHW);
-		framesToWrite = framesFreeOnHW;
-	}
 	if(useMmap)
 	{
-		AlsaMmapContext ctx;
-		//logMsg("starting mmap loop");
 		for(snd_pcm_uframes_t frames; framesToWrite; framesToWrite -= frames)
 		{
 			frames = framesToWrite;
-			if(ctx.begin(pcmHnd, &frames) != OK)
+			if(mmapCtx.begin(pcmHnd, &frames) != OK)
 				return;
 			assert(frames <= framesToWrite);
-
-			memcpy(ctx.data, samples, pcmFormat.framesToBytes(frames));
+			memcpy(mmapCtx.data, samples, pcmFormat.framesToBytes(frames));
 			samples += pcmFormat.framesToBytes(frames);
-
-			if(ctx.commit(frames) != OK)
+			if(mmapCtx.commit(frames) != OK)
 				return;
 		}
 	}
 	else
 	{
 		auto written = snd_pcm_writei(pcmHnd, samples, framesToWrite);
-		if(written != (snd_pcm_sframes_t)framesToWrite)
+		if(written < 0)
 		{
-			if(written < 0)
-				logWarn("error writing %d frames", framesToWrite);
-			else
+			logWarn("error writing %d frames", framesToWrite);
+			recover(written);
+		}
+		else
+		{
+			if(written != (snd_pcm_sframes_t)framesToWrite)
 				logWarn("only %ld of %d frames written", written, framesToWrite);
+			framesSinceXRun += written;
 		}
 	}
+}
+
+static void writeAvailFrames(const uchar *samples, uint framesToWrite)
+{
+	auto framesFreeOnHW = availFrames();
+	if(framesFreeOnHW < framesToWrite)
+	{
+		logWarn("sending %d frames but only %d free", framesToWrite, (int)framesFreeOnHW);
+		framesToWrite = framesFreeOnHW;
+	}
+	if(framesToWrite)
+		writeFrames(samples, framesToWrite);
 	startPlaybackIfNeeded();
 }
 
+void writePcm(uchar *samples, uint framesToWrite)
+{
+	reopenIfPending();
+	if(unlikely(!pcmHnd))
+		return;
+	writeAvailFrames(samples, framesToWrite);
+}
+
+// Returns the device's mmap area directly when the request fits before it wraps,
+// otherwise a bounce buffer that's copied in by commitPlayBuffer()
+BufferContext *getPlayBuffer(uint wantedFrames)
+{
+	reopenIfPending();
+	if(unlikely(!pcmHnd))
+		return nullptr;
+	auto framesFreeOnHW = availFrames();
+	if(useMmap && framesFreeOnHW >= wantedFrames)
+	{
+		snd_pcm_uframes_t frames = wantedFrames;
+		if(mmapCtx.begin(pcmHnd, &frames) == OK)
+		{
+			if(frames == wantedFrames)
+				return &mmapCtx;
+			snd_pcm_mmap_commit(pcmHnd, mmapCtx.offset, 0);
+		}
+	}
+	if(unlikely(wantedFrames > bounceFrames))
+	{
+		logWarn("can't buffer %u frames", wantedFrames);
+		return nullptr;
+	}
+	bounceCtx.data = bounceBuff;
+	bounceCtx.frames = wantedFrames;
+	return &bounceCtx;
+}
+
+void commitPlayBuffer(BufferContext *buffer, uint frames)
+{
+	assert(frames <= buffer->frames);
+	if(buffer == &mmapCtx)
+	{
+		mmapCtx.commit(frames);
+		startPlaybackIfNeeded();
+	}
+	else
+		writeAvailFrames(bounceBuff, frames);
+}
+
 static int setupPcm(const PcmFormat &format, snd_pcm_access_t access)
 {
-	int alsalibResample = 1;
-	uint wantedBufferFrames = bufferFrames*buffers;
-	auto wantedLatency = format.framesToUSecs(wantedBufferFrames);
-	logMsg("requesting pcm latency %fus from %d frames", (double)wantedLatency, wantedBufferFrames);
+	snd_pcm_hw_params_t *hwParams;
+	snd_pcm_hw_params_alloca(&hwParams);
 	int err;
-	if ((err = snd_pcm_set_params(pcmHnd,
-		pcmFormatToAlsa(*format.sample),
-		access,
-		format.channels,
-		format.rate,
-		alsalibResample,
-		wantedLatency)) < 0)
+	if((err = snd_pcm_hw_params_any(pcmHnd, hwParams)) < 0
+		|| (err = snd_pcm_hw_params_set_rate_resample(pcmHnd, hwParams, 1)) < 0
+		|| (err = snd_pcm_hw_params_set_access(pcmHnd, hwParams, access)) < 0
+		|| (err = snd_pcm_hw_params_set_format(pcmHnd, hwParams, pcmFormatToAlsa(*format.sample))) < 0
+		|| (err = snd_pcm_hw_params_set_channels(pcmHnd, hwParams, format.channels)) < 0
+		|| (err = snd_pcm_hw_params_set_rate(pcmHnd, hwParams, format.rate, 0)) < 0)
 	{
 		logErr("Error setting pcm parameters: %s", snd_strerror(err));
 		return err;
 	}
 
-	if(access == SND_PCM_ACCESS_MMAP_INTERLEAVED)
-		useMmap = 1;
-	else
-		useMmap = 0;
-
-	if((err = snd_pcm_get_params(pcmHnd, &bufferSize, &periodSize) < 0))
+	// smallest period at or above the current level that the device accepts
+	snd_pcm_uframes_t minPeriod;
+	int dir = 0;
+	snd_pcm_hw_params_get_period_size_min(hwParams, &minPeriod, &dir);
+	snd_pcm_uframes_t period = IG::max(periodLevelFrames[periodLevel] * format.rate / 48000, minPeriod);
+	dir = 0;
+	if((err = snd_pcm_hw_params_set_period_size_near(pcmHnd, hwParams, &period, &dir)) < 0)
 	{
-		logErr("Error getting pcm buffer/period size parameters");
+		logErr("Error setting period size: %s", snd_strerror(err));
 		return err;
 	}
-	else
+	snd_pcm_uframes_t buffer = (bufferFrames * 2 + period - 1) / period * period + period * buffers;
+	if((err = snd_pcm_hw_params_set_buffer_size_near(pcmHnd, hwParams, &buffer)) < 0
+		|| (err = snd_pcm_hw_params(pcmHnd, hwParams)) < 0)
 	{
-		logMsg("buffer size %u, period size %u, mmap %d", (uint)bufferSize, (uint)periodSize, useMmap);
-		return 0;
+		logErr("Error setting %u frame buffer: %s", (uint)buffer, snd_strerror(err));
+		return err;
 	}
+	snd_pcm_hw_params_get_period_size(hwParams, &periodSize, &dir);
+	snd_pcm_hw_params_get_buffer_size(hwParams, &bufferSize);
+	// skip levels smaller than what the device gave, they'd negotiate the same period
+	while(periodLevel + 1 < periodLevels && periodLevelFrames[periodLevel + 1] * format.rate / 48000 <= periodSize)
+		periodLevel++;
+
+	// playback starts once a write of audio is queued
+	startThreshold = IG::min((snd_pcm_uframes_t)bufferFrames, bufferSize - periodSize);
+	snd_pcm_sw_params_t *swParams;
+	snd_pcm_sw_params_alloca(&swParams);
+	if((err = snd_pcm_sw_params_current(pcmHnd, swParams)) < 0
+		|| (err = snd_pcm_sw_params_set_start_threshold(pcmHnd, swParams, startThreshold)) < 0
+		|| (err = snd_pcm_sw_params_set_avail_min(pcmHnd, swParams, periodSize)) < 0
+		|| (err = snd_pcm_sw_params(pcmHnd, swParams)) < 0)
+	{
+		logErr("Error setting pcm software parameters: %s", snd_strerror(err));
+		return err;
+	}
+
+	useMmap = access == SND_PCM_ACCESS_MMAP_INTERLEAVED;
+	logMsg("buffer size %u (%fms), period size %u, mmap %d", (uint)bufferSize,
+		(double)format.framesToUSecs(bufferSize) / 1000., (uint)periodSize, useMmap);
+	return 0;
 }
 
 static CallResult openAlsaPcm(const PcmFormat &format)
@@ -241,6 +386,7 @@ static CallResult openAlsaPcm(const PcmFormat &format)
 	if ((err = snd_pcm_open(&pcmHnd, name, SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK)) < 0)
 	{
 		logErr("Playback open error: %s", snd_strerror(err));
+		pcmHnd = 0;
 		return INVALID_PARAMETER;
 	}
 
@@ -257,17 +403,26 @@ static CallResult openAlsaPcm(const PcmFormat &format)
 		else
 			setupPcmSuccess = 1;
 	}
-	if(!setupPcmSuccess && (err = setupPcm(format, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0)
+	if(!setupPcmSuccess)
 	{
-		logErr("failed opening in normal mode");
+		if((err = setupPcm(format, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0)
+			logErr("failed opening in normal mode");
+		else
+			setupPcmSuccess = 1;
 	}
-	else
-		setupPcmSuccess = 1;
 	if(!setupPcmSuccess)
 	{
 		ret = INVALID_PARAMETER; goto CLEANUP;
 	}
 
+	bounceFrames = IG::max((uint)bufferSize, (uint)maxRate/10);
+	if(!(bounceBuff = (uchar*)mem_alloc(format.framesToBytes(bounceFrames))))
+	{
+		ret = OUT_OF_MEMORY; goto CLEANUP;
+	}
+	hadXRun = reopenPending = 0;
+	framesSinceXRun = 0;
+
 	//snd_pcm_dump(alsaHnd, output);
 
 	return OK;
@@ -291,6 +446,8 @@ static void closeAlsaPcm()
 		snd_pcm_close(pcmHnd);
 		pcmHnd = 0;
 	}
+	mem_freeSafe(bounceBuff);
+	bounceFrames = 0;
 }
 
 CallResult openPcm(const PcmFormat &format)
@@ -3,7 +3,6 @@
 #include <audio/Audio.hh>
 #include <logger/interface.h>
 #include <util/number.h>
-#include <util/thread/pthread.hh>
 #include <util/RingBuffer.hh>
 
 #define Fixed MacTypes_Fixed
@@ -25,9 +24,8 @@ static AudioComponentInstance outputUnit = nullptr;
 static AudioStreamBasicDescription streamFormat;
 static bool isPlaying = 0, isOpen_ = 0;
 static AudioTimeStamp lastTimestamp;
-static MutexPThread buffersQueuedLock;
-static RingBuffer<int> rBuff;
-static int startPlaybackBytes = 0;
+static RingBuffer<> rBuff;
+static uint startPlaybackFrames = 0;
 static uchar *localBuff = nullptr;
 
 void setHintPcmFramesPerWrite(uint frames)
@@ -61,16 +59,13 @@ static OSStatus outputCallback(void *inRefCon, AudioUnitRenderActionFlags *ioAct
 		return 0;
 	}
 
-	buffersQueuedLock.lock();
-	uint read = rBuff.read(buf, bytes);
-	buffersQueuedLock.unlock();
-	if(unlikely(read != bytes))
+	uint read = rBuff.read(buf, inNumberFrames);
+	if(unlikely(read != inNumberFrames))
 	{
-		//logMsg("underrun, read %d out of %d bytes", read, bytes);
+		//logMsg("underrun, read %d out of %d frames", read, inNumberFrames);
 		isPlaying = 0;
-		uint padBytes = bytes - read;
-		//logMsg("padding %d bytes", padBytes);
-		mem_zero(&buf[read], padBytes);
+		uint readBytes = read * streamFormat.mBytesPerFrame;
+		mem_zero(&buf[readBytes], bytes - readBytes);
 	}
 	return 0;
 }
@@ -87,8 +82,9 @@ static CallResult openUnit(AudioStreamBasicDescription &fmt)
 	}
 	AudioUnitInitialize(outputUnit);
 
-	uint bufferSize = bufferFrames * streamFormat.mBytesPerFrame * buffers;
-	startPlaybackBytes = bufferFrames * streamFormat.mBytesPerFrame * buffers-1;
+	uint ringFrames = bufferFrames * buffers;
+	startPlaybackFrames = ringFrames - 1;
+	uint bufferSize = ringFrames * streamFormat.mBytesPerFrame;
 	localBuff = (uchar*)mem_alloc(bufferSize);
 	if(!localBuff)
 	{
@@ -96,8 +92,8 @@ static CallResult openUnit(AudioStreamBasicDescription &fmt)
 		logMsg("error allocation audio buffer");
 		return OUT_OF_MEMORY;
 	}
-	logMsg("allocated %d for audio buffer", bufferSize);
-	rBuff.init(localBuff, bufferSize);
+	logMsg("allocated %d frames (%d bytes) for audio buffer", ringFrames, bufferSize);
+	rBuff.init(localBuff, ringFrames, streamFormat.mBytesPerFrame);
 
 	isPlaying = 0;
 	isOpen_ = 1;
@@ -133,6 +129,7 @@ void closePcm()
 	}
 	AudioOutputUnitStop(outputUnit);
 	AudioUnitUninitialize(outputUnit);
+	logMsg("%u underruns, %u overruns", rBuff.underruns, rBuff.overruns);
 	rBuff.reset();
 	mem_free(localBuff);
 	localBuff = nullptr;
@@ -148,9 +145,9 @@ bool isOpen()
 
 static void startPlaybackIfNeeded()
 {
-	if(unlikely(!isPlaying && rBuff.written >= startPlaybackBytes))
+	if(unlikely(!isPlaying && rBuff.written() >= startPlaybackFrames))
 	{
-		logMsg("playback starting with %u frames", (uint)(rBuff.written * streamFormat.mBytesPerFrame));
+		logMsg("playback starting with %u frames", rBuff.written());
 		auto err = AudioOutputUnitStart(outputUnit);
 		if(err)
 		{
@@ -167,24 +164,28 @@ void writePcm(uchar *samples, uint framesToWrite)
 		return;
 
 	//checkXRun(buffersQueued);
-	int bytes = framesToWrite * streamFormat.mBytesPerFrame;
-	buffersQueuedLock.lock();
-	auto written = rBuff.write(samples, bytes);
-	buffersQueuedLock.unlock();
-	if(written != bytes)
+	auto written = rBuff.write(samples, framesToWrite);
+	if(written != framesToWrite)
 	{
-		//logMsg("overrun, wrote %d out of %d bytes", written, bytes);
+		//logMsg("overrun, wrote %d out of %d frames", written, framesToWrite);
 	}
 
 	startPlaybackIfNeeded();
 }
 
-// TODO
-int frameDelay() { return 0; }
+// frames queued in the ring buffer, the output unit's own latency isn't counted
+int frameDelay()
+{
+	if(unlikely(!isOpen()))
+		return 0;
+	return rBuff.written();
+}
 
 int framesFree()
 {
-	return rBuff.freeSpace() * streamFormat.mBytesPerFrame;
+	if(unlikely(!isOpen()))
+		return 0;
+	return rBuff.freeSpace();
 }
 
 static void interruptionListenerCallback(void *inUserData, UInt32  interruptionState)
@@ -230,7 +231,6 @@ CallResult init()
 		logWarn("error in AudioSessionSetActive()");
 	}
 
-	buffersQueuedLock.create();
 	return OK;
 }
 
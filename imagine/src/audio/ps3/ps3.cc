@@ -56,6 +56,8 @@ CallResult openPcm(const PcmFormat &format)
 
 void writePcm(uchar *buffer, uint framesToWrite)
 {
+	if(unlikely(!pcmPlaying))
+		return;
 	uint readingBlock = *(uint64_t *)readIndexAddr;
 
 	static int debugCount = 0;
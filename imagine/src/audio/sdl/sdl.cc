@@ -27,23 +27,23 @@ PcmFormat preferredPcmFormat = { 44100, &SampleFormats::s16, 2 };
 static PcmFormat pcmFmt;
 static uint bufferFrames = 800;
 static uint buffers = 8;
-static int startPlaybackBytes = 0;
+static uint startPlaybackFrames = 0;
 static uchar *localBuff = nullptr;
-static RingBuffer<int> rBuff;
+static RingBuffer<> rBuff;
 static bool isPlaying = 0;
 
 static void audioCallback(void *userdata, Uint8 *buf, int bytes)
 {
-	int read;
-	if((read = rBuff.read(buf, bytes)) != bytes)
+	uint frames = pcmFmt.bytesToFrames(bytes), read;
+	if((read = rBuff.read(buf, frames)) != frames)
 	{
-		//logMsg("underrun, read %d out of %d bytes", read, bytes);
+		//logMsg("underrun, read %d out of %d frames", read, frames);
 	}
 
 	static int debugCount = 0;
 	if(countToValueLooped(debugCount, 120))
 	{
-		//logMsg("%d bytes in buffer", rBuff.written);
+		//logMsg("%d frames in buffer", rBuff.written());
 	}
 }
 
@@ -87,16 +87,17 @@ CallResult openPcm(const PcmFormat &format)
 	spec.samples = 1024;
 	spec.callback = audioCallback;
 	//spec.userdata = 0;
-	uint bufferSize = format.framesToBytes(bufferFrames) * buffers;
-	startPlaybackBytes = format.framesToBytes(bufferFrames) * buffers-1;
+	uint ringFrames = bufferFrames * buffers;
+	startPlaybackFrames = ringFrames - 1;
+	uint bufferSize = format.framesToBytes(ringFrames);
 	localBuff = (uchar*)mem_alloc(bufferSize);
 	if(!localBuff)
 	{
 		logMsg("error allocation audio buffer");
 		return OUT_OF_MEMORY;
 	}
-	logMsg("allocated %d for audio buffer", bufferSize);
-	rBuff.init(localBuff, bufferSize);
+	logMsg("allocated %d frames (%d bytes) for audio buffer", ringFrames, bufferSize);
+	rBuff.init(localBuff, ringFrames, format.framesToBytes(1));
 	if(SDL_OpenAudio(&spec, 0) < 0)
 	{
 		logErr("error in SDL_OpenAudio");
@@ -109,15 +110,14 @@ CallResult openPcm(const PcmFormat &format)
 
 void writePcm(uchar *buffer, uint framesToWrite)
 {
-	assert(isOpen());
-	int bytes = pcmFmt.framesToBytes(framesToWrite), written;
-	SDL_LockAudio();
-	if((written = rBuff.write(buffer, bytes)) != bytes)
+	if(unlikely(!isOpen()))
+		return;
+	uint written;
+	if((written = rBuff.write(buffer, framesToWrite)) != framesToWrite)
 	{
-		//logMsg("overrun, wrote %d out of %d bytes", written, bytes);
+		//logMsg("overrun, wrote %d out of %d frames", written, framesToWrite);
 	}
-	SDL_UnlockAudio();
-	if(!isPlaying && rBuff.written >= startPlaybackBytes)
+	if(!isPlaying && rBuff.written() >= startPlaybackFrames)
 	{
 		startPcm();
 	}
@@ -129,6 +129,7 @@ void closePcm()
 	{
 		isPlaying = 0;
 		SDL_CloseAudio();
+		logMsg("%u underruns, %u overruns", rBuff.underruns, rBuff.overruns);
 		rBuff.reset();
 		mem_free(localBuff);
 		localBuff = nullptr;
@@ -143,12 +144,16 @@ bool isOpen()
 
 int frameDelay()
 {
-	return 0; // TODO
+	if(unlikely(!isOpen()))
+		return 0;
+	return rBuff.written();
 }
 
 int framesFree()
 {
-	return pcmFmt.bytesToFrames(rBuff.freeSpace());
+	if(unlikely(!isOpen()))
+		return 0;
+	return rBuff.freeSpace();
 }
 
 CallResult init()
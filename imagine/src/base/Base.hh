@@ -71,6 +71,7 @@ void abort() ATTRS(noreturn);
 // Worker thread -> Main thread messages
 
 static const ushort MSG_START = 127, MSG_BT_SCAN_STATUS_DELEGATE = 130, MSG_ORIENTATION_CHANGE = 131,
+		MSG_FS_DIR_LISTER = 132,
 		MSG_USER = 255;
 void sendMessageToMain(ThreadPThread &thread, int type, int shortArg, int intArg, int intArg2);
 // version used when thread context isn't needed
@@ -286,6 +287,10 @@ void onExit(bool backgrounded);
 // Called on app startup, before the graphics context is initialized
 CallResult onInit(int argc, char** argv) ATTRS(cold);
 
+// Called instead of creating the app window when started with -headless as
+// the first argument (X11 and SDL), returns the process exit code
+int onHeadlessRun(int argc, char** argv) ATTRS(cold);
+
 // Called on app window creation, after the graphics context is initialized
 CallResult onWindowInit() ATTRS(cold);
 
@@ -4,6 +4,7 @@
 
 #ifdef CONFIG_FS
 	#include <fs/Fs.hh>
+	#include <fs/FsDirLister.hh>
 #endif
 
 #ifdef CONFIG_INPUT
@@ -190,6 +191,12 @@ static void processAppMsg(int type, int shortArg, int intArg, int intArg2)
 		}
 		#endif
 		#endif
+		#ifdef CONFIG_FS
+		bcase MSG_FS_DIR_LISTER:
+		{
+			FsDirLister::dispatchUpdate();
+		}
+		#endif
 		#if CONFIG_ENV_WEBOS_OS >= 3
 		bcase MSG_ORIENTATION_CHANGE:
 		{
@@ -26,6 +26,7 @@
 #include <gfx/Gfx.hh>
 #include <input/Input.hh>
 #include <logger/interface.h>
+#include <util/strings.h>
 #include <util/collection/DLList.hh>
 #include <base/Base.hh>
 #include <base/common/funcs.h>
@@ -427,6 +428,19 @@ static void eventHandler(SDL_Event &event)
 int main(int argc, char** argv)
 {
 	using namespace Base;
+	if(argc > 1 && string_equal(argv[1], "-headless"))
+	{
+		// no video or audio device, used for benchmarking
+		SDL_Init(SDL_INIT_NOPARACHUTE | SDL_INIT_TIMER);
+		logger_init();
+		#if defined(CONFIG_FS) && !defined(CONFIG_ENV_WEBOS)
+			FsSys::changeToAppDir(argv[0]);
+		#endif
+		doOrExit(onInit(argc, argv));
+		int ret = onHeadlessRun(argc, argv);
+		SDL_Quit();
+		return ret;
+	}
 	SDL_Init(SDL_INIT_VIDEO | SDL_INIT_NOPARACHUTE | SDL_INIT_TIMER
 	#ifdef CONFIG_AUDIO_SDL
 			| SDL_INIT_AUDIO
@@ -616,6 +616,13 @@ int main(int argc, char** argv)
 	FsSys::changeToAppDir(argv[0]);
 	#endif
 
+	if(argc > 1 && string_equal(argv[1], "-headless"))
+	{
+		// no X connection or window, used for benchmarking
+		doOrExit(onInit(argc, argv));
+		return onHeadlessRun(argc, argv);
+	}
+
 	initDBus();
 	ePoll = epoll_create(8);
 	if(bus)
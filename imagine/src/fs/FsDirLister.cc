@@ -0,0 +1,593 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "dirLister"
+#include <fs/FsDirLister.hh>
+#include <fs/sys.hh>
+#include <base/Base.hh>
+#include <mem/interface.h>
+#include <logger/interface.h>
+#include <util/strings.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CONFIG_FS_POSIX
+#include <util/thread/pthread.hh>
+#include <util/time/sys.hh>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#ifdef __APPLE__
+	#include <util/apple/string.h>
+#endif
+#endif
+
+namespace FsDirLister
+{
+
+// entries visible to the main thread
+static Entry *list = nullptr;
+static uint listSize = 0, listCap = 0;
+static UpdateDelegate onUpdate;
+static bool listDone = 1;
+static int generation = 0;
+
+static FsSys::cPath indexDir = "";
+
+static bool reserve(Entry *&arr, uint size, uint &cap, uint extra)
+{
+	if(size + extra <= cap)
+		return 1;
+	uint newCap = cap ? cap * 2 : 256;
+	while(newCap < size + extra)
+		newCap *= 2;
+	auto newArr = (Entry*)mem_realloc(arr, sizeof(Entry) * newCap);
+	if(!newArr)
+		return 0;
+	arr = newArr;
+	cap = newCap;
+	return 1;
+}
+
+static bool append(Entry *&arr, uint &size, uint &cap, const Entry &e)
+{
+	if(!reserve(arr, size, cap, 1))
+		return 0;
+	arr[size++] = e;
+	return 1;
+}
+
+static void freeEntries(Entry *&arr, uint &size, uint &cap)
+{
+	iterateTimes(size, i)
+	{
+		mem_free(arr[i].name);
+	}
+	mem_freeSafe(arr);
+	arr = nullptr;
+	size = cap = 0;
+}
+
+static int compareEntryName(const void *a, const void *b)
+{
+	return strcoll(((const Entry*)a)->name, ((const Entry*)b)->name);
+}
+
+static char *copyName(const char *name)
+{
+	uint size = strlen(name) + 1;
+	auto copy = (char*)mem_alloc(size);
+	if(copy)
+		memcpy(copy, name, size);
+	return copy;
+}
+
+void setIndexDir(const char *path)
+{
+	string_copy(indexDir, path);
+}
+
+uint entries()
+{
+	return listSize;
+}
+
+const Entry &entry(uint idx)
+{
+	assert(idx < listSize);
+	return list[idx];
+}
+
+bool isDone()
+{
+	return listDone;
+}
+
+#ifdef CONFIG_FS_POSIX
+
+static const char indexMagic[8] = {'I', 'G', 'D', 'I', 'R', 'I', 'X', '2'};
+static const uint maxIndexFiles = 128; // least recently used indexes past this are deleted
+static const double batchInterval = .1; // seconds between batches sent to the main thread
+
+static ThreadPThread thread;
+static MutexPThread mutex;
+static CondVarPThread requestCond;
+
+// request for the worker, guarded by mutex
+static FsSys::cPath reqPath, reqIndexDir;
+static FsDirFilterFunc reqFilter = nullptr;
+static int reqGeneration = 0;
+static bool hasRequest = 0;
+
+// entries read but not yet handed to the main thread, guarded by mutex
+static Entry *pending = nullptr;
+static uint pendingSize = 0, pendingCap = 0;
+static int pendingGeneration = 0;
+static bool pendingDone = 0, msgPosted = 0;
+
+// latest generation requested, the worker stops a listing once it changes
+static int activeGeneration = 0;
+
+static bool isCancelled(int gen)
+{
+	return __atomic_load_n(&activeGeneration, __ATOMIC_RELAXED) != gen;
+}
+
+static uint32 pathHash(const char *path)
+{
+	// FNV-1a
+	uint32 hash = 2166136261U;
+	for(; *path; path++)
+	{
+		hash ^= (uchar)*path;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static void indexPath(FsSys::cPath &path, const char *dirIndexDir, const char *dirPath)
+{
+	snprintf(path, sizeof(path), "%s/%08X.idx", dirIndexDir, pathHash(dirPath));
+}
+
+// directory mtime in nanoseconds, file systems without sub-second times give whole seconds
+static int64 dirMtimeNSecs(const struct stat &s)
+{
+	#ifdef __APPLE__
+	return (int64)s.st_mtimespec.tv_sec * 1000000000 + s.st_mtimespec.tv_nsec;
+	#else
+	return (int64)s.st_mtim.tv_sec * 1000000000 + s.st_mtim.tv_nsec;
+	#endif
+}
+
+// Reads a directory index into arr sorted by name, returns the directory mtime it was made at
+// and the wall clock second the index was written in
+static bool readIndex(const char *path, int64 &dirMtime, int64 &writeTime, Entry *&arr, uint &size, uint &cap)
+{
+	FILE *f = fopen(path, "rb");
+	if(!f)
+		return 0;
+	char magic[8];
+	uint32 count;
+	bool ok = fread(magic, 8, 1, f) == 1 && memcmp(magic, indexMagic, 8) == 0
+		&& fread(&dirMtime, 8, 1, f) == 1 && fread(&writeTime, 8, 1, f) == 1
+		&& fread(&count, 4, 1, f) == 1;
+	for(uint i = 0; ok && i < count; i++)
+	{
+		Entry e;
+		uint16 nameLen;
+		if(fread(&e.size, 8, 1, f) != 1 || fread(&e.mtime, 8, 1, f) != 1
+			|| fread(&e.type, 1, 1, f) != 1 || fread(&nameLen, 2, 1, f) != 1)
+		{
+			ok = 0;
+			break;
+		}
+		e.name = (char*)mem_alloc(nameLen + 1);
+		if(!e.name || fread(e.name, nameLen, 1, f) != 1)
+		{
+			mem_freeSafe(e.name);
+			ok = 0;
+			break;
+		}
+		e.name[nameLen] = 0;
+		if(!append(arr, size, cap, e))
+		{
+			mem_free(e.name);
+			ok = 0;
+		}
+	}
+	fclose(f);
+	if(!ok)
+	{
+		logWarn("ignoring bad index %s", path);
+		freeEntries(arr, size, cap);
+	}
+	return ok;
+}
+
+static void writeIndex(const char *path, int64 dirMtime, const Entry *arr, uint size)
+{
+	FsSys::cPath tempPath;
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+	FILE *f = fopen(tempPath, "wb");
+	if(!f)
+		return;
+	uint32 count = size;
+	int64 writeTime = time(nullptr);
+	bool ok = fwrite(indexMagic, 8, 1, f) == 1 && fwrite(&dirMtime, 8, 1, f) == 1
+		&& fwrite(&writeTime, 8, 1, f) == 1 && fwrite(&count, 4, 1, f) == 1;
+	for(uint i = 0; ok && i < size; i++)
+	{
+		auto &e = arr[i];
+		uint16 nameLen = strlen(e.name);
+		ok = fwrite(&e.size, 8, 1, f) == 1 && fwrite(&e.mtime, 8, 1, f) == 1
+			&& fwrite(&e.type, 1, 1, f) == 1 && fwrite(&nameLen, 2, 1, f) == 1
+			&& fwrite(e.name, nameLen, 1, f) == 1;
+	}
+	if(fclose(f) != 0)
+		ok = 0;
+	if(!ok || FsSys::rename(tempPath, path) != OK)
+		FsSys::remove(tempPath);
+}
+
+// Deletes the least recently used index once there are more than maxIndexFiles,
+// an index file's mtime is refreshed each time it's used
+static void trimIndexDir(const char *dirIndexDir)
+{
+	DIR *dir = opendir(dirIndexDir);
+	if(!dir)
+		return;
+	uint indexes = 0;
+	time_t oldestTime = 0;
+	FsSys::cPath path, oldestPath = "";
+	struct dirent *d;
+	while((d = readdir(dir)))
+	{
+		auto len = strlen(d->d_name);
+		if(len < 4 || !string_equal(&d->d_name[len - 4], ".idx"))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dirIndexDir, d->d_name);
+		struct stat s;
+		if(stat(path, &s) != 0)
+			continue;
+		indexes++;
+		if(!strlen(oldestPath) || s.st_mtime < oldestTime)
+		{
+			oldestTime = s.st_mtime;
+			string_copy(oldestPath, path);
+		}
+	}
+	closedir(dir);
+	if(indexes > maxIndexFiles)
+	{
+		logMsg("%u indexes, removing least recently used %s", indexes, oldestPath);
+		FsSys::remove(oldestPath);
+	}
+}
+
+static const Entry *findEntry(const Entry *arr, uint size, const char *name)
+{
+	Entry key;
+	key.name = (char*)name;
+	return (const Entry*)bsearch(&key, arr, size, sizeof(Entry), compareEntryName);
+}
+
+static void postBatch(int gen, bool done)
+{
+	mutex.lock();
+	if(pendingGeneration != gen)
+	{
+		mutex.unlock();
+		return;
+	}
+	pendingDone = done;
+	bool post = !msgPosted;
+	msgPosted = 1;
+	mutex.unlock();
+	if(post)
+		Base::sendMessageToMain(thread, Base::MSG_FS_DIR_LISTER, 0, 0, 0);
+}
+
+static void emit(int gen, FsDirFilterFunc filter, const Entry &e)
+{
+	if(filter && !filter(e.name, e.type))
+		return;
+	Entry copy = e;
+	copy.name = copyName(e.name);
+	if(!copy.name)
+		return;
+	mutex.lock();
+	if(pendingGeneration != gen || !append(pending, pendingSize, pendingCap, copy))
+		mem_free(copy.name);
+	mutex.unlock();
+}
+
+static uint8 typeFromStat(const struct stat &s)
+{
+	return S_ISDIR(s.st_mode) ? Fs::TYPE_DIR : Fs::TYPE_FILE;
+}
+
+static void listDir(const char *dirPath, const char *dirIndexDir, FsDirFilterFunc filter, int gen)
+{
+	struct stat dirStat;
+	if(stat(dirPath, &dirStat) != 0)
+	{
+		logErr("unable to stat %s", dirPath);
+		postBatch(gen, 1);
+		return;
+	}
+	FsSys::cPath idxPath = "";
+	Entry *idx = nullptr;
+	uint idxSize = 0, idxCap = 0;
+	int64 idxDirMtime = 0, idxWriteTime = 0, dirMtime = dirMtimeNSecs(dirStat);
+	if(strlen(dirIndexDir))
+	{
+		indexPath(idxPath, dirIndexDir, dirPath);
+		if(readIndex(idxPath, idxDirMtime, idxWriteTime, idx, idxSize, idxCap))
+			utimes(idxPath, nullptr); // mark as recently used
+	}
+
+	// An index written in the same second as the directory's mtime may have missed
+	// a change later in that second that a coarse file system time wouldn't show
+	if(idxSize && idxDirMtime == dirMtime && idxWriteTime > (int64)dirStat.st_mtime)
+	{
+		// directory unchanged since the index was made, nothing to read from it
+		logMsg("using index for %s, %u entries", dirPath, idxSize);
+		iterateTimes(idxSize, i)
+		{
+			emit(gen, filter, idx[i]);
+		}
+		freeEntries(idx, idxSize, idxCap);
+		postBatch(gen, 1);
+		return;
+	}
+
+	DIR *dir = opendir(dirPath);
+	if(!dir)
+	{
+		logErr("unable to open %s", dirPath);
+		freeEntries(idx, idxSize, idxCap);
+		postBatch(gen, 1);
+		return;
+	}
+	Entry *all = nullptr;
+	uint allSize = 0, allCap = 0, needsStat = 0, reused = 0;
+	FsSys::cPath path;
+	auto lastPost = TimeSys::timeNow();
+	struct dirent *d;
+	while((d = readdir(dir)) && !isCancelled(gen))
+	{
+		if(string_equal(d->d_name, ".") || string_equal(d->d_name, ".."))
+			continue;
+		Entry e {d->d_name, 0, -1, Fs::TYPE_FILE};
+		#ifdef __APPLE__
+		// precompose strings for the text renderer
+		precomposeUnicodeString(d->d_name, d->d_name, sizeof(d->d_name));
+		#endif
+		auto known = findEntry(idx, idxSize, d->d_name);
+		if(known)
+		{
+			e = *known;
+			reused++;
+		}
+		else if(d->d_type == DT_DIR)
+			e.type = Fs::TYPE_DIR;
+		else if(d->d_type == DT_UNKNOWN || d->d_type == DT_LNK)
+		{
+			// no type from the file system or a link to resolve
+			struct stat s;
+			snprintf(path, sizeof(path), "%s/%s", dirPath, d->d_name);
+			if(stat(path, &s) == 0)
+			{
+				e.type = typeFromStat(s);
+				e.size = s.st_size;
+				e.mtime = s.st_mtime;
+			}
+		}
+		e.name = d->d_name;
+		emit(gen, filter, e);
+		e.name = copyName(d->d_name);
+		if(e.name && !append(all, allSize, allCap, e))
+			mem_free(e.name);
+		if(e.mtime == -1)
+			needsStat++;
+
+		auto now = TimeSys::timeNow();
+		if(double(now - lastPost) >= batchInterval)
+		{
+			postBatch(gen, 0);
+			lastPost = now;
+		}
+	}
+	closedir(dir);
+	freeEntries(idx, idxSize, idxCap);
+	if(isCancelled(gen))
+	{
+		freeEntries(all, allSize, allCap);
+		return;
+	}
+	postBatch(gen, 1);
+	logMsg("listed %u entries in %s, %u from index", allSize, dirPath, reused);
+
+	if(strlen(idxPath))
+	{
+		// fill in metadata for new entries after the view has them, then save the index
+		iterateTimes(allSize, i)
+		{
+			if(isCancelled(gen))
+				break;
+			auto &e = all[i];
+			if(e.mtime != -1)
+				continue;
+			struct stat s;
+			snprintf(path, sizeof(path), "%s/%s", dirPath, e.name);
+			if(stat(path, &s) == 0)
+			{
+				e.size = s.st_size;
+				e.mtime = s.st_mtime;
+			}
+			else
+				e.mtime = 0;
+		}
+		if(!isCancelled(gen))
+		{
+			qsort(all, allSize, sizeof(Entry), compareEntryName);
+			writeIndex(idxPath, dirMtime, all, allSize);
+			trimIndexDir(dirIndexDir);
+		}
+	}
+	freeEntries(all, allSize, allCap);
+}
+
+static ptrsize workerLoop(ThreadPThread &thread)
+{
+	FsSys::cPath path, dirIndexDir;
+	for(;;)
+	{
+		mutex.lock();
+		while(!hasRequest)
+			requestCond.wait();
+		string_copy(path, reqPath);
+		string_copy(dirIndexDir, reqIndexDir);
+		auto filter = reqFilter;
+		int gen = reqGeneration;
+		hasRequest = 0;
+		mutex.unlock();
+		listDir(path, dirIndexDir, filter, gen);
+	}
+	return 0;
+}
+
+void start(const char *path, FsDirFilterFunc filter, UpdateDelegate onUpdate)
+{
+	clear();
+	FsDirLister::onUpdate = onUpdate;
+	listDone = 0;
+	if(!thread.running)
+	{
+		mutex.create();
+		requestCond.create(&mutex);
+		if(!thread.create(1, ThreadPThread::EntryDelegate::create<&workerLoop>()))
+		{
+			listDone = 1;
+			onUpdate.invokeSafe(1);
+			return;
+		}
+	}
+	mutex.lock();
+	string_copy(reqPath, path);
+	string_copy(reqIndexDir, indexDir);
+	reqFilter = filter;
+	reqGeneration = pendingGeneration = generation;
+	hasRequest = 1;
+	requestCond.signal();
+	mutex.unlock();
+}
+
+void clear()
+{
+	generation++;
+	__atomic_store_n(&activeGeneration, generation, __ATOMIC_RELAXED);
+	if(thread.running)
+	{
+		mutex.lock();
+		freeEntries(pending, pendingSize, pendingCap);
+		pendingGeneration = generation;
+		pendingDone = 0;
+		mutex.unlock();
+	}
+	freeEntries(list, listSize, listCap);
+	listDone = 1;
+	onUpdate = {};
+}
+
+void dispatchUpdate()
+{
+	// a message from a cancelled listing may carry a batch of the current one,
+	// which skipped posting its own while that message was outstanding
+	mutex.lock();
+	msgPosted = 0;
+	if(pendingGeneration != generation)
+	{
+		mutex.unlock();
+		return;
+	}
+	bool done = pendingDone;
+	if(pendingSize && reserve(list, listSize, listCap, pendingSize))
+	{
+		// merge the sorted batch in from the end so shown entries keep their order
+		qsort(pending, pendingSize, sizeof(Entry), compareEntryName);
+		int i = listSize - 1, j = pendingSize - 1;
+		listSize += pendingSize;
+		for(int k = listSize - 1; j >= 0; k--)
+		{
+			if(i >= 0 && compareEntryName(&list[i], &pending[j]) > 0)
+				list[k] = list[i--];
+			else
+				list[k] = pending[j--];
+		}
+	}
+	else
+	{
+		iterateTimes(pendingSize, i)
+		{
+			mem_free(pending[i].name);
+		}
+	}
+	pendingSize = 0;
+	mutex.unlock();
+	if(done)
+		listDone = 1;
+	onUpdate.invokeSafe(done);
+}
+
+#else
+
+void start(const char *path, FsDirFilterFunc filter, UpdateDelegate onUpdate)
+{
+	clear();
+	FsDirLister::onUpdate = onUpdate;
+	FsSys dir;
+	if(dir.openDir(path, 0, filter) == OK)
+	{
+		iterateTimes(dir.numEntries(), i)
+		{
+			FsSys::cPath entryPath;
+			snprintf(entryPath, sizeof(entryPath), "%s/%s", path, dir.entryFilename(i));
+			Entry e {copyName(dir.entryFilename(i)), 0, 0, (uint8)FsSys::fileType(entryPath)};
+			if(e.name && !append(list, listSize, listCap, e))
+				mem_free(e.name);
+		}
+		dir.closeDir();
+	}
+	qsort(list, listSize, sizeof(Entry), compareEntryName);
+	listDone = 1;
+	onUpdate.invokeSafe(1);
+}
+
+void clear()
+{
+	generation++;
+	freeEntries(list, listSize, listCap);
+	listDone = 1;
+	onUpdate = {};
+}
+
+void dispatchUpdate() { }
+
+#endif
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+#include <fs/Fs.hh>
+#include <util/Delegate.hh>
+
+// Lists a directory on a worker thread, handing entries to the main thread in batches
+// as they're read so a view can show them before the listing completes. Entry types
+// come from d_type and only fall back to stat() when the file system doesn't supply it.
+// If an index directory is set, each listing is saved there with entry sizes and times,
+// and the next listing of an unchanged directory is served from the index without
+// reading it, while a changed one only stats entries the index doesn't already have.
+// Only the most recently used indexes are kept.
+// Without POSIX file system support, listings run synchronously through FsSys.
+namespace FsDirLister
+{
+
+struct Entry
+{
+	char *name;
+	uint64 size;
+	int64 mtime; // -1 if not known yet
+	uint8 type; // Fs::TYPE_*
+};
+
+// called on the main thread after new entries arrive, each batch is merged in
+// by name so entries stay sorted, done is set once the listing is complete
+typedef Delegate<void (bool done)> UpdateDelegate;
+
+void setIndexDir(const char *path);
+
+// starts listing path, cancelling any listing in progress and clearing its entries,
+// path should be absolute since the working directory may change while it runs
+void start(const char *path, FsDirFilterFunc filter, UpdateDelegate onUpdate);
+
+// stops the listing in progress and frees all entries
+void clear();
+
+uint entries();
+const Entry &entry(uint idx);
+bool isDone();
+
+// called by the main thread's message handler when a batch is waiting
+void dispatchUpdate();
+
+}
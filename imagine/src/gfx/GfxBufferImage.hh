@@ -57,6 +57,20 @@ struct TextureBufferImage:
 	const TextureDesc &textureDesc() const { return *this; };
 	TextureDesc &textureDesc() { return *this; };
 	bool isInit() { return tid != 0; }
+
+	#ifndef CONFIG_GFX_OPENGL_ES
+	// ring of pixel buffer objects used to stream frames to the texture,
+	// the driver copies from the PBO asynchronously instead of stalling on glTexSubImage2D
+	static const uint pbos = 2;
+	GLuint pbo[pbos] {0};
+	uint nextPbo = 0;
+	Pixmap pboPix {PixelFormatRGB565}; // mapped PBO returned by lock()
+	void initPBOs();
+	void deinitPBOs();
+	void *mapPBO(uint bytes);
+	void writePBO(Pixmap &p, uint hints);
+	void unmapAndWritePBO(Pixmap &p, uint hints);
+	#endif
 };
 
 struct TextureBufferVImpl
@@ -90,7 +90,10 @@ void renderFrame(Gfx::FrameTimeBase frameTime)
 		if(unlikely(glSyncHackEnabled)) glFinish();
 	#endif
 
-	Base::openGLUpdateScreen();
+	{
+		TRACE_SCOPE("swap");
+		Base::openGLUpdateScreen();
+	}
 
 	/*#if defined(CONFIG_GFX_OPENGL_ES) && defined(CONFIG_BASE_IOS)
 	if(useDiscardFramebufferEXT)
@@ -89,6 +89,11 @@
 	#endif
 #endif
 
+#if defined CONFIG_GFX_OPENGL_ES && !defined GL_UNPACK_ROW_LENGTH_EXT
+	// from GL_EXT_unpack_subimage, missing in ES 1 headers
+	#define GL_UNPACK_ROW_LENGTH_EXT 0x0CF2
+#endif
+
 #if defined CONFIG_BASE_ANDROID
 	// Android is missing GL_BGRA in ES 1 headers
 	#define GL_BGRA 0x80E1
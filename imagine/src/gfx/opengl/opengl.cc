@@ -20,6 +20,7 @@
 #include <mem/interface.h>
 #include <base/Base.hh>
 #include <util/number.h>
+#include <trace/Trace.hh>
 
 #if defined(CONFIG_RESOURCE_IMAGE)
 #include <resource2/image/ResourceImage.h>
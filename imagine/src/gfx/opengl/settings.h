@@ -383,6 +383,36 @@ static void checkForVBO(const char *version, bool hasGL1_5)
 	}
 }
 
+static uchar usePBOFuncs = 0;
+static uchar forceNoPBOFuncs = 0;
+
+static void checkForPBO(const char *extensions)
+{
+	#ifndef CONFIG_GFX_OPENGL_ES
+	if(!forceNoPBOFuncs && strstr(extensions, "GL_ARB_pixel_buffer_object"))
+	{
+		usePBOFuncs = 1;
+		logMsg("PBOs are supported");
+	}
+	#endif
+}
+
+static uchar useUnpackRowLength = 0;
+static uchar forceNoUnpackRowLength = 0;
+
+static void checkForUnpackRowLength(const char *extensions)
+{
+	#if !defined CONFIG_GFX_OPENGL_ES
+	useUnpackRowLength = 1; // core since OpenGL 1.0
+	#elif !defined CONFIG_BASE_PS3
+	if(!forceNoUnpackRowLength && strstr(extensions, "GL_EXT_unpack_subimage"))
+	{
+		useUnpackRowLength = 1;
+		logMsg("unpack sub-image is supported");
+	}
+	#endif
+}
+
 #if defined CONFIG_BASE_ANDROID && defined CONFIG_GFX_OPENGL_USE_DRAW_TEXTURE
 
 static bool useDrawTex = 0;
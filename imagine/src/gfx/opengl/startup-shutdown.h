@@ -96,6 +96,8 @@ CallResult setOutputVideoMode(const Base::Window &win)
 	checkForCompressedTexturesSupport(hasGL1_3);
 	checkForFBOFuncs(extensions);
 	checkForVBO(version, hasGL1_5);
+	checkForPBO(extensions);
+	checkForUnpackRowLength(extensions);
 	if(useFBOFuncs) useAutoMipmapGeneration = 0; // prefer FBO mipmap function if present
 
 	/*#ifdef CONFIG_GFX_OPENGL_ES
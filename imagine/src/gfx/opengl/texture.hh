@@ -230,6 +230,17 @@ static void setDefaultImageTextureParams(uint imgFilter, uchar mipmapType, int x
 	//glTexParameterfv(target, GL_TEXTURE_BORDER_COLOR, col);
 }
 
+// true if a texture created with these hints is as wide as its pixmap's pitch,
+// OpenGL ES streams only need that when rows can't be unpacked with a pitch
+static bool textureIncludesPadding(uint hints)
+{
+	#ifdef CONFIG_GFX_OPENGL_ES
+	return (hints & BufferImage::HINT_STREAM) && !useUnpackRowLength;
+	#else
+	return hints;
+	#endif
+}
+
 static uint writeGLTexture(Pixmap &pix, bool includePadding, GLenum target)
 {
 	//logMsg("writeGLTexture");
@@ -260,6 +271,17 @@ static uint writeGLTexture(Pixmap &pix, bool includePadding, GLenum target)
 				return 0;
 			}
 		}
+		else if(useUnpackRowLength)
+		{
+			glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, pix.pitchPixels());
+			glTexSubImage2D(target, 0, 0, 0,
+					pix.x, pix.y, format, dataType, pix.data);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+			if(handleGLErrors([](GLenum, const char *err) { logErr("%s in glTexSubImage2D", err); }))
+			{
+				return 0;
+			}
+		}
 		else
 		{
 			logWarn("OGL ES slow glTexSubImage2D case");
@@ -301,9 +323,18 @@ static uint replaceGLTexture(Pixmap &pix, bool upload, uint internalFormat, bool
 	uint xSize = includePadding ? pix.pitchPixels() : pix.x;
 	if(includePadding && pix.pitchPixels() != pix.x)
 		logMsg("including padding in texture size, %d", pix.pitchPixels());
+	#ifdef CONFIG_GFX_OPENGL_ES
+	bool unpackPitch = upload && !includePadding && pix.isPadded() && useUnpackRowLength;
+	if(unpackPitch)
+		glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, pix.pitchPixels());
+	#endif
 	handleGLErrors();
 	glTexImage2D(target, 0, internalFormat, xSize, pix.y,
 				0, format, dataType, upload ? pix.data : 0);
+	#ifdef CONFIG_GFX_OPENGL_ES
+	if(unpackPitch)
+		glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+	#endif
 	if(handleGLErrors([](GLenum, const char *err) { logErr("%s in glTexImage2D", err); }))
 	{
 		return 0;
@@ -363,10 +394,72 @@ void BufferImage::setRepeatMode(uint xMode, uint yMode)
 		logWarn("error with wrap t %d", wrapT);
 }
 
+#ifndef CONFIG_GFX_OPENGL_ES
+void TextureBufferImage::initPBOs()
+{
+	glGenBuffers(pbos, pbo);
+	nextPbo = 0;
+	logMsg("streaming texture through %d PBOs", pbos);
+}
+
+void TextureBufferImage::deinitPBOs()
+{
+	if(!pbo[0])
+		return;
+	glDeleteBuffers(pbos, pbo);
+	mem_zero(pbo);
+}
+
+void *TextureBufferImage::mapPBO(uint bytes)
+{
+	glState_bindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, pbo[nextPbo]);
+	// orphan the old storage so mapping doesn't wait on the previous upload
+	glBufferData(GL_PIXEL_UNPACK_BUFFER_ARB, bytes, nullptr, GL_STREAM_DRAW);
+	auto buff = glMapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY);
+	if(unlikely(!buff))
+	{
+		logWarn("unable to map PBO, using direct texture uploads");
+		glState_bindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+		deinitPBOs();
+	}
+	return buff;
+}
+
+void TextureBufferImage::unmapAndWritePBO(Pixmap &p, uint hints)
+{
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB);
+	Pixmap uploadPix = p;
+	uploadPix.data = nullptr; // offset into the bound PBO
+	writeGLTexture(uploadPix, textureIncludesPadding(hints), GL_TEXTURE_2D);
+	glState_bindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+	nextPbo = (nextPbo + 1) % pbos;
+}
+
+void TextureBufferImage::writePBO(Pixmap &p, uint hints)
+{
+	uint bytes = p.pitch * p.y;
+	auto buff = mapPBO(bytes);
+	if(!buff)
+	{
+		writeGLTexture(p, textureIncludesPadding(hints), GL_TEXTURE_2D);
+		return;
+	}
+	memcpy(buff, p.data, bytes);
+	unmapAndWritePBO(p, hints);
+}
+#endif
+
 void TextureBufferImage::write(Pixmap &p, uint hints)
 {
 	glcBindTexture(GL_TEXTURE_2D, tid);
-	writeGLTexture(p, hints, GL_TEXTURE_2D);
+	#ifndef CONFIG_GFX_OPENGL_ES
+	if(pbo[0])
+	{
+		writePBO(p, hints);
+		return;
+	}
+	#endif
+	writeGLTexture(p, textureIncludesPadding(hints), GL_TEXTURE_2D);
 
 	#ifdef CONFIG_BASE_ANDROID
 		if(unlikely(glSyncHackEnabled)) glFinish();
@@ -376,15 +469,46 @@ void TextureBufferImage::write(Pixmap &p, uint hints)
 void TextureBufferImage::replace(Pixmap &p, uint hints)
 {
 	glcBindTexture(GL_TEXTURE_2D, tid);
-	replaceGLTexture(p, 1, pixelToOGLInternalFormat(p.format), hints, GL_TEXTURE_2D);
+	replaceGLTexture(p, 1, pixelToOGLInternalFormat(p.format), textureIncludesPadding(hints), GL_TEXTURE_2D);
 }
 
-Pixmap *TextureBufferImage::lock(uint x, uint y, uint xlen, uint ylen, Pixmap *fallback) { return fallback; }
+Pixmap *TextureBufferImage::lock(uint x, uint y, uint xlen, uint ylen, Pixmap *fallback)
+{
+	#ifndef CONFIG_GFX_OPENGL_ES
+	if(pbo[0] && fallback && !x && !y)
+	{
+		// render straight into the next PBO, it's uploaded from there on unlock()
+		glcBindTexture(GL_TEXTURE_2D, tid);
+		new(&pboPix) Pixmap(fallback->format);
+		auto buff = mapPBO(pboPix.sizeOfNumPixels(xlen * ylen));
+		if(buff)
+		{
+			pboPix.init((uchar*)buff, xlen, ylen);
+			return &pboPix;
+		}
+	}
+	#endif
+	return fallback;
+}
 
-void TextureBufferImage::unlock(Pixmap *pix, uint hints) { write(*pix, hints); }
+void TextureBufferImage::unlock(Pixmap *pix, uint hints)
+{
+	#ifndef CONFIG_GFX_OPENGL_ES
+	if(pix == &pboPix)
+	{
+		glcBindTexture(GL_TEXTURE_2D, tid);
+		unmapAndWritePBO(*pix, hints);
+		return;
+	}
+	#endif
+	write(*pix, hints);
+}
 
 void TextureBufferImage::deinit()
 {
+	#ifndef CONFIG_GFX_OPENGL_ES
+	deinitPBOs();
+	#endif
 	freeTexRef(tid);
 	tid = 0;
 }
@@ -458,7 +582,10 @@ bool BufferImage::setupTexture(Pixmap &pix, bool upload, uint internalFormat, in
 		}
 		#endif
 		#ifdef CONFIG_GFX_OPENGL_ES
-		includePadding = 1; // avoid slow OpenGL ES upload case
+		includePadding = textureIncludesPadding(hints); // avoid slow OpenGL ES upload case
+		#else
+		if(usePBOFuncs)
+			initPBOs();
 		#endif
 	}
 
@@ -608,7 +735,11 @@ CallResult BufferImage::init(Pixmap &pix, bool upload, uint filter, uint hints,
 	return OK;
 }
 
-void BufferImage::write(Pixmap &p) { BufferImageImpl::write(p, hints); }
+void BufferImage::write(Pixmap &p)
+{
+	TRACE_SCOPE("BufferImage::write");
+	BufferImageImpl::write(p, hints);
+}
 void BufferImage::replace(Pixmap &p)
 {
 	BufferImageImpl::replace(p, hints);
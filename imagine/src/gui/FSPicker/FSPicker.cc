@@ -99,6 +99,7 @@ void FSPicker::init(const char *path, ResourceImage *backRes, ResourceImage *clo
 	singleDir = 1; // stay in Documents dir when not in jailbreak environment
 	#endif
 	text = 0;
+	highlightFirstOnLoad = 0;
 	faceRes = face;
 	var_selfs(filter);
 	var_selfs(singleDir);
@@ -108,7 +109,7 @@ void FSPicker::init(const char *path, ResourceImage *backRes, ResourceImage *clo
 
 void FSPicker::deinit()
 {
-	dir.closeDir();
+	FsDirLister::clear();
 	delete[] text;
 	navV.deinit();
 	tbl.cells = 0;
@@ -136,9 +137,8 @@ void FSPicker::place()
 
 void FSPicker::changeDirByInput(const char *path, const Input::Event &e)
 {
+	highlightFirstOnLoad = !e.isPointer();
 	loadDir(path);
-	if(!e.isPointer() && tbl.cells)
-		tbl.selected = 0;
 	place();
 	Base::displayNeedsUpdate();
 }
@@ -198,17 +198,20 @@ void FSPicker::drawElement(const GuiTable1D *table, uint i, Coordinate xPos, Coo
 
 void FSPicker::onSelectElement(const GuiTable1D *table, const Input::Event &e, uint i)
 {
-	assert(i < dir.numEntries());
-	if(FsSys::fileType(dir.entryFilename(i)) == Fs::TYPE_DIR)
+	assert(i < FsDirLister::entries());
+	auto &entry = FsDirLister::entry(i);
+	if(entry.type == Fs::TYPE_DIR)
 	{
 		assert(!singleDir);
-		logMsg("going to dir %s", dir.entryFilename(i));
-		changeDirByInput(dir.entryFilename(i), e);
+		logMsg("going to dir %s", entry.name);
+		// copy the name since changing directory frees the listing
+		FsSys::cPath name;
+		string_copy(name, entry.name);
+		changeDirByInput(name, e);
 	}
 	else
 	{
-		//onSelectFile(dir.entryFilename(i));
-		onSelectFile.invokeSafe(dir.entryFilename(i), e);
+		onSelectFile.invokeSafe(entry.name, e);
 	}
 }
 
@@ -216,26 +219,62 @@ void FSPicker::loadDir(const char *path)
 {
 	assert(path);
 	FsSys::chdir(path);
-	dir.openDir(".", 0, filter);
-	logMsg("%d entries", dir.numEntries());
-	if(dir.numEntries())
+	// entries stream in from the lister, which reports them through onDirUpdate()
+	tbl.init(this, 0);
+	FsDirLister::start(FsSys::workDir(), filter,
+		FsDirLister::UpdateDelegate::create<FSPicker, &FSPicker::onDirUpdate>(this));
+	#if defined(CONFIG_BASE_IOS) && !defined(CONFIG_BASE_IOS_JB)
+	navV.setTitle("Documents");
+	#else
+	navV.setTitle(FsSys::workDir());
+	#endif
+}
+
+void FSPicker::onDirUpdate(bool done)
+{
+	uint entries = FsDirLister::entries();
+	if(done)
+		logMsg("%d entries", entries);
+	uint shown = tbl.cells;
+	if(entries > shown)
 	{
-		// TODO free old pointer on failure
-		text = realloc(text, dir.numEntries());
-		if(!text)
+		// realloc() would reconstruct the shown items, only construct the new ones below
+		auto newText = (TextMenuItem*)mem_realloc(text, sizeof(TextMenuItem) * entries);
+		if(!newText)
 		{
 			logMsg("out of memory loading directory");
 			Base::exit(); // TODO: handle without exiting
 		}
-		iterateTimes(dir.numEntries(), i)
+		text = newText;
+		// new entries were merged in by name, move the shown items to their
+		// new positions from the end and only init the new ones
+		int j = shown - 1;
+		for(int i = entries - 1; i >= 0; i--)
 		{
-			text[i].init(dir.entryFilename(i), 1, faceRes);
+			auto name = FsDirLister::entry(i).name;
+			if(j >= 0 && text[j].t.str == name)
+			{
+				if(i != j)
+					memcpy((void*)&text[i], (void*)&text[j], sizeof(TextMenuItem));
+				if(tbl.selected == j)
+					tbl.selected = i;
+				j--;
+			}
+			else
+			{
+				new(&text[i]) TextMenuItem();
+				text[i].init(name, 1, faceRes);
+			}
 		}
 	}
-	tbl.init(this, dir.numEntries());
-	#if defined(CONFIG_BASE_IOS) && !defined(CONFIG_BASE_IOS_JB)
-	navV.setTitle("Documents");
-	#else
-	navV.setTitle(FsSys::workDir());
-	#endif
+	// keep the selection and scroll position while entries arrive
+	tbl.cells = entries;
+	if(tbl.selected >= (int)entries)
+		tbl.selected = entries ? entries - 1 : -1;
+	if(highlightFirstOnLoad && tbl.selected == -1 && entries)
+		tbl.selected = 0;
+	if(done)
+		highlightFirstOnLoad = 0;
+	place();
+	Base::displayNeedsUpdate();
 }
@@ -6,6 +6,7 @@
 #include <util/rectangle2.h>
 #include <input/Input.hh>
 #include <fs/sys.hh>
+#include <fs/FsDirLister.hh>
 #include <resource2/face/ResourceFace.hh>
 #include <gui/GuiTable1D/GuiTable1D.hh>
 #include <gui/MenuItem/MenuItem.hh>
@@ -62,9 +63,9 @@ public:
 	}
 
 	ScrollableGuiTable1D tbl;
+	bool highlightFirstOnLoad = 0; // select the first entry once the listing has one
 private:
 	TextMenuItem *text = nullptr;
-	FsSys dir;
 	Rect2<int> viewFrame;
 	ResourceFace *faceRes = nullptr;
 	FSNavView navV { NavView::OnInputDelegate::create<FSPicker, &FSPicker::onLeftNavBtn>(this),
@@ -72,5 +73,6 @@ private:
 	bool singleDir = 0;
 
 	void loadDir(const char *path);
+	void onDirUpdate(bool done);
 	void changeDirByInput(const char *path, const Input::Event &e);
 };
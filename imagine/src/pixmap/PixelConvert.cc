@@ -0,0 +1,743 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "pixconv"
+#include <pixmap/PixelConvert.hh>
+#include <pixmap/Pixmap.hh>
+#include <logger/interface.h>
+#include <string.h>
+
+#if defined __SSE2__
+	#define CONFIG_PIXCONV_SSE2
+	#include <emmintrin.h>
+	#if (defined __GNUC__ && !defined __clang__ && __GNUC__ * 100 + __GNUC_MINOR__ >= 409) || \
+		(defined __clang__ && __clang_major__ * 100 + __clang_minor__ >= 308)
+		// AVX2 kernels are built with a target attribute and only used if the CPU has it
+		#define CONFIG_PIXCONV_AVX2
+		#include <immintrin.h>
+	#endif
+#endif
+#if defined __ARM_NEON__ || defined __ARM_NEON
+	#define CONFIG_PIXCONV_NEON
+	#include <arm_neon.h>
+#endif
+
+namespace PixelConvert
+{
+
+typedef void (*RowFunc)(const void *src, void *dest, uint pixels);
+typedef void (*Expand16Func)(const uint8 *src, uint16 *dest, const uint16 *palette, uint pixels);
+typedef void (*Expand32Func)(const uint8 *src, uint32 *dest, const uint32 *palette, uint pixels);
+
+struct Kernels
+{
+	const char *name;
+	RowFunc rgb565ToRGBA8888, rgb565ToBGRA8888;
+	RowFunc argb1555ToRGB565, rgb565ToARGB1555;
+	RowFunc swapRB8888; // RGBA8888 <-> BGRA8888
+	RowFunc rgba8888ToRGB565, bgra8888ToRGB565;
+	Expand16Func expand16;
+	Expand32Func expand32;
+};
+
+// generic scalar path
+
+static uint expandTo8Bits(uint val, uint bits)
+{
+	switch(bits)
+	{
+		case 0: return 0xFF;
+		case 1: return val ? 0xFF : 0;
+		case 8: return val;
+		default: return (val << (8 - bits)) | (val >> (2 * bits - 8));
+	}
+}
+
+static bool isByteOrderFormat(const PixelFormatDesc &format)
+{
+	return format.bytesPerPixel >= 3;
+}
+
+static void readPixel(const PixelFormatDesc &format, const uchar *p, uint &r, uint &g, uint &b, uint &a)
+{
+	uint pixel;
+	if(isByteOrderFormat(format))
+	{
+		pixel = 0;
+		iterateTimes(format.bytesPerPixel, i)
+		{
+			pixel = (pixel << 8) | p[i];
+		}
+	}
+	else
+		pixel = *(const uint16*)p;
+	r = expandTo8Bits(format.r(pixel), format.rBits);
+	g = expandTo8Bits(format.g(pixel), format.gBits);
+	b = expandTo8Bits(format.b(pixel), format.bBits);
+	a = expandTo8Bits(format.a(pixel), format.aBits);
+}
+
+static void writePixel(const PixelFormatDesc &format, uchar *p, uint r, uint g, uint b, uint a)
+{
+	uint pixel = format.build(r >> (8 - format.rBits), g >> (8 - format.gBits),
+		b >> (8 - format.bBits), format.aBits ? a >> (8 - format.aBits) : 0);
+	if(isByteOrderFormat(format))
+	{
+		for(int i = format.bytesPerPixel - 1; i >= 0; i--)
+		{
+			p[i] = pixel;
+			pixel >>= 8;
+		}
+	}
+	else
+		*(uint16*)p = pixel;
+}
+
+static void convertRowGeneric(const PixelFormatDesc &srcFormat, const void *srcPtr,
+	const PixelFormatDesc &destFormat, void *destPtr, uint pixels)
+{
+	auto src = (const uchar*)srcPtr;
+	auto dest = (uchar*)destPtr;
+	iterateTimes(pixels, i)
+	{
+		uint r, g, b, a;
+		readPixel(srcFormat, src, r, g, b, a);
+		writePixel(destFormat, dest, r, g, b, a);
+		src += srcFormat.bytesPerPixel;
+		dest += destFormat.bytesPerPixel;
+	}
+}
+
+// scalar kernels, also handle the leftover pixels of the SIMD versions
+
+static void rgb565To8888(const uint16 *src, uchar *dest, uint pixels, uint rIdx, uint bIdx)
+{
+	iterateTimes(pixels, i)
+	{
+		uint p = src[i];
+		uint r = p >> 11, g = (p >> 5) & 0x3F, b = p & 0x1F;
+		dest[rIdx] = (r << 3) | (r >> 2);
+		dest[1] = (g << 2) | (g >> 4);
+		dest[bIdx] = (b << 3) | (b >> 2);
+		dest[3] = 0xFF;
+		dest += 4;
+	}
+}
+
+static void rgb565ToRGBA8888(const void *src, void *dest, uint pixels)
+{
+	rgb565To8888((const uint16*)src, (uchar*)dest, pixels, 0, 2);
+}
+
+static void rgb565ToBGRA8888(const void *src, void *dest, uint pixels)
+{
+	rgb565To8888((const uint16*)src, (uchar*)dest, pixels, 2, 0);
+}
+
+static void argb1555ToRGB565(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uint16*)srcPtr;
+	auto dest = (uint16*)destPtr;
+	iterateTimes(pixels, i)
+	{
+		uint p = src[i];
+		dest[i] = ((p & 0x7FE0) << 1) | ((p >> 4) & 0x20) | (p & 0x1F);
+	}
+}
+
+static void rgb565ToARGB1555(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uint16*)srcPtr;
+	auto dest = (uint16*)destPtr;
+	iterateTimes(pixels, i)
+	{
+		uint p = src[i];
+		dest[i] = 0x8000 | ((p >> 1) & 0x7FE0) | (p & 0x1F);
+	}
+}
+
+static void swapRB8888(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uchar*)srcPtr;
+	auto dest = (uchar*)destPtr;
+	iterateTimes(pixels, i)
+	{
+		uchar c0 = src[0], c2 = src[2];
+		dest[0] = c2;
+		dest[1] = src[1];
+		dest[2] = c0;
+		dest[3] = src[3];
+		src += 4;
+		dest += 4;
+	}
+}
+
+static void x8888ToRGB565(const uchar *src, uint16 *dest, uint pixels, uint rIdx, uint bIdx)
+{
+	iterateTimes(pixels, i)
+	{
+		dest[i] = ((src[rIdx] & 0xF8) << 8) | ((src[1] & 0xFC) << 3) | (src[bIdx] >> 3);
+		src += 4;
+	}
+}
+
+static void rgba8888ToRGB565(const void *src, void *dest, uint pixels)
+{
+	x8888ToRGB565((const uchar*)src, (uint16*)dest, pixels, 0, 2);
+}
+
+static void bgra8888ToRGB565(const void *src, void *dest, uint pixels)
+{
+	x8888ToRGB565((const uchar*)src, (uint16*)dest, pixels, 2, 0);
+}
+
+template <class T>
+static void expandIndexedScalar(const uint8 *src, T *dest, const T *palette, uint pixels)
+{
+	uint blocks = pixels / 4;
+	iterateTimes(blocks, i)
+	{
+		// independent loads so the lookups can overlap
+		T p0 = palette[src[0]], p1 = palette[src[1]], p2 = palette[src[2]], p3 = palette[src[3]];
+		dest[0] = p0; dest[1] = p1; dest[2] = p2; dest[3] = p3;
+		src += 4;
+		dest += 4;
+	}
+	iterateTimes(pixels % 4, i)
+	{
+		dest[i] = palette[src[i]];
+	}
+}
+
+static void expand16Scalar(const uint8 *src, uint16 *dest, const uint16 *palette, uint pixels)
+{
+	expandIndexedScalar(src, dest, palette, pixels);
+}
+
+static void expand32Scalar(const uint8 *src, uint32 *dest, const uint32 *palette, uint pixels)
+{
+	expandIndexedScalar(src, dest, palette, pixels);
+}
+
+static const Kernels scalarKernels
+{
+	"scalar",
+	rgb565ToRGBA8888, rgb565ToBGRA8888,
+	argb1555ToRGB565, rgb565ToARGB1555,
+	swapRB8888,
+	rgba8888ToRGB565, bgra8888ToRGB565,
+	expand16Scalar, expand32Scalar
+};
+
+#ifdef CONFIG_PIXCONV_SSE2
+
+// 8 RGB565 pixels to 16-bit lanes of 8-bit components
+static void unpackRGB565SSE2(__m128i p, __m128i &r, __m128i &g, __m128i &b)
+{
+	r = _mm_srli_epi16(p, 11);
+	g = _mm_and_si128(_mm_srli_epi16(p, 5), _mm_set1_epi16(0x3F));
+	b = _mm_and_si128(p, _mm_set1_epi16(0x1F));
+	r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+	g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+	b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+}
+
+template <bool bgr>
+static void rgb565To8888SSE2(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uint16*)srcPtr;
+	auto dest = (uchar*)destPtr;
+	const __m128i alpha = _mm_set1_epi16(0xFF00);
+	uint blocks = pixels / 8;
+	iterateTimes(blocks, i)
+	{
+		__m128i r, g, b;
+		unpackRGB565SSE2(_mm_loadu_si128((const __m128i*)src), r, g, b);
+		// low 16 bits hold the 1st & 2nd bytes, high 16 bits the 3rd & 4th
+		__m128i lo16 = _mm_or_si128(bgr ? b : r, _mm_slli_epi16(g, 8));
+		__m128i hi16 = _mm_or_si128(bgr ? r : b, alpha);
+		_mm_storeu_si128((__m128i*)dest, _mm_unpacklo_epi16(lo16, hi16));
+		_mm_storeu_si128((__m128i*)(dest + 16), _mm_unpackhi_epi16(lo16, hi16));
+		src += 8;
+		dest += 32;
+	}
+	rgb565To8888(src, dest, pixels % 8, bgr ? 2 : 0, bgr ? 0 : 2);
+}
+
+static void argb1555ToRGB565SSE2(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uint16*)srcPtr;
+	auto dest = (uint16*)destPtr;
+	uint blocks = pixels / 8;
+	iterateTimes(blocks, i)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)src);
+		__m128i rg = _mm_slli_epi16(_mm_and_si128(p, _mm_set1_epi16(0x7FE0)), 1);
+		__m128i gLow = _mm_and_si128(_mm_srli_epi16(p, 4), _mm_set1_epi16(0x20));
+		__m128i b = _mm_and_si128(p, _mm_set1_epi16(0x1F));
+		_mm_storeu_si128((__m128i*)dest, _mm_or_si128(_mm_or_si128(rg, gLow), b));
+		src += 8;
+		dest += 8;
+	}
+	argb1555ToRGB565(src, dest, pixels % 8);
+}
+
+static void rgb565ToARGB1555SSE2(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uint16*)srcPtr;
+	auto dest = (uint16*)destPtr;
+	uint blocks = pixels / 8;
+	iterateTimes(blocks, i)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)src);
+		__m128i rg = _mm_and_si128(_mm_srli_epi16(p, 1), _mm_set1_epi16(0x7FE0));
+		__m128i ab = _mm_or_si128(_mm_and_si128(p, _mm_set1_epi16(0x1F)), _mm_set1_epi16(0x8000));
+		_mm_storeu_si128((__m128i*)dest, _mm_or_si128(rg, ab));
+		src += 8;
+		dest += 8;
+	}
+	rgb565ToARGB1555(src, dest, pixels % 8);
+}
+
+static void swapRB8888SSE2(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uchar*)srcPtr;
+	auto dest = (uchar*)destPtr;
+	uint blocks = pixels / 4;
+	iterateTimes(blocks, i)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)src);
+		__m128i ga = _mm_and_si128(p, _mm_set1_epi32(0xFF00FF00));
+		__m128i rb = _mm_and_si128(p, _mm_set1_epi32(0x00FF00FF));
+		rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+		_mm_storeu_si128((__m128i*)dest, _mm_or_si128(ga, rb));
+		src += 16;
+		dest += 16;
+	}
+	swapRB8888(src, dest, pixels % 4);
+}
+
+// 4 pixels in 32-bit lanes to RGB565 values in the low 16 bits
+template <bool bgr>
+static __m128i pack8888To565Lanes(__m128i p)
+{
+	__m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x7E0));
+	__m128i r, b;
+	if(bgr)
+	{
+		r = _mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xF800));
+		b = _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x1F));
+	}
+	else
+	{
+		r = _mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xF8)), 8);
+		b = _mm_and_si128(_mm_srli_epi32(p, 19), _mm_set1_epi32(0x1F));
+	}
+	__m128i v = _mm_or_si128(_mm_or_si128(r, g), b);
+	// sign extend so the saturating pack keeps all 16 bits
+	return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+template <bool bgr>
+static void x8888ToRGB565SSE2(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uchar*)srcPtr;
+	auto dest = (uint16*)destPtr;
+	uint blocks = pixels / 8;
+	iterateTimes(blocks, i)
+	{
+		__m128i lo = pack8888To565Lanes<bgr>(_mm_loadu_si128((const __m128i*)src));
+		__m128i hi = pack8888To565Lanes<bgr>(_mm_loadu_si128((const __m128i*)(src + 16)));
+		_mm_storeu_si128((__m128i*)dest, _mm_packs_epi32(lo, hi));
+		src += 32;
+		dest += 8;
+	}
+	x8888ToRGB565(src, dest, pixels % 8, bgr ? 2 : 0, bgr ? 0 : 2);
+}
+
+static const Kernels sse2Kernels
+{
+	"SSE2",
+	rgb565To8888SSE2<0>, rgb565To8888SSE2<1>,
+	argb1555ToRGB565SSE2, rgb565ToARGB1555SSE2,
+	swapRB8888SSE2,
+	x8888ToRGB565SSE2<0>, x8888ToRGB565SSE2<1>,
+	expand16Scalar, expand32Scalar // table lookups don't vectorize on SSE2
+};
+
+#endif
+
+#ifdef CONFIG_PIXCONV_AVX2
+
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+template <bool bgr>
+AVX2_FUNC static void rgb565To8888AVX2(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uint16*)srcPtr;
+	auto dest = (uchar*)destPtr;
+	const __m256i alpha = _mm256_set1_epi16(0xFF00);
+	uint blocks = pixels / 16;
+	iterateTimes(blocks, i)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*)src);
+		__m256i r = _mm256_srli_epi16(p, 11);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi16(p, 5), _mm256_set1_epi16(0x3F));
+		__m256i b = _mm256_and_si256(p, _mm256_set1_epi16(0x1F));
+		r = _mm256_or_si256(_mm256_slli_epi16(r, 3), _mm256_srli_epi16(r, 2));
+		g = _mm256_or_si256(_mm256_slli_epi16(g, 2), _mm256_srli_epi16(g, 4));
+		b = _mm256_or_si256(_mm256_slli_epi16(b, 3), _mm256_srli_epi16(b, 2));
+		__m256i lo16 = _mm256_or_si256(bgr ? b : r, _mm256_slli_epi16(g, 8));
+		__m256i hi16 = _mm256_or_si256(bgr ? r : b, alpha);
+		// unpacks work within 128-bit lanes, reorder the halves back into pixel order
+		__m256i lo = _mm256_unpacklo_epi16(lo16, hi16);
+		__m256i hi = _mm256_unpackhi_epi16(lo16, hi16);
+		_mm256_storeu_si256((__m256i*)dest, _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(dest + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+		src += 16;
+		dest += 64;
+	}
+	rgb565To8888SSE2<bgr>(src, dest, pixels % 16);
+}
+
+AVX2_FUNC static void swapRB8888AVX2(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uchar*)srcPtr;
+	auto dest = (uchar*)destPtr;
+	const __m256i swapMask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	uint blocks = pixels / 8;
+	iterateTimes(blocks, i)
+	{
+		__m256i p = _mm256_loadu_si256((const __m256i*)src);
+		_mm256_storeu_si256((__m256i*)dest, _mm256_shuffle_epi8(p, swapMask));
+		src += 32;
+		dest += 32;
+	}
+	swapRB8888SSE2(src, dest, pixels % 8);
+}
+
+template <bool bgr>
+AVX2_FUNC static __m256i pack8888To565LanesAVX2(__m256i p)
+{
+	__m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x7E0));
+	__m256i r, b;
+	if(bgr)
+	{
+		r = _mm256_and_si256(_mm256_srli_epi32(p, 8), _mm256_set1_epi32(0xF800));
+		b = _mm256_and_si256(_mm256_srli_epi32(p, 3), _mm256_set1_epi32(0x1F));
+	}
+	else
+	{
+		r = _mm256_slli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0xF8)), 8);
+		b = _mm256_and_si256(_mm256_srli_epi32(p, 19), _mm256_set1_epi32(0x1F));
+	}
+	__m256i v = _mm256_or_si256(_mm256_or_si256(r, g), b);
+	return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+template <bool bgr>
+AVX2_FUNC static void x8888ToRGB565AVX2(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uchar*)srcPtr;
+	auto dest = (uint16*)destPtr;
+	uint blocks = pixels / 16;
+	iterateTimes(blocks, i)
+	{
+		__m256i lo = pack8888To565LanesAVX2<bgr>(_mm256_loadu_si256((const __m256i*)src));
+		__m256i hi = pack8888To565LanesAVX2<bgr>(_mm256_loadu_si256((const __m256i*)(src + 32)));
+		// packs interleave the 128-bit lanes, 0xD8 puts the 64-bit quarters back in order
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+		_mm256_storeu_si256((__m256i*)dest, packed);
+		src += 64;
+		dest += 16;
+	}
+	x8888ToRGB565SSE2<bgr>(src, dest, pixels % 16);
+}
+
+AVX2_FUNC static void expand32AVX2(const uint8 *src, uint32 *dest, const uint32 *palette, uint pixels)
+{
+	uint blocks = pixels / 8;
+	iterateTimes(blocks, i)
+	{
+		__m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src));
+		_mm256_storeu_si256((__m256i*)dest, _mm256_i32gather_epi32((const int*)palette, idx, 4));
+		src += 8;
+		dest += 8;
+	}
+	expandIndexedScalar(src, dest, palette, pixels % 8);
+}
+
+static const Kernels avx2Kernels
+{
+	"AVX2",
+	rgb565To8888AVX2<0>, rgb565To8888AVX2<1>,
+	argb1555ToRGB565SSE2, rgb565ToARGB1555SSE2, // already bandwidth bound at 128 bits
+	swapRB8888AVX2,
+	x8888ToRGB565AVX2<0>, x8888ToRGB565AVX2<1>,
+	expand16Scalar, expand32AVX2
+};
+
+#undef AVX2_FUNC
+
+#endif
+
+#ifdef CONFIG_PIXCONV_NEON
+
+template <bool bgr>
+static void rgb565To8888NEON(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uint16*)srcPtr;
+	auto dest = (uchar*)destPtr;
+	uint blocks = pixels / 8;
+	iterateTimes(blocks, i)
+	{
+		uint16x8_t p = vld1q_u16(src);
+		uint8x8_t r = vand_u8(vshrn_n_u16(p, 8), vdup_n_u8(0xF8));
+		uint8x8_t g = vand_u8(vshrn_n_u16(p, 3), vdup_n_u8(0xFC));
+		uint8x8_t b = vshl_n_u8(vmovn_u16(p), 3);
+		r = vorr_u8(r, vshr_n_u8(r, 5));
+		g = vorr_u8(g, vshr_n_u8(g, 6));
+		b = vorr_u8(b, vshr_n_u8(b, 5));
+		uint8x8x4_t out;
+		out.val[0] = bgr ? b : r;
+		out.val[1] = g;
+		out.val[2] = bgr ? r : b;
+		out.val[3] = vdup_n_u8(0xFF);
+		vst4_u8(dest, out);
+		src += 8;
+		dest += 32;
+	}
+	rgb565To8888(src, dest, pixels % 8, bgr ? 2 : 0, bgr ? 0 : 2);
+}
+
+static void argb1555ToRGB565NEON(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uint16*)srcPtr;
+	auto dest = (uint16*)destPtr;
+	uint blocks = pixels / 8;
+	iterateTimes(blocks, i)
+	{
+		uint16x8_t p = vld1q_u16(src);
+		uint16x8_t rg = vshlq_n_u16(vandq_u16(p, vdupq_n_u16(0x7FE0)), 1);
+		uint16x8_t gLow = vandq_u16(vshrq_n_u16(p, 4), vdupq_n_u16(0x20));
+		uint16x8_t b = vandq_u16(p, vdupq_n_u16(0x1F));
+		vst1q_u16(dest, vorrq_u16(vorrq_u16(rg, gLow), b));
+		src += 8;
+		dest += 8;
+	}
+	argb1555ToRGB565(src, dest, pixels % 8);
+}
+
+static void rgb565ToARGB1555NEON(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uint16*)srcPtr;
+	auto dest = (uint16*)destPtr;
+	uint blocks = pixels / 8;
+	iterateTimes(blocks, i)
+	{
+		uint16x8_t p = vld1q_u16(src);
+		uint16x8_t rg = vandq_u16(vshrq_n_u16(p, 1), vdupq_n_u16(0x7FE0));
+		uint16x8_t ab = vorrq_u16(vandq_u16(p, vdupq_n_u16(0x1F)), vdupq_n_u16(0x8000));
+		vst1q_u16(dest, vorrq_u16(rg, ab));
+		src += 8;
+		dest += 8;
+	}
+	rgb565ToARGB1555(src, dest, pixels % 8);
+}
+
+static void swapRB8888NEON(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uchar*)srcPtr;
+	auto dest = (uchar*)destPtr;
+	uint blocks = pixels / 16;
+	iterateTimes(blocks, i)
+	{
+		uint8x16x4_t p = vld4q_u8(src);
+		uint8x16_t c0 = p.val[0];
+		p.val[0] = p.val[2];
+		p.val[2] = c0;
+		vst4q_u8(dest, p);
+		src += 64;
+		dest += 64;
+	}
+	swapRB8888(src, dest, pixels % 16);
+}
+
+template <bool bgr>
+static void x8888ToRGB565NEON(const void *srcPtr, void *destPtr, uint pixels)
+{
+	auto src = (const uchar*)srcPtr;
+	auto dest = (uint16*)destPtr;
+	uint blocks = pixels / 8;
+	iterateTimes(blocks, i)
+	{
+		uint8x8x4_t p = vld4_u8(src);
+		// shift-right-insert keeps the already placed high bits
+		uint16x8_t out = vshll_n_u8(p.val[bgr ? 2 : 0], 8);
+		out = vsriq_n_u16(out, vshll_n_u8(p.val[1], 8), 5);
+		out = vsriq_n_u16(out, vshll_n_u8(p.val[bgr ? 0 : 2], 8), 11);
+		vst1q_u16(dest, out);
+		src += 32;
+		dest += 8;
+	}
+	x8888ToRGB565(src, dest, pixels % 8, bgr ? 2 : 0, bgr ? 0 : 2);
+}
+
+static const Kernels neonKernels
+{
+	"NEON",
+	rgb565To8888NEON<0>, rgb565To8888NEON<1>,
+	argb1555ToRGB565NEON, rgb565ToARGB1555NEON,
+	swapRB8888NEON,
+	x8888ToRGB565NEON<0>, x8888ToRGB565NEON<1>,
+	expand16Scalar, expand32Scalar
+};
+
+#endif
+
+static const Kernels *kernels = nullptr;
+
+static const Kernels &selectKernels()
+{
+	if(kernels)
+		return *kernels;
+	kernels = &scalarKernels;
+	#if defined CONFIG_PIXCONV_NEON
+	kernels = &neonKernels; // always present on the ARM targets built with NEON enabled
+	#elif defined CONFIG_PIXCONV_SSE2
+	kernels = &sse2Kernels;
+		#ifdef CONFIG_PIXCONV_AVX2
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+			kernels = &avx2Kernels;
+		#endif
+	#endif
+	logMsg("using %s pixel conversion", kernels->name);
+	return *kernels;
+}
+
+const char *kernelName()
+{
+	return selectKernels().name;
+}
+
+static bool isConvertibleFormat(const PixelFormatDesc &format)
+{
+	switch(format.id)
+	{
+		case PIXEL_RGB565:
+		case PIXEL_ARGB1555:
+		case PIXEL_RGB888:
+		case PIXEL_BGR888:
+		case PIXEL_RGBA8888:
+		case PIXEL_BGRA8888:
+		case PIXEL_ARGB8888:
+		case PIXEL_ABGR8888:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+bool supports(const PixelFormatDesc &src, const PixelFormatDesc &dest)
+{
+	return isConvertibleFormat(src) && isConvertibleFormat(dest);
+}
+
+static RowFunc rowFunc(const Kernels &k, uint srcId, uint destId)
+{
+	switch(srcId)
+	{
+		case PIXEL_RGB565:
+			switch(destId)
+			{
+				case PIXEL_RGBA8888: return k.rgb565ToRGBA8888;
+				case PIXEL_BGRA8888: return k.rgb565ToBGRA8888;
+				case PIXEL_ARGB1555: return k.rgb565ToARGB1555;
+			}
+			break;
+		case PIXEL_ARGB1555:
+			if(destId == PIXEL_RGB565)
+				return k.argb1555ToRGB565;
+			break;
+		case PIXEL_RGBA8888:
+			switch(destId)
+			{
+				case PIXEL_BGRA8888: return k.swapRB8888;
+				case PIXEL_RGB565: return k.rgba8888ToRGB565;
+			}
+			break;
+		case PIXEL_BGRA8888:
+			switch(destId)
+			{
+				case PIXEL_RGBA8888: return k.swapRB8888;
+				case PIXEL_RGB565: return k.bgra8888ToRGB565;
+			}
+			break;
+	}
+	return nullptr;
+}
+
+void convertRow(const PixelFormatDesc &srcFormat, const void *src,
+	const PixelFormatDesc &destFormat, void *dest, uint pixels)
+{
+	assert(supports(srcFormat, destFormat));
+	if(srcFormat.id == destFormat.id)
+	{
+		memcpy(dest, src, pixels * srcFormat.bytesPerPixel);
+		return;
+	}
+	auto func = rowFunc(selectKernels(), srcFormat.id, destFormat.id);
+	if(func)
+		func(src, dest, pixels);
+	else
+		convertRowGeneric(srcFormat, src, destFormat, dest, pixels);
+}
+
+bool convert(const Pixmap &src, Pixmap &dest)
+{
+	if(!supports(src.format, dest.format))
+	{
+		logWarn("can't convert %s to %s", src.format.name, dest.format.name);
+		return 0;
+	}
+	uint width = IG::min(src.x, dest.x), height = IG::min(src.y, dest.y);
+	const uchar *srcRow = src.data;
+	uchar *destRow = dest.data;
+	auto func = rowFunc(selectKernels(), src.format.id, dest.format.id);
+	iterateTimes(height, y)
+	{
+		if(func)
+			func(srcRow, destRow, width);
+		else
+			convertRow(src.format, srcRow, dest.format, destRow, width);
+		srcRow += src.pitch;
+		destRow += dest.pitch;
+	}
+	return 1;
+}
+
+void expandIndexed(const uint8 *src, uint16 *dest, const uint16 *palette, uint pixels)
+{
+	selectKernels().expand16(src, dest, palette, pixels);
+}
+
+void expandIndexed(const uint8 *src, uint32 *dest, const uint32 *palette, uint pixels)
+{
+	selectKernels().expand32(src, dest, palette, pixels);
+}
+
+}
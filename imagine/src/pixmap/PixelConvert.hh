@@ -0,0 +1,46 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+#include <util/pixel.h>
+
+class Pixmap;
+
+// Pixel format conversion and palette expansion with SIMD kernels (SSE2, AVX2, NEON)
+// picked at runtime, and a scalar fallback for all other supported format pairs.
+// 24/32-bit formats are in the byte order of their names (RGBA8888 is R,G,B,A in memory,
+// matching texture uploads and PNG rows), 16-bit formats are native-endian values.
+namespace PixelConvert
+{
+
+// RGB565, ARGB1555, RGB888, BGR888 and all 8888 formats are convertible to each other
+bool supports(const PixelFormatDesc &src, const PixelFormatDesc &dest);
+
+void convertRow(const PixelFormatDesc &srcFormat, const void *src,
+	const PixelFormatDesc &destFormat, void *dest, uint pixels);
+
+// converts the overlapping area of src into dest, returns 0 if the formats aren't supported
+bool convert(const Pixmap &src, Pixmap &dest);
+
+// dest[i] = palette[src[i]]
+void expandIndexed(const uint8 *src, uint16 *dest, const uint16 *palette, uint pixels);
+void expandIndexed(const uint8 *src, uint32 *dest, const uint32 *palette, uint pixels);
+
+// name of the kernel set in use, such as "SSE2" or "NEON"
+const char *kernelName();
+
+}
@@ -1,5 +1,6 @@
 #define thisModuleName "pixmap"
 #include <pixmap/Pixmap.hh>
+#include <pixmap/PixelConvert.hh>
 #include <util/pixel.h>
 #include <util/fixed.hh>
 #include <string.h>
@@ -36,8 +37,18 @@ void Pixmap::copy(int srcX, int srcY, int width, int height, Pixmap *dest, int d
 		assert(dest->format.bytesPerPixel <= format.bytesPerPixel);
 	}
 	//logMsg("copying %s to %s", dest->format->name, format->name);
-	assert(format.id == dest->format.id);
-	//if(format->id == dest->format->id)
+	if(format.id != dest->format.id)
+	{
+		uchar *srcData = getPixel(srcX, srcY);
+		uchar *destData = dest->getPixel(destX, destY);
+		for(int y = srcY; y < height; y++)
+		{
+			PixelConvert::convertRow(format, srcData, dest->format, destData, width);
+			srcData += pitch;
+			destData += dest->pitch;
+		}
+	}
+	else
 	{
 		uchar *srcData = getPixel(srcX, srcY);
 		uchar *destData = dest->getPixel(destX, destY);
@@ -59,10 +70,6 @@ void Pixmap::copy(int srcX, int srcY, int width, int height, Pixmap *dest, int d
 			}
 		}
 	}
-	/*else
-	{
-
-	}*/
 }
 
 void Pixmap::initSubPixmap(const Pixmap &orig, uint x, uint y, uint xlen, uint ylen)
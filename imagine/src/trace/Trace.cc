@@ -0,0 +1,346 @@
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#define thisModuleName "trace"
+#include <trace/Trace.hh>
+
+#ifdef CONFIG_TRACE
+
+#include <mem/interface.h>
+#include <logger/interface.h>
+#include <util/basicString.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef __APPLE__
+	#include <mach/mach_time.h>
+#else
+	#include <time.h>
+#endif
+
+namespace Trace
+{
+
+struct Event
+{
+	uint64 ns;
+	const char *name; // null for end events
+};
+
+static const uint ringEvents = 8192; // power of 2
+static const uint maxThreads = 16;
+static const uint nameSize = 32;
+
+struct ThreadRing
+{
+	Event event[ringEvents];
+	uint count; // events ever written, only the last ringEvents are kept
+	char name[nameSize];
+	uint inUse; // cleared when the owning thread exits so another can take the ring
+};
+
+static ThreadRing *ring[maxThreads] {nullptr};
+static uint rings = 0;
+static pthread_key_t ringKey;
+static pthread_once_t ringKeyOnce = PTHREAD_ONCE_INIT;
+
+static uint64 timeNs()
+{
+	#ifdef __APPLE__
+	static mach_timebase_info_data_t timebase;
+	if(unlikely(!timebase.denom))
+		mach_timebase_info(&timebase);
+	return mach_absolute_time() * timebase.numer / timebase.denom;
+	#else
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64)t.tv_sec * 1000000000 + t.tv_nsec;
+	#endif
+}
+
+static void releaseRing(void *r)
+{
+	__atomic_store_n(&((ThreadRing*)r)->inUse, 0, __ATOMIC_RELEASE);
+}
+
+static void makeRingKey()
+{
+	pthread_key_create(&ringKey, releaseRing);
+}
+
+// takes over the ring of a thread that exited, its events stay exportable
+// and the new thread's events continue after them
+static ThreadRing *reuseRing()
+{
+	uint threads = IG::min(__atomic_load_n(&rings, __ATOMIC_RELAXED), maxThreads);
+	iterateTimes(threads, t)
+	{
+		auto r = __atomic_load_n(&ring[t], __ATOMIC_ACQUIRE);
+		uint free = 0;
+		if(r && __atomic_compare_exchange_n(&r->inUse, &free, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			snprintf(r->name, nameSize, "thread %u", t);
+			return r;
+		}
+	}
+	return nullptr;
+}
+
+static ThreadRing *threadRing()
+{
+	pthread_once(&ringKeyOnce, makeRingKey);
+	auto r = (ThreadRing*)pthread_getspecific(ringKey);
+	if(r)
+		return r;
+	// first event from this thread, rings are never freed so exports can read them without locking
+	r = reuseRing();
+	if(r)
+	{
+		pthread_setspecific(ringKey, r);
+		return r;
+	}
+	uint slot = __atomic_fetch_add(&rings, 1, __ATOMIC_RELAXED);
+	if(slot >= maxThreads)
+	{
+		__atomic_store_n(&rings, maxThreads, __ATOMIC_RELAXED);
+		return nullptr;
+	}
+	r = (ThreadRing*)mem_calloc(1, sizeof(ThreadRing));
+	if(!r)
+		return nullptr;
+	snprintf(r->name, nameSize, "thread %u", slot);
+	r->inUse = 1;
+	pthread_setspecific(ringKey, r);
+	__atomic_store_n(&ring[slot], r, __ATOMIC_RELEASE);
+	return r;
+}
+
+static void push(const char *name)
+{
+	auto r = threadRing();
+	if(unlikely(!r))
+		return;
+	uint i = r->count;
+	auto &e = r->event[i % ringEvents];
+	e.ns = timeNs();
+	e.name = name;
+	__atomic_store_n(&r->count, i + 1, __ATOMIC_RELEASE);
+}
+
+void begin(const char *name)
+{
+	push(name);
+}
+
+void end()
+{
+	push(nullptr);
+}
+
+void setThreadName(const char *name)
+{
+	auto r = threadRing();
+	if(r)
+		string_copy(r->name, name, nameSize);
+}
+
+// Copies the events a thread still has in its ring to dest and returns the count.
+// The writer may overwrite the oldest ones during the copy, those are dropped after
+// re-reading its count, as are end events whose begin was already overwritten.
+static uint copyEvents(const ThreadRing &r, Event *dest)
+{
+	uint end = __atomic_load_n(&r.count, __ATOMIC_ACQUIRE);
+	uint start = end > ringEvents ? end - ringEvents : 0;
+	for(uint i = start; i != end; i++)
+		dest[i - start] = r.event[i % ringEvents];
+	uint newEnd = __atomic_load_n(&r.count, __ATOMIC_ACQUIRE);
+	uint firstValid = newEnd >= ringEvents ? newEnd - ringEvents + 1 : 0;
+	uint skip = firstValid > start ? IG::min(firstValid - start, end - start) : 0;
+	uint events = 0, depth = 0;
+	for(uint i = skip; i < end - start; i++)
+	{
+		if(dest[i].name)
+			depth++;
+		else if(!depth)
+			continue;
+		else
+			depth--;
+		dest[events++] = dest[i];
+	}
+	return events;
+}
+
+template <class FUNC>
+static bool forEachThread(FUNC func)
+{
+	auto events = (Event*)mem_alloc(sizeof(Event) * ringEvents);
+	if(!events)
+	{
+		logErr("out of memory exporting trace");
+		return 0;
+	}
+	uint threads = IG::min(__atomic_load_n(&rings, __ATOMIC_RELAXED), maxThreads);
+	iterateTimes(threads, t)
+	{
+		auto r = __atomic_load_n(&ring[t], __ATOMIC_ACQUIRE);
+		if(!r)
+			continue;
+		uint count = copyEvents(*r, events);
+		func(t, *r, events, count);
+	}
+	mem_free(events);
+	return 1;
+}
+
+static void writeJSONString(FILE *f, const char *str)
+{
+	fputc('"', f);
+	for(; *str; str++)
+	{
+		if(*str == '"' || *str == '\\')
+			fputc('\\', f);
+		fputc(*str, f);
+	}
+	fputc('"', f);
+}
+
+bool writeJSON(const char *path)
+{
+	FILE *f = fopen(path, "wb");
+	if(!f)
+	{
+		logErr("can't open %s for writing", path);
+		return 0;
+	}
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+	bool first = 1;
+	bool ok = forEachThread(
+		[&](uint tid, const ThreadRing &r, const Event *event, uint events)
+		{
+			fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", tid);
+			writeJSONString(f, r.name);
+			fputs("}}", f);
+			first = 0;
+			iterateTimes(events, i)
+			{
+				auto &e = event[i];
+				// microseconds with ns precision
+				uint64 us = e.ns / 1000, nsRem = e.ns % 1000;
+				if(e.name)
+				{
+					fprintf(f, ",\n{\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u,\"name\":", tid,
+						(unsigned long long)us, (uint)nsRem);
+					writeJSONString(f, e.name);
+					fputc('}', f);
+				}
+				else
+				{
+					fprintf(f, ",\n{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u}", tid,
+						(unsigned long long)us, (uint)nsRem);
+				}
+			}
+		});
+	fputs("\n]}\n", f);
+	if(fclose(f) != 0)
+		ok = 0;
+	if(ok)
+		logMsg("wrote trace JSON to %s", path);
+	return ok;
+}
+
+bool writeBinary(const char *path)
+{
+	// names are interned by pointer, identical strings from different modules just get two entries
+	static const uint maxNames = 0xFFFF;
+	auto names = (const char**)mem_alloc(sizeof(const char*) * maxNames);
+	if(!names)
+		return 0;
+	uint nameCount = 0;
+	auto nameIndex =
+		[&](const char *name) -> uint
+		{
+			if(!name)
+				return maxNames;
+			iterateTimes(nameCount, i)
+			{
+				if(names[i] == name)
+					return i;
+			}
+			if(nameCount == maxNames)
+				return maxNames;
+			names[nameCount] = name;
+			return nameCount++;
+		};
+
+	// event data is built first so the name table can be written ahead of it
+	uint threads = IG::min(__atomic_load_n(&rings, __ATOMIC_RELAXED), maxThreads);
+	uint maxBytes = threads * (nameSize + 4 + ringEvents * 12);
+	auto data = (uchar*)mem_alloc(IG::max(maxBytes, 1U));
+	if(!data)
+	{
+		mem_free(names);
+		return 0;
+	}
+	uint dataBytes = 0, writtenThreads = 0;
+	bool ok = forEachThread(
+		[&](uint tid, const ThreadRing &r, const Event *event, uint events)
+		{
+			uint nameLen = strlen(r.name) + 1;
+			memcpy(&data[dataBytes], r.name, nameLen);
+			dataBytes += nameLen;
+			memcpy(&data[dataBytes], &events, 4);
+			dataBytes += 4;
+			iterateTimes(events, i)
+			{
+				uint16 idx = nameIndex(event[i].name);
+				uint8 phase = event[i].name ? 'B' : 'E', pad = 0;
+				memcpy(&data[dataBytes], &event[i].ns, 8);
+				memcpy(&data[dataBytes + 8], &idx, 2);
+				data[dataBytes + 10] = phase;
+				data[dataBytes + 11] = pad;
+				dataBytes += 12;
+			}
+			writtenThreads++;
+		});
+
+	FILE *f = ok ? fopen(path, "wb") : nullptr;
+	if(f)
+	{
+		fwrite("IGTRACE1", 8, 1, f);
+		fwrite(&nameCount, 4, 1, f);
+		iterateTimes(nameCount, i)
+		{
+			fwrite(names[i], strlen(names[i]) + 1, 1, f);
+		}
+		fwrite(&writtenThreads, 4, 1, f);
+		fwrite(data, dataBytes, 1, f);
+		ok = fclose(f) == 0;
+	}
+	else
+	{
+		if(ok)
+			logErr("can't open %s for writing", path);
+		ok = 0;
+	}
+	mem_free(data);
+	mem_free(names);
+	if(ok)
+		logMsg("wrote %u byte binary trace to %s", dataBytes, path);
+	return ok;
+}
+
+}
+
+#endif
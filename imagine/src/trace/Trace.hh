@@ -0,0 +1,70 @@
+#pragma once
+
+/*  This file is part of Imagine.
+
+	Imagine is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Imagine is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
+
+#include <engine-globals.h>
+
+// Timeline tracing, built when USE_TRACE is defined. Each thread records begin/end
+// events into its own ring buffer without locking, the last events of every thread
+// can be exported as Chrome trace JSON (chrome://tracing, Perfetto) or a compact binary.
+// Event names must be string literals or otherwise stay valid until exported.
+#if defined USE_TRACE && !defined CONFIG_BASE_PS3
+	#define CONFIG_TRACE
+#endif
+
+namespace Trace
+{
+
+#ifdef CONFIG_TRACE
+
+static const bool isEnabled = 1;
+void begin(const char *name);
+void end();
+// names the calling thread in exported traces
+void setThreadName(const char *name);
+bool writeJSON(const char *path);
+// "IGTRACE1", uint32 name count, null-terminated names,
+// uint32 thread count, then per thread: null-terminated name, uint32 event count,
+// events of { uint64 ns, uint16 name index, uint8 phase ('B'/'E'), uint8 pad }
+bool writeBinary(const char *path);
+
+#else
+
+static const bool isEnabled = 0;
+static void begin(const char *name) { }
+static void end() { }
+static void setThreadName(const char *name) { }
+static bool writeJSON(const char *path) { return 0; }
+static bool writeBinary(const char *path) { return 0; }
+
+#endif
+
+class Scope
+{
+public:
+	Scope(const char *name) { begin(name); }
+	~Scope() { end(); }
+};
+
+}
+
+#ifdef CONFIG_TRACE
+	#define TRACE_SCOPE_NAME2(line) traceScope ## line
+	#define TRACE_SCOPE_NAME(line) TRACE_SCOPE_NAME2(line)
+	#define TRACE_SCOPE(name) Trace::Scope TRACE_SCOPE_NAME(__LINE__)(name)
+#else
+	#define TRACE_SCOPE(name)
+#endif
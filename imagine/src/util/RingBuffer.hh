@@ -16,112 +16,113 @@
 	along with Imagine.  If not, see <http://www.gnu.org/licenses/> */
 
 #include <util/cLang.h>
+#include <util/basicMath.hh>
+#include <string.h>
 
+// Lock-free ring buffer of fixed-size frames for a single producer thread
+// calling write() and a single consumer thread calling read(). Any capacity
+// works: positions run over twice the capacity so a full ring can be told
+// apart from an empty one, and each transfer is at most two memcpy() spans.
 template <class SIZE = uint>
 class RingBuffer
 {
 public:
-	void init(uchar *buff, SIZE size)
+	// buff must hold frames * frameBytes bytes
+	void init(uchar *buff, SIZE frames, uint frameBytes)
 	{
+		assert(frames && frameBytes);
 		this->buff = buff;
-		buffSize = size;
+		capacity = frames;
+		this->frameBytes = frameBytes;
 		reset();
 	}
 
+	// only call when neither side is active
 	void reset()
 	{
-		start = end = buff;
-		written = 0;
+		head = tail = 0;
+		underruns = overruns = 0;
 	}
 
-	SIZE freeSpace()
+	// frames waiting to be read
+	SIZE written() const
 	{
-		return buffSize - written;
+		return used(__atomic_load_n(&head, __ATOMIC_ACQUIRE), __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
 	}
 
-	uchar *advancePtr(uchar *ptr)
+	SIZE freeSpace() const
 	{
-		assert(ptr >= buff && ptr < buff+buffSize);
-		ptr++;
-		if(ptr == buff+buffSize)
-			ptr = buff;
-		return ptr;
+		return capacity - written();
 	}
 
-	SIZE write(uchar *buff, SIZE size)
+	SIZE write(const void *data, SIZE frames)
 	{
-		if(size > freeSpace())
-			size = freeSpace();
-
-		uchar *writePos = end;
-		iterateTimes(size, i)
+		auto writePos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+		SIZE freeFrames = capacity - used(writePos, __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+		if(frames > freeFrames)
 		{
-			//logMsg("addr %p", writePos);
-			*writePos = buff[i];
-			written++;
-			writePos = advancePtr(writePos);
+			overruns++;
+			frames = freeFrames;
 		}
-		end = writePos;
-
-		assert(written <= buffSize);
-
-		//logMsg("wrote %d bytes", (int)size);
-		return size;
+		copyIn(index(writePos), (const uchar*)data, frames);
+		__atomic_store_n(&head, advance(writePos, frames), __ATOMIC_RELEASE);
+		return frames;
 	}
 
-	SIZE read(uchar *buff, SIZE size)
+	SIZE read(void *data, SIZE frames)
 	{
-		if(size > written)
-			size = written;
-
-		uchar *readPos = start;
-		iterateTimes(size, i)
+		auto readPos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+		SIZE usedFrames = used(__atomic_load_n(&head, __ATOMIC_ACQUIRE), readPos);
+		if(frames > usedFrames)
 		{
-			//logMsg("addr %p", readPos);
-			buff[i] = *readPos;
-			written--;
-			readPos = advancePtr(readPos);
+			underruns++;
+			frames = usedFrames;
 		}
-		start = readPos;
+		copyOut(index(readPos), (uchar*)data, frames);
+		__atomic_store_n(&tail, advance(readPos, frames), __ATOMIC_RELEASE);
+		return frames;
+	}
+
+	SIZE size() const { return capacity; }
+
+	// counts of write() calls that didn't fit and read() calls that came up short,
+	// each is only modified by its own side
+	uint underruns = 0, overruns = 0;
+
+private:
+	uchar *buff = nullptr;
+	SIZE capacity = 0; // in frames
+	uint frameBytes = 0;
+	SIZE head = 0, tail = 0; // write/read positions in [0, capacity * 2)
+
+	SIZE used(SIZE writePos, SIZE readPos) const
+	{
+		return writePos >= readPos ? writePos - readPos : writePos + capacity * 2 - readPos;
+	}
 
-		//logMsg("read %d bytes", (int)size);
-		return size;
+	SIZE advance(SIZE pos, SIZE frames) const
+	{
+		pos += frames;
+		return pos >= capacity * 2 ? pos - capacity * 2 : pos;
 	}
 
-	SIZE readPadded(uchar *buff, SIZE size)
+	SIZE index(SIZE pos) const
 	{
-		SIZE readSize = read(buff, size);
-		if(readSize < size)
-		{
-			uint padBytes = size - readSize;
-			logMsg("padding %d bytes", padBytes);
-			uchar padVal = readSize ? buff[readSize-1] : 0;
-			memset(&buff[readSize], padVal, padBytes);
-		}
-		return readSize;
+		return pos >= capacity ? pos - capacity : pos;
 	}
 
-	SIZE readPadded32(uchar *buff, SIZE size)
+	// copy frames into/out of the ring starting at frame ringIdx, wrapping once if needed
+	void copyIn(SIZE ringIdx, const uchar *src, SIZE frames)
 	{
-		assert(size % 4 == 0);
-		SIZE readSize = read(buff, size);
-		assert(readSize % 4 == 0);
-		if(readSize < size)
-		{
-			uint padElements = (size - readSize) / 4;
-			logMsg("padding %dx4 bytes", padElements);
-			uint padVal = 0;
-			if(readSize)
-				memcpy(&padVal, &buff[readSize-4], 4);
-			iterateTimes(padElements, i)
-				memcpy(&buff[readSize + (i*4)], &padVal, 4);
-		}
-		return readSize;
+		SIZE firstSpan = IG::min(frames, capacity - ringIdx);
+		memcpy(&buff[ringIdx * frameBytes], src, firstSpan * frameBytes);
+		memcpy(buff, src + firstSpan * frameBytes, (frames - firstSpan) * frameBytes);
 	}
 
-	SIZE written;
-	SIZE buffSize;
-private:
-	uchar *buff;
-	uchar *start, *end;
+	void copyOut(SIZE ringIdx, uchar *dest, SIZE frames)
+	{
+		SIZE firstSpan = IG::min(frames, capacity - ringIdx);
+		memcpy(dest, &buff[ringIdx * frameBytes], firstSpan * frameBytes);
+		memcpy(dest + firstSpan * frameBytes, buff, (frames - firstSpan) * frameBytes);
+	}
 };
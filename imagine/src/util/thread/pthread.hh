@@ -204,4 +204,14 @@ public:
 		pthread_mutex_t *waitMutex = mutex ? &mutex->mutex : this->mutex;
 		pthread_cond_wait(&cond, waitMutex);
 	}
+
+	void signal()
+	{
+		pthread_cond_signal(&cond);
+	}
+
+	void broadcast()
+	{
+		pthread_cond_broadcast(&cond);
+	}
 };